@@ -31,6 +31,16 @@ public:
         memset(in, 0, size_bytes);
     }
 
+    array_base(array_base && other) noexcept: in(other.in), size_bytes(other.size_bytes),
+                                             length_bytes(other.length_bytes), length(other.length),
+                                             min(other.min), max(other.max) {
+        other.in = nullptr;
+        other.size_bytes = other.length_bytes = other.length = 0;
+    }
+
+    array_base(const array_base &) = delete;
+    array_base & operator=(const array_base &) = delete;
+
     ~array_base() {
         free(in);
         in = nullptr;
@@ -38,6 +48,11 @@ public:
 
     uint32_t* uncompress();
 
+    // decodes into `out`, which must have room for `getLength()` values
+    void uncompress(uint32_t* out);
+
+    uint32_t getMax();
+
     uint32_t getSizeInBytes();
 
     uint32_t getLength();
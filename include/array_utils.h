@@ -3,17 +3,34 @@
 #include <cstddef>
 #include <stdint.h>
 #include <array>
+#include <vector>
+#include <utility>
 
 /* Different intersection routines adapted from:
  * https://github.com/lemire/SIMDCompressionAndIntersection/blob/master/src/intersection.cpp
  */
 class ArrayUtils {
+private:
+  // beyond this ratio of list lengths, galloping through the longer list beats merging both
+  static const size_t GALLOPING_RATIO = 32;
+
+  static size_t and_galloping_inplace(uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB);
+
 public:
-  // Fast scalar scheme designed by N. Kurz. Returns the size of out (intersected set)
+  // Intersection of two sorted arrays, allocated in `out`. Returns the size of out (intersected set)
   static size_t and_scalar(const uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB, uint32_t **out);
 
+  // Intersects sorted `A` with sorted `B` in place: the intersected set is written to the front of `A` and its size
+  // is returned. Skewed lists are intersected by galloping through the longer one, others by a merge that uses
+  // SSE4.1 or AVX2 when the CPU supports it.
+  static size_t and_inplace(uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB);
+
   static size_t or_scalar(const uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB, uint32_t **out);
 
+  // Union of any number of sorted arrays in a single pass, without duplicates. Returns the size of out (union set).
+  // Dense inputs are accumulated in a bitmap, sparse ones merged through a heap of array cursors.
+  static size_t or_many(const std::vector<std::pair<uint32_t*, size_t>> & arrays, uint32_t **out);
+
   static size_t exclude_scalar(const uint32_t *src, const size_t lenSrc, const uint32_t *filter, const size_t lenFilter,
                               uint32_t **out);
 };
\ No newline at end of file
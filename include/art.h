@@ -6,6 +6,8 @@
 #include <vector>
 #include "array.h"
 #include "sorted_array.h"
+#include "posting_list.h"
+#include "positions_list.h"
 
 #define IGNORE_PRINTF 1
 
@@ -33,19 +35,35 @@ extern "C" {
 # endif
 #endif
 
+/**
+ * Nodes that start within the first `ART_TOPK_DEPTH` bytes of their keys cache the
+ * `ART_TOPK_SIZE` best leaves of their subtree, so that prefix searches of short terms
+ * need not walk large subtrees.
+ */
+#define ART_TOPK_SIZE 10
+#define ART_TOPK_DEPTH 3
+
 typedef int(*art_callback)(void *data, const unsigned char *key, uint32_t key_len, void *value);
 
+struct art_topk;
+
 /**
  * This struct is included as part
- * of all the various node sizes
+ * of all the various node sizes.
+ * A prefix of up to `MAX_PREFIX_LEN` bytes is held in the node itself, and a longer one
+ * in a buffer of the tree's arena, so that prefixes are always compared in full.
  */
 typedef struct {
     uint8_t type;
     uint8_t num_children;
-    uint8_t partial_len;
-    unsigned char partial[MAX_PREFIX_LEN];
+    uint32_t partial_len;
     int32_t max_score;
     uint32_t max_token_count;
+    union {
+        unsigned char partial[MAX_PREFIX_LEN];
+        unsigned char *long_partial;
+    };
+    art_topk *topk;
 } art_node;
 
 /**
@@ -88,9 +106,8 @@ typedef struct {
  * Container for holding the documents that belong to a leaf.
  */
 typedef struct {
-    sorted_array ids;
-    sorted_array offset_index;
-    array offsets;
+    posting_list ids;
+    positions_list positions;
 } art_values;
 
 /**
@@ -104,12 +121,26 @@ typedef struct {
     unsigned char key[];
 } art_leaf;
 
+/**
+ * Best leaves of the subtree of a node, by each token ordering.
+ * Both lists hold the same number of leaves: all of the subtree when it has fewer than `ART_TOPK_SIZE`.
+ */
+typedef struct art_topk {
+    uint8_t num_leaves;
+    art_leaf *by_score[ART_TOPK_SIZE];
+    art_leaf *by_frequency[ART_TOPK_SIZE];
+} art_topk;
+
+struct art_arena;
+
 /**
  * Main struct, points to root.
+ * The nodes and leaves of the tree are allocated from its arena.
  */
 typedef struct {
     art_node *root;
     uint64_t size;
+    art_arena *arena;
 } art_tree;
 
 /*
@@ -123,6 +154,32 @@ typedef struct {
     uint32_t* offsets;
 } art_document;
 
+/*
+ * Documents of a single token, in ascending order of id, to be added to its leaf in one go.
+ * The offsets of all the documents are back to back in `offsets`, with `offsets_lens` holding the count of each.
+ */
+typedef struct {
+    int32_t max_score;
+    uint32_t num_documents;
+    const uint32_t* ids;
+    const uint32_t* offsets;
+    const uint32_t* offsets_lens;
+} art_document_run;
+
+/*
+ * Memory held by a tree, by kind of structure.
+ */
+typedef struct {
+    uint64_t num_nodes[4];      // of NODE4, NODE16, NODE48 and NODE256, in that order
+    uint64_t node_bytes;        // nodes along with the leaves they cache and their long prefixes
+    uint64_t num_leaves;
+    uint64_t leaf_bytes;        // leaves along with their keys
+    uint64_t posting_bytes;     // document ids of the leaves
+    uint64_t position_bytes;    // token positions of the leaves
+    uint64_t arena_bytes;       // slabs of the arena the nodes and leaves are allocated from
+    uint64_t arena_free_bytes;  // of which not held by a node or leaf
+} art_memory;
+
 enum token_ordering {
     FREQUENCY,
     MAX_SCORE
@@ -184,6 +241,31 @@ inline uint64_t art_size(art_tree *t) {
  */
 void* art_insert(art_tree *t, const unsigned char *key, int key_len, art_document* document, uint32_t num_hits);
 
+/**
+ * Inserts a run of documents into the ART tree, walking down to the leaf only once
+ * @arg t The tree
+ * @arg key The key
+ * @arg key_len The length of the key
+ * @arg run The documents to add
+ * @return NULL if the key was newly inserted, otherwise
+ * the old value pointer is returned.
+ */
+void* art_insert_many(art_tree *t, const unsigned char *key, int key_len, const art_document_run* run);
+
+/**
+ * Adds up the memory held by the nodes and leaves of the ART tree
+ * @arg t The tree
+ * @arg memory The counts to add to
+ */
+void art_memory_usage(art_tree *t, art_memory *memory);
+
+/**
+ * Adds up the memory held by the arena of the ART tree, from the counters it keeps on every allocation
+ * @arg t The tree
+ * @arg memory The counts to add to: only the arena bytes are filled in
+ */
+void art_arena_usage(art_tree *t, art_memory *memory);
+
 /**
  * Deletes a value from the ART tree
  * @arg t The tree
@@ -251,6 +333,11 @@ int art_fuzzy_search(art_tree *t, const unsigned char *term, const int term_len,
 int art_topk_iter(const art_node *root, token_ordering token_order, size_t max_results,
                          std::vector<art_leaf *> &results);
 
+/**
+ * Ranks the cached best leaves of the nodes again, after documents were removed from leaves in place.
+ */
+void art_topk_refresh(art_tree *t);
+
 void encode_int32(int32_t n, unsigned char *chars);
 
 void encode_int64(int64_t n, unsigned char *chars);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Allocates the nodes and leaves of a single ART tree from slabs owned by the tree, instead of one malloc per object.
+ * Sizes are rounded up to a class of `CLASS_ALIGN` bytes, and a released object goes on the free list of its class,
+ * so that the node left behind when a node grows, shrinks or is removed is reused by the next one of its size.
+ * Objects larger than `MAX_CLASS_SIZE` (leaves of very long keys) are left to malloc.
+ */
+struct art_arena {
+    static const size_t CLASS_ALIGN = 8;
+    static const size_t MAX_CLASS_SIZE = 2112;
+
+    // slabs start small, since most trees of a collection hold only a few keys, and double up to the max
+    static const size_t MIN_SLAB_SIZE = 4096;
+    static const size_t MAX_SLAB_SIZE = 256 * 1024;
+
+private:
+    // heads of the free lists, by class: a free object holds the next one of its list in its first word
+    void* free_lists[MAX_CLASS_SIZE / CLASS_ALIGN + 1] = {};
+
+    std::vector<char*> slabs;
+    char* slab_head = nullptr;
+    size_t slab_left = 0;
+    size_t next_slab_size = MIN_SLAB_SIZE;
+
+    uint64_t slab_bytes = 0;
+    uint64_t used_bytes = 0;
+    uint64_t large_bytes = 0;
+
+    static size_t class_size(size_t size) {
+        return (size + CLASS_ALIGN - 1) / CLASS_ALIGN * CLASS_ALIGN;
+    }
+
+    void push_free(void* p, size_t size);
+
+    void new_slab();
+
+public:
+    art_arena() = default;
+
+    art_arena(const art_arena&) = delete;
+    art_arena& operator=(const art_arena&) = delete;
+
+    ~art_arena();
+
+    // memory handed out is not zeroed
+    void* alloc(size_t size);
+
+    // `size` must be the one the object was allocated with
+    void release(void* p, size_t size);
+
+    // bytes of the slabs, whether in use, on a free list or not handed out yet
+    uint64_t get_slab_bytes() const {
+        return slab_bytes;
+    }
+
+    // bytes of the slabs taken by live objects, rounded up to their classes
+    uint64_t get_used_bytes() const {
+        return used_bytes;
+    }
+
+    // bytes of the slabs on a free list or not handed out yet
+    uint64_t get_free_bytes() const {
+        return slab_bytes - used_bytes;
+    }
+
+    // bytes of the objects allocated outside of the slabs
+    uint64_t get_large_bytes() const {
+        return large_bytes;
+    }
+};
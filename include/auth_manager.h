@@ -6,6 +6,7 @@
 #include "json.hpp"
 #include "option.h"
 #include "store.h"
+#include "rw_lock.h"
 
 struct api_key_t {
     uint32_t id;
@@ -100,6 +101,9 @@ class AuthManager {
 private:
 
     std::map<std::string, api_key_t> api_keys;  // stores key_value => key mapping
+
+    // requests are authenticated on the http thread while keys are created and removed on the write path
+    rw_lock_t api_keys_lock;
     Store *store;
 
     // Auto incrementing API KEY ID
@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include <thread>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 #include <art.h>
 #include <index.h>
@@ -16,6 +17,9 @@
 #include <json.hpp>
 #include <field.h>
 #include <option.h>
+#include "threadpool.h"
+#include "search_cache.h"
+#include "rw_lock.h"
 
 
 struct override_t {
@@ -119,11 +123,22 @@ private:
 
     uint64_t created_at;
 
-    size_t num_documents;
+    // updated under the write lock, but read without it by summaries and by the searches already holding a read lock
+    std::atomic<size_t> num_documents;
 
     std::vector<Index*> indices;
 
-    std::vector<std::thread*> index_threads;
+    // shared across collections: each search submits one task per index
+    ThreadPool* search_pool;
+
+    // shared across collections, may be disabled
+    SearchCache* search_cache;
+
+    // bumped on every change to the documents or overrides, invalidating cached search results
+    std::atomic<uint64_t> write_generation;
+
+    // searches hold a read lock, while writes to the documents or overrides and compaction hold the write lock
+    rw_lock_t lock;
 
     // Auto incrementing record ID used internally for indexing - not exposed to the client
     uint32_t next_seq_id;
@@ -146,6 +161,8 @@ private:
 
     std::string get_seq_id_key(uint32_t seq_id);
 
+    void store_indexed_documents(batch_index_result & result);
+
     void highlight_result(const field &search_field, const std::vector<std::vector<art_leaf *>> &searched_queries,
                           const KV &field_order_kv, const nlohmann::json &document,
                           StringUtils & string_utils, size_t snippet_threshold,
@@ -172,12 +189,55 @@ private:
 
     void free_leaf_indices(spp::sparse_hash_map<const art_leaf *, uint32_t *>& leaf_to_indices) const;
 
+    Option<nlohmann::json> do_search(const std::string & query, const std::vector<std::string> & search_fields,
+                          const std::string & simple_filter_query, const std::vector<std::string> & facet_fields,
+                          const std::vector<sort_by> & sort_fields, int num_typos,
+                          size_t per_page, size_t page,
+                          token_ordering token_order, bool prefix,
+                          size_t drop_tokens_threshold,
+                          const spp::sparse_hash_set<std::string> & include_fields,
+                          const spp::sparse_hash_set<std::string> & exclude_fields,
+                          size_t max_facet_values,
+                          const std::string & simple_facet_query,
+                          const size_t snippet_threshold,
+                          const std::string & highlight_full_fields,
+                          size_t typo_tokens_threshold,
+                          const std::map<std::string, size_t>& pinned_hits,
+                          const std::vector<std::string>& hidden_hits,
+                          size_t search_cutoff_ms,
+                          filter_result_cache_t* filter_cache);
+
+    std::string get_search_cache_key(const std::string & query, const std::vector<std::string> & search_fields,
+                                     const std::string & simple_filter_query,
+                                     const std::vector<std::string> & facet_fields,
+                                     const std::vector<sort_by> & sort_fields, int num_typos,
+                                     size_t per_page, size_t page,
+                                     token_ordering token_order, bool prefix,
+                                     size_t drop_tokens_threshold,
+                                     const spp::sparse_hash_set<std::string> & include_fields,
+                                     const spp::sparse_hash_set<std::string> & exclude_fields,
+                                     size_t max_facet_values,
+                                     const std::string & simple_facet_query,
+                                     const size_t snippet_threshold,
+                                     const std::string & highlight_full_fields,
+                                     size_t typo_tokens_threshold,
+                                     const std::map<std::string, size_t>& pinned_hits,
+                                     const std::vector<std::string>& hidden_hits,
+                                     size_t search_cutoff_ms);
+
+    static void merge_index_results(std::vector<search_args> & index_search_params, const size_t max_hits,
+                                    std::vector<KV> & result_kvs);
+
+    static void merge_facet_counts(std::map<uint64_t, facet_count_t> & src,
+                                   std::map<uint64_t, facet_count_t> & dest);
+
 public:
     Collection() = delete;
 
     Collection(const std::string name, const uint32_t collection_id, const uint64_t created_at,
                const uint32_t next_seq_id, Store *store, const std::vector<field> & fields,
-               const std::string & default_sorting_field, const size_t num_indices);
+               const std::string & default_sorting_field, const size_t num_indices, ThreadPool* search_pool,
+               SearchCache* search_cache);
 
     ~Collection();
 
@@ -219,6 +279,12 @@ public:
 
     nlohmann::json get_summary_json();
 
+    // memory held by the in-memory indices, in total and by field: walks every tree, so is not cheap
+    nlohmann::json get_memory_json();
+
+    // bytes held by the arenas of the trees, from counters kept on every allocation: cheap enough for metrics
+    nlohmann::json get_arena_memory_json();
+
     Option<nlohmann::json> add(const std::string & json_str);
 
     Option<nlohmann::json> add_many(const std::string & json_str);
@@ -237,12 +303,19 @@ public:
                           const std::string & highlight_full_fields = "",
                           size_t typo_tokens_threshold = Index::TYPO_TOKENS_THRESHOLD,
                           const std::map<std::string, size_t>& pinned_hits={},
-                          const std::vector<std::string>& hidden_hits={});
+                          const std::vector<std::string>& hidden_hits={},
+                          size_t search_cutoff_ms = 0,
+                          filter_result_cache_t* filter_cache = nullptr,
+                          search_stage_times_t* stage_times = nullptr);
 
     Option<nlohmann::json> get(const std::string & id);
 
     Option<std::string> remove(const std::string & id, bool remove_from_store = true);
 
+    // Purges up to `max_ids` removed documents from each index that has at least `min_ids` of them, or in which they
+    // make up at least `min_percent` percent of the documents (when not 0). Returns the number of documents purged.
+    size_t compact(const size_t max_ids, const size_t min_ids, const size_t min_percent = 0);
+
     Option<uint32_t> add_override(const override_t & override);
 
     Option<uint32_t> remove_override(const std::string & id);
@@ -271,6 +344,9 @@ public:
 
     const size_t PER_PAGE_MAX = 250;
 
+    // an import is indexed and stored this many documents at a time, letting searches in between
+    const size_t IMPORT_BATCH_SIZE = 1000;
+
     // Using a $ prefix so that these meta keys stay above record entries in a lexicographically ordered KV store
     static constexpr const char* COLLECTION_META_PREFIX = "$CM";
     static constexpr const char* COLLECTION_NEXT_SEQ_PREFIX = "$CS";
@@ -7,6 +7,7 @@
 #include "field.h"
 #include "collection.h"
 #include "auth_manager.h"
+#include "threadpool.h"
 
 // Singleton, for managing meta information of all collections and house keeping
 class CollectionManager {
@@ -35,9 +36,15 @@ private:
 
     size_t default_num_indices;
 
+    // runs the per-index search tasks of all collections
+    ThreadPool* search_pool;
+
+    // caches search results of all collections, disabled unless a size is configured
+    SearchCache search_cache;
+
     CollectionManager();
 
-    ~CollectionManager() = default;
+    ~CollectionManager();
 
     Option<std::string> get_first_index_error(const std::vector<index_result> & items) {
         for(const auto & item: items) {
@@ -58,7 +65,8 @@ public:
     CollectionManager(CollectionManager const&) = delete;
     void operator=(CollectionManager const&) = delete;
 
-    void init(Store *store, const size_t default_num_indices, const std::string & auth_key);
+    void init(Store *store, const size_t default_num_indices, const std::string & auth_key,
+              const size_t num_search_threads = 4);
 
     Option<bool> load(const size_t init_batch_size=1000);
 
@@ -94,6 +102,8 @@ public:
 
     AuthManager& getAuthManager();
 
+    SearchCache& get_search_cache();
+
     // symlinks
     Option<std::string> resolve_symlink(const std::string & symlink_name);
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmdline.h>
+#include <thread>
 #include "option.h"
 #include "string_utils.h"
 #include "INIReader.h"
@@ -31,6 +32,10 @@ private:
 
     size_t indices_per_collection;
 
+    size_t num_search_threads;
+
+    size_t search_cache_size_mb;
+
     std::string config_file;
     int config_file_validity;
 
@@ -42,6 +47,10 @@ public:
         this->peering_port = 8107;
         this->enable_cors = false;
         this->indices_per_collection = 4;
+
+        size_t num_cores = std::thread::hardware_concurrency();
+        this->num_search_threads = (num_cores == 0) ? 4 : num_cores;
+        this->search_cache_size_mb = 0;
     }
 
     // setters
@@ -91,6 +100,14 @@ public:
         this->indices_per_collection  = indices_per_collection;
     }
 
+    void set_num_search_threads(size_t num_search_threads) {
+        this->num_search_threads = num_search_threads;
+    }
+
+    void set_search_cache_size_mb(size_t search_cache_size_mb) {
+        this->search_cache_size_mb = search_cache_size_mb;
+    }
+
     // getters
 
     std::string get_data_dir() const {
@@ -142,6 +159,14 @@ public:
         return indices_per_collection;
     }
 
+    size_t get_num_search_threads() const {
+        return num_search_threads;
+    }
+
+    size_t get_search_cache_size_mb() const {
+        return search_cache_size_mb;
+    }
+
     std::string get_peering_address() const {
         return this->peering_address;
     }
@@ -205,6 +230,14 @@ public:
         std::string enable_cors_str = get_env("TYPESENSE_ENABLE_CORS");
         StringUtils::toupper(enable_cors_str);
         this->enable_cors = ("TRUE" == enable_cors_str) ? true : false;
+
+        if(!get_env("TYPESENSE_NUM_SEARCH_THREADS").empty()) {
+            this->num_search_threads = std::stoi(get_env("TYPESENSE_NUM_SEARCH_THREADS"));
+        }
+
+        if(!get_env("TYPESENSE_SEARCH_CACHE_SIZE_MB").empty()) {
+            this->search_cache_size_mb = std::stoi(get_env("TYPESENSE_SEARCH_CACHE_SIZE_MB"));
+        }
     }
 
     void load_config_file(cmdline::parser & options) {
@@ -286,6 +319,14 @@ public:
         if(reader.Exists("server", "nodes")) {
             this->nodes = reader.Get("server", "nodes", "");
         }
+
+        if(reader.Exists("server", "num-search-threads")) {
+            this->num_search_threads = reader.GetInteger("server", "num-search-threads", 4);
+        }
+
+        if(reader.Exists("server", "search-cache-size-mb")) {
+            this->search_cache_size_mb = reader.GetInteger("server", "search-cache-size-mb", 0);
+        }
     }
 
     void load_config_cmd_args(cmdline::parser & options) {
@@ -349,6 +390,14 @@ public:
         if(options.exist("nodes")) {
             this->nodes = options.get<std::string>("nodes");
         }
+
+        if(options.exist("num-search-threads")) {
+            this->num_search_threads = options.get<uint32_t>("num-search-threads");
+        }
+
+        if(options.exist("search-cache-size-mb")) {
+            this->search_cache_size_mb = options.get<uint32_t>("search-cache-size-mb");
+        }
     }
 
     // validation
@@ -366,6 +415,10 @@ public:
             return Option<bool>(500, "API key is not specified.");
         }
 
+        if(num_search_threads == 0) {
+            return Option<bool>(500, "Number of search threads must be greater than zero.");
+        }
+
         return Option<bool>(true);
     }
 };
@@ -18,6 +18,8 @@ bool get_collection_summary(http_req & req, http_res & res);
 
 bool get_search(http_req & req, http_res & res);
 
+bool post_multi_search(http_req & req, http_res & res);
+
 bool get_export_documents(http_req & req, http_res & res);
 
 bool post_add_document(http_req & req, http_res & res);
@@ -72,4 +74,8 @@ bool collection_export_handler(http_req* req, http_res* res, void* data);
 
 bool async_write_request(void *data);
 
+bool apply_write_request(void *data);
+
 static constexpr const char* SEND_RESPONSE_MSG = "send_response";
+
+static constexpr const char* STREAM_RESPONSE_MSG = "stream_response";
@@ -23,6 +23,7 @@ namespace fields {
     static const std::string type = "type";
     static const std::string facet = "facet";
     static const std::string optional = "optional";
+    static const std::string positions = "positions";
 }
 
 struct field {
@@ -31,13 +32,23 @@ struct field {
     bool facet;
     bool optional;
 
+    // token positions rank multi-token matches by proximity and locate highlights: a field indexed without them
+    // is matched on its tokens alone and is not highlighted
+    bool positions;
+
     field(const std::string & name, const std::string & type, const bool facet):
-        name(name), type(type), facet(facet), optional(false) {
+        name(name), type(type), facet(facet), optional(false), positions(true) {
 
     }
 
     field(const std::string & name, const std::string & type, const bool facet, const bool optional):
-            name(name), type(type), facet(facet), optional(optional) {
+            name(name), type(type), facet(facet), optional(optional), positions(true) {
+
+    }
+
+    field(const std::string & name, const std::string & type, const bool facet, const bool optional,
+          const bool positions):
+            name(name), type(type), facet(facet), optional(optional), positions(positions) {
 
     }
 
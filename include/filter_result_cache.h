@@ -0,0 +1,67 @@
+#pragma once
+
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <cstring>
+#include <functional>
+#include "option.h"
+
+/*
+ * Filter results shared by the searches of a single multi search request. Searches that apply the same filter to
+ * the same index evaluate it only once. The indices of a search are filtered concurrently on the search pool.
+ *
+ * Searches of a batch lock their collection one at a time, so documents can be written in between: results are
+ * kept per write generation of the collection, and a search after a write filters the index again.
+ */
+class filter_result_cache_t {
+private:
+    struct entry_t {
+        std::once_flag computed;
+        Option<uint32_t> op;  // number of matching ids
+        uint32_t* ids;
+
+        entry_t(): op(0), ids(nullptr) {
+
+        }
+
+        ~entry_t() {
+            delete [] ids;
+        }
+    };
+
+    std::mutex mutex;
+    std::map<std::tuple<const void*, uint64_t, std::string>, std::unique_ptr<entry_t>> entries;
+
+public:
+    // `compute` produces the ids for the filter when it has not been evaluated for `index` at `write_generation` yet.
+    // The caller gets its own copy of the ids in `ids_out`, which it must free with delete[].
+    Option<uint32_t> get(const void* index, const uint64_t write_generation, const std::string & filter_query,
+                         const std::function<Option<uint32_t>(uint32_t**)> & compute, uint32_t** ids_out) {
+        entry_t* entry;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::unique_ptr<entry_t> & entry_ptr = entries[std::make_tuple(index, write_generation, filter_query)];
+            if(entry_ptr == nullptr) {
+                entry_ptr.reset(new entry_t());
+            }
+            entry = entry_ptr.get();
+        }
+
+        std::call_once(entry->computed, [&compute, entry]() {
+            entry->op = compute(&entry->ids);
+        });
+
+        *ids_out = nullptr;
+
+        if(entry->op.ok() && entry->op.get() != 0) {
+            *ids_out = new uint32_t[entry->op.get()];
+            memcpy(*ids_out, entry->ids, entry->op.get() * sizeof(uint32_t));
+        }
+
+        return entry->op;
+    }
+};
@@ -167,16 +167,28 @@ struct request_response {
     http_res* res;
 };
 
+// a response whose body is produced chunk by chunk by `handler`, once streaming is started on the http thread
+struct stream_request_response {
+    bool (*handler)(http_req* req, http_res* res, void* data);
+    http_req* req;
+    http_res* res;
+    void* data;
+};
+
 struct route_path {
     std::string http_method;
     std::vector<std::string> path_parts;
     bool (*handler)(http_req &, http_res &);
     bool async;
+    bool use_worker;  // handler is run on the search thread pool instead of the http thread
+    bool collection_write;  // write handler that locks only the collection it writes to, instead of all searches
     std::string action;
 
     route_path(const std::string &httpMethod, const std::vector<std::string> &pathParts,
-               bool (*handler)(http_req &, http_res &), bool async) :
-               http_method(httpMethod), path_parts(pathParts), handler(handler), async(async) {
+               bool (*handler)(http_req &, http_res &), bool async, bool use_worker = false,
+               bool collection_write = false) :
+               http_method(httpMethod), path_parts(pathParts), handler(handler), async(async),
+               use_worker(use_worker), collection_write(collection_write) {
         action = _get_action();
     }
 
@@ -307,5 +319,4 @@ struct http_message_dispatcher {
 struct AsyncIndexArg {
     http_req* req;
     http_res* res;
-    std::promise<bool>* promise;
 };
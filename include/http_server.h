@@ -14,6 +14,8 @@ extern "C" {
 #include <cstdio>
 #include "http_data.h"
 #include "option.h"
+#include "rw_lock.h"
+#include "threadpool.h"
 
 class ReplicationState;
 class HttpServer;
@@ -45,6 +47,12 @@ private:
 
     ReplicationState* replication_state;
 
+    // handlers of routes marked with `use_worker` are run on this pool, off the event loop
+    ThreadPool* search_thread_pool;
+
+    // guards in-memory state read by worker handlers against writes applied by the raft state machine
+    rw_lock_t worker_lock;
+
     bool exit_loop = false;
 
     std::string version;
@@ -98,13 +106,23 @@ public:
     void set_auth_handler(bool (*handler)(http_req & req, const route_path & rpath,
                           const std::string & auth_key));
 
-    void get(const std::string & path, bool (*handler)(http_req & req, http_res & res), bool async = false);
+    void set_search_thread_pool(ThreadPool* thread_pool);
+
+    ThreadPool* get_search_thread_pool() const;
+
+    rw_lock_t& get_worker_lock();
+
+    void get(const std::string & path, bool (*handler)(http_req & req, http_res & res), bool async = false,
+             bool use_worker = false);
 
-    void post(const std::string & path, bool (*handler)(http_req & req, http_res & res), bool async = false);
+    void post(const std::string & path, bool (*handler)(http_req & req, http_res & res), bool async = false,
+              bool use_worker = false, bool collection_write = false);
 
-    void put(const std::string & path, bool (*handler)(http_req & req, http_res & res), bool async = false);
+    void put(const std::string & path, bool (*handler)(http_req & req, http_res & res), bool async = false,
+             bool collection_write = false);
 
-    void del(const std::string & path, bool (*handler)(http_req & req, http_res & res), bool async = false);
+    void del(const std::string & path, bool (*handler)(http_req & req, http_res & res), bool async = false,
+             bool collection_write = false);
 
     void on(const std::string & message, bool (*handler)(void*));
 
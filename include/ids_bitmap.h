@@ -0,0 +1,357 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+
+/*
+ * Set of document ids that keeps an exact count of the distinct ids added so far.
+ * Used for accumulating the result ids of a query across suggestions and fields: adding a sorted
+ * array costs time proportional to its length, instead of re-merging everything accumulated so far.
+ *
+ * Up to `ARRAY_MAX_SIZE` ids are held as a sorted array. Past that they move to a bitmap that spans only the
+ * words from the smallest id to the largest, so that its size and the cost of scanning it follow the range
+ * of the ids held, not the largest id of the collection.
+ */
+class ids_bitmap {
+public:
+    static const size_t ARRAY_MAX_SIZE = 4096;
+
+private:
+    std::vector<uint32_t> array;  // sorted ids, while there are few of them
+    std::vector<uint64_t> words;  // bit `i` of `words[w]` stands for the id `(base_word + w) * 64 + i`
+    size_t base_word = 0;
+    size_t count = 0;
+    bool is_bitmap = false;
+
+    // widens the bitmap so that it spans the words of the ids from `min_id` to `max_id`
+    inline void ensure_range(const uint32_t min_id, const uint32_t max_id) {
+        const size_t min_word = min_id >> 6;
+        const size_t max_word = max_id >> 6;
+
+        if(words.empty()) {
+            base_word = min_word;
+            words.resize(max_word - min_word + 1, 0);
+            return ;
+        }
+
+        if(min_word < base_word) {
+            words.insert(words.begin(), base_word - min_word, 0);
+            base_word = min_word;
+        }
+
+        if(max_word >= base_word + words.size()) {
+            words.resize(max_word - base_word + 1, 0);
+        }
+    }
+
+    void to_bitmap() {
+        is_bitmap = true;
+
+        if(!array.empty()) {
+            ensure_range(array.front(), array.back());
+            for(const uint32_t id: array) {
+                words[(id >> 6) - base_word] |= uint64_t(1) << (id & 63);
+            }
+        }
+
+        std::vector<uint32_t>().swap(array);
+    }
+
+    // goes back to an array once a bitmap has lost most of its ids, and drops the empty words at its ends otherwise
+    void settle() {
+        if(!is_bitmap) {
+            return ;
+        }
+
+        if(count <= ARRAY_MAX_SIZE / 2) {
+            std::vector<uint32_t> ids;
+            ids.reserve(count);
+            append_ids(std::back_inserter(ids));
+
+            clear();
+            array.swap(ids);
+            count = array.size();
+            return ;
+        }
+
+        size_t first = 0;
+        while(words[first] == 0) {
+            first++;
+        }
+
+        size_t last = words.size();
+        while(words[last - 1] == 0) {
+            last--;
+        }
+
+        words.erase(words.begin() + last, words.end());
+        words.erase(words.begin(), words.begin() + first);
+        base_word += first;
+    }
+
+    template <class OutputIt>
+    void append_ids(OutputIt out) const {
+        if(!is_bitmap) {
+            std::copy(array.begin(), array.end(), out);
+            return ;
+        }
+
+        for(size_t i = 0; i < words.size(); i++) {
+            uint64_t word = words[i];
+            while(word != 0) {
+                *out++ = uint32_t(((base_word + i) << 6) + __builtin_ctzll(word));
+                word &= (word - 1);
+            }
+        }
+    }
+
+public:
+    // `ids` must be sorted
+    void add(const uint32_t* ids, const size_t ids_length) {
+        if(ids_length == 0) {
+            return ;
+        }
+
+        if(!is_bitmap) {
+            if(count + ids_length <= ARRAY_MAX_SIZE) {
+                std::vector<uint32_t> merged;
+                merged.reserve(count + ids_length);
+                std::set_union(array.begin(), array.end(), ids, ids + ids_length, std::back_inserter(merged));
+                array.swap(merged);
+                count = array.size();
+                return ;
+            }
+
+            to_bitmap();
+        }
+
+        ensure_range(ids[0], ids[ids_length - 1]);
+
+        for(size_t i = 0; i < ids_length; i++) {
+            const uint64_t bit = uint64_t(1) << (ids[i] & 63);
+            uint64_t & word = words[(ids[i] >> 6) - base_word];
+            count += ((word & bit) == 0);
+            word |= bit;
+        }
+    }
+
+    // adds the ids of a plain bitmap whose word `i` stands for the ids from `(first_word + i) * 64` on
+    void add_words(const uint64_t* src_words, const size_t num_words, const size_t first_word = 0) {
+        size_t first = 0;
+        while(first < num_words && src_words[first] == 0) {
+            first++;
+        }
+
+        if(first == num_words) {
+            return ;
+        }
+
+        size_t last = num_words;
+        while(src_words[last - 1] == 0) {
+            last--;
+        }
+
+        if(!is_bitmap) {
+            to_bitmap();
+        }
+
+        ensure_range(uint32_t((first_word + first) << 6), uint32_t((first_word + last - 1) << 6));
+
+        for(size_t i = first; i < last; i++) {
+            uint64_t & word = words[first_word + i - base_word];
+            count += __builtin_popcountll(src_words[i] & ~word);
+            word |= src_words[i];
+        }
+    }
+
+    void add(const ids_bitmap & other) {
+        if(other.is_bitmap) {
+            add_words(&other.words[0], other.words.size(), other.base_word);
+        } else if(!other.array.empty()) {
+            add(&other.array[0], other.array.size());
+        }
+    }
+
+    // `ids` need not be sorted
+    void remove(const uint32_t* ids, const size_t ids_length) {
+        if(count == 0 || ids_length == 0) {
+            return ;
+        }
+
+        if(!is_bitmap) {
+            std::vector<uint32_t> removed(ids, ids + ids_length);
+            std::sort(removed.begin(), removed.end());
+
+            std::vector<uint32_t> kept;
+            kept.reserve(count);
+            std::set_difference(array.begin(), array.end(), removed.begin(), removed.end(), std::back_inserter(kept));
+            array.swap(kept);
+            count = array.size();
+            return ;
+        }
+
+        for(size_t i = 0; i < ids_length; i++) {
+            const size_t word_index = ids[i] >> 6;
+            if(word_index < base_word || word_index - base_word >= words.size()) {
+                continue;
+            }
+
+            const uint64_t bit = uint64_t(1) << (ids[i] & 63);
+            uint64_t & word = words[word_index - base_word];
+            count -= ((word & bit) != 0);
+            word &= ~bit;
+        }
+
+        settle();
+    }
+
+    // drops the ids that are in `other`
+    void subtract(const ids_bitmap & other) {
+        if(count == 0 || other.count == 0) {
+            return ;
+        }
+
+        if(!is_bitmap) {
+            array.erase(std::remove_if(array.begin(), array.end(),
+                                       [&other](uint32_t id) { return other.contains(id); }), array.end());
+            count = array.size();
+            return ;
+        }
+
+        if(!other.is_bitmap) {
+            remove(&other.array[0], other.array.size());
+            return ;
+        }
+
+        // only the words both bitmaps span can change
+        const size_t from_word = std::max(base_word, other.base_word);
+        const size_t to_word = std::min(base_word + words.size(), other.base_word + other.words.size());
+
+        for(size_t w = from_word; w < to_word; w++) {
+            uint64_t & word = words[w - base_word];
+            const uint64_t dropped = word & other.words[w - other.base_word];
+            count -= __builtin_popcountll(dropped);
+            word &= ~dropped;
+        }
+
+        settle();
+    }
+
+    // keeps only the ids that are also in `other`
+    void intersect(const ids_bitmap & other) {
+        if(!is_bitmap) {
+            array.erase(std::remove_if(array.begin(), array.end(),
+                                       [&other](uint32_t id) { return !other.contains(id); }), array.end());
+            count = array.size();
+            return ;
+        }
+
+        if(!other.is_bitmap) {
+            std::vector<uint32_t> kept;
+            kept.reserve(other.count);
+
+            for(const uint32_t id: other.array) {
+                if(contains(id)) {
+                    kept.push_back(id);
+                }
+            }
+
+            clear();
+            array.swap(kept);
+            count = array.size();
+            return ;
+        }
+
+        // only the words both bitmaps span can hold ids of the intersection
+        const size_t from_word = std::max(base_word, other.base_word);
+        const size_t to_word = std::min(base_word + words.size(), other.base_word + other.words.size());
+
+        if(from_word >= to_word) {
+            clear();
+            return ;
+        }
+
+        std::vector<uint64_t> kept(to_word - from_word);
+        count = 0;
+
+        for(size_t w = from_word; w < to_word; w++) {
+            kept[w - from_word] = words[w - base_word] & other.words[w - other.base_word];
+            count += __builtin_popcountll(kept[w - from_word]);
+        }
+
+        words.swap(kept);
+        base_word = from_word;
+
+        if(count == 0) {
+            clear();
+            return ;
+        }
+
+        settle();
+    }
+
+    // keeps the ids of `ids` that are in the bitmap, writing them to the front of `ids`, and returns their number
+    size_t intersect(uint32_t* ids, const size_t ids_length) const {
+        size_t num_found = 0;
+
+        for(size_t i = 0; i < ids_length; i++) {
+            if(contains(ids[i])) {
+                ids[num_found++] = ids[i];
+            }
+        }
+
+        return num_found;
+    }
+
+    // keeps the ids of `ids` that are not in the bitmap, writing them to the front of `ids`, and returns their number
+    size_t exclude(uint32_t* ids, const size_t ids_length) const {
+        size_t num_kept = 0;
+
+        for(size_t i = 0; i < ids_length; i++) {
+            if(!contains(ids[i])) {
+                ids[num_kept++] = ids[i];
+            }
+        }
+
+        return num_kept;
+    }
+
+    bool contains(const uint32_t id) const {
+        if(!is_bitmap) {
+            return std::binary_search(array.begin(), array.end(), id);
+        }
+
+        const size_t word_index = id >> 6;
+        return word_index >= base_word && word_index - base_word < words.size() &&
+               (words[word_index - base_word] & (uint64_t(1) << (id & 63))) != 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    void clear() {
+        std::vector<uint32_t>().swap(array);
+        std::vector<uint64_t>().swap(words);
+        base_word = 0;
+        count = 0;
+        is_bitmap = false;
+    }
+
+    // allocates a sorted array of the ids in `ids_out` which the caller must free with delete[]
+    size_t to_array(uint32_t** ids_out) const {
+        if(count == 0) {
+            *ids_out = nullptr;
+            return 0;
+        }
+
+        uint32_t* ids = new uint32_t[count];
+        append_ids(ids);
+
+        *ids_out = ids;
+        return count;
+    }
+};
@@ -3,8 +3,6 @@
 #include <string>
 #include <unordered_map>
 #include <vector>
-#include <mutex>
-#include <condition_variable>
 #include <art.h>
 #include <number.h>
 #include <sparsepp.h>
@@ -14,6 +12,12 @@
 #include <field.h>
 #include <option.h>
 #include "string_utils.h"
+#include "ids_bitmap.h"
+#include "search_cutoff.h"
+#include "filter_result_cache.h"
+#include "search_stages.h"
+#include "posting_builder.h"
+#include "threadpool.h"
 
 struct token_candidates {
     std::string token;
@@ -21,6 +25,9 @@ struct token_candidates {
     std::vector<art_leaf*> candidates;
 };
 
+// leaves found for the tokens of a query in a field, keyed by the token followed by its typo cost
+typedef spp::sparse_hash_map<std::string, std::vector<art_leaf*>> token_leaves_t;
+
 struct search_args {
     std::string query;
     std::vector<std::string> search_fields;
@@ -39,13 +46,19 @@ struct search_args {
     bool prefix;
     size_t drop_tokens_threshold;
     size_t typo_tokens_threshold;
+    uint64_t search_stop_us;
+    std::string filter_query;
+    filter_result_cache_t* filter_cache;
+    uint64_t write_generation;
     std::vector<KV> raw_result_kvs;
     size_t all_result_ids_len;
     std::vector<std::vector<art_leaf*>> searched_queries;
     std::vector<KV> override_result_kvs;
+    bool search_cutoff;
+    search_stage_times_t stage_times;
     Option<uint32_t> outcome;
 
-    search_args(): outcome(0) {
+    search_args(): filter_cache(nullptr), write_generation(0), search_cutoff(false), outcome(0) {
 
     }
 
@@ -53,13 +66,15 @@ struct search_args {
                 std::vector<facet> facets, std::vector<uint32_t> included_ids, std::vector<uint32_t> excluded_ids,
                 std::vector<sort_by> sort_fields_std, facet_query_t facet_query, int num_typos, size_t max_facet_values,
                 size_t max_hits, size_t per_page, size_t page, token_ordering token_order, bool prefix,
-                size_t drop_tokens_threshold, size_t typo_tokens_threshold):
+                size_t drop_tokens_threshold, size_t typo_tokens_threshold, uint64_t search_stop_us,
+                std::string filter_query, filter_result_cache_t* filter_cache, uint64_t write_generation):
             query(query), search_fields(search_fields), filters(filters), facets(facets), included_ids(included_ids),
             excluded_ids(excluded_ids), sort_fields_std(sort_fields_std), facet_query(facet_query), num_typos(num_typos),
             max_facet_values(max_facet_values), max_hits(max_hits), per_page(per_page),
             page(page), token_order(token_order), prefix(prefix),
             drop_tokens_threshold(drop_tokens_threshold), typo_tokens_threshold(typo_tokens_threshold),
-            all_result_ids_len(0), outcome(0) {
+            search_stop_us(search_stop_us), filter_query(filter_query), filter_cache(filter_cache),
+            write_generation(write_generation), all_result_ids_len(0), search_cutoff(false), outcome(0) {
 
     }
 };
@@ -113,6 +128,19 @@ struct batch_index_result {
     }
 };
 
+// Memory held for a field: its trees (a non-string facet field has a second one of its values as strings),
+// and the facet and sort values of its documents
+struct field_memory_t {
+    art_memory tree = {};
+    size_t facet_bytes = 0;
+    size_t sort_bytes = 0;
+
+    size_t total_bytes() const {
+        return tree.node_bytes + tree.leaf_bytes + tree.posting_bytes + tree.position_bytes +
+               facet_bytes + sort_bytes;
+    }
+};
+
 class Index {
 private:
     const uint64_t FACET_ARRAY_DELIMETER = std::numeric_limits<uint64_t>::max();
@@ -135,7 +163,20 @@ private:
     // sort_field => (seq_id => value)
     spp::sparse_hash_map<std::string, spp::sparse_hash_map<uint32_t, int64_t>*> sort_index;
 
-    StringUtils string_utils;
+    // many queries can run against the same index concurrently, so each thread gets its own iconv handle
+    static thread_local StringUtils string_utils;
+
+    // set while a batch of documents is indexed, to gather their postings for adding to the leaves at the end
+    posting_builder* batch_postings = nullptr;
+
+    // runs the leaf lookups of the fields of a query in parallel, can be null
+    ThreadPool* search_pool;
+
+    // Removed documents, which are filtered out of searches until `compact` purges them from the leaves and the
+    // facet index. Sequence ids are never reused, so a removed id cannot come back.
+    ids_bitmap deleted_ids;
+
+    static void compact_tree(art_tree *t, const uint32_t* sorted_ids, const size_t ids_length);
 
     static inline std::vector<art_leaf *> next_suggestion(const std::vector<token_candidates> &token_candidates_vec,
                                                           long long int n);
@@ -155,21 +196,41 @@ private:
                       const std::string & field, uint32_t *filter_ids, size_t filter_ids_length,
                       std::vector<facet> & facets, const std::vector<sort_by> & sort_fields,
                       const int num_typos, std::vector<std::vector<art_leaf*>> & searched_queries,
-                      Topster & topster, uint32_t** all_result_ids,
-                      size_t & all_result_ids_len, const token_ordering token_order = FREQUENCY,
+                      Topster & topster, ids_bitmap & all_result_ids,
+                      const token_leaves_t & prefetched_leaves,
+                      const token_ordering token_order = FREQUENCY,
                       const bool prefix = false,
                       const size_t drop_tokens_threshold = Index::DROP_TOKENS_THRESHOLD,
                       const size_t typo_tokens_threshold = Index::TYPO_TOKENS_THRESHOLD);
 
+    void search_token_leaves(const std::string & field, const std::string & token, const int cost,
+                             const bool prefix_search, const token_ordering token_order,
+                             std::vector<art_leaf*> & leaves) const;
+
+    // looks up the leaves that `search_field` starts from: for each token, at every typo cost up to the first
+    // one that has any leaves
+    void prefetch_token_leaves(const std::string & query, const std::string & field, const int num_typos,
+                               const token_ordering token_order, const bool prefix,
+                               token_leaves_t & token_leaves) const;
+
+    void prefetch_fields_token_leaves(const std::string & query, const std::vector<std::string> & search_fields,
+                                      const size_t num_search_fields, const int num_typos,
+                                      const token_ordering token_order, const bool prefix,
+                                      std::vector<token_leaves_t> & field_token_leaves) const;
+
     void search_candidates(const uint8_t & field_id, uint32_t* filter_ids, size_t filter_ids_length,
                            const std::vector<sort_by> & sort_fields, std::vector<token_candidates> & token_to_candidates,
                            const token_ordering token_order, std::vector<std::vector<art_leaf*>> & searched_queries,
-                           Topster & topster, uint32_t** all_result_ids,
-                           size_t & all_result_ids_len,
+                           Topster & topster, ids_bitmap & all_result_ids,
                            const size_t typo_tokens_threshold);
 
+    // adds the document to the token's leaf, or to `batch_postings` during a batch
+    void insert_token(art_tree *t, const unsigned char *key, int key_len, art_document *document) const;
+
+    // when `store_positions` is false, only the ids of the tokens are indexed
     void insert_doc(const uint32_t score, art_tree *t, uint32_t seq_id,
-                    const std::unordered_map<std::string, std::vector<uint32_t>> &token_to_offsets) const;
+                    const std::unordered_map<std::string, std::vector<uint32_t>> &token_to_offsets,
+                    const bool store_positions = true) const;
 
     void index_string_field(const std::string & text, const uint32_t score, art_tree *t, uint32_t seq_id,
                             int facet_id, const field & a_field);
@@ -193,9 +254,6 @@ private:
     
     void index_bool_array_field(const std::vector<bool> & values, const uint32_t score, art_tree *t, uint32_t seq_id) const;
 
-    void remove_and_shift_offset_index(sorted_array &offset_index, const uint32_t *indices_sorted,
-                                       const uint32_t indices_length);
-
     void collate_curated_ids(const std::string & query, const std::string & field, const uint8_t field_id,
                              const std::vector<uint32_t> & included_ids,
                              Topster & curated_topster, std::vector<std::vector<art_leaf*>> & searched_queries);
@@ -209,11 +267,12 @@ public:
     Index() = delete;
 
     Index(const std::string name, const std::unordered_map<std::string, field> & search_schema,
-          std::map<std::string, field> facet_schema, std::unordered_map<std::string, field> sort_schema);
+          std::map<std::string, field> facet_schema, std::unordered_map<std::string, field> sort_schema,
+          ThreadPool* search_pool = nullptr);
 
     ~Index();
 
-    void run_search();
+    void run_search(search_args* search_params);
 
     void search(Option<uint32_t> & outcome, const std::string & query, const std::vector<std::string> & search_fields,
                           const std::vector<filter> & filters, std::vector<facet> & facets,
@@ -223,9 +282,18 @@ public:
                           const size_t max_hits, const size_t per_page, const size_t page, const token_ordering token_order,
                           const bool prefix, const size_t drop_tokens_threshold, std::vector<KV> & raw_result_kvs,
                           size_t & all_result_ids_len, std::vector<std::vector<art_leaf*>> & searched_queries,
-                          std::vector<KV> & override_result_kvs, const size_t typo_tokens_threshold);
+                          std::vector<KV> & override_result_kvs, const size_t typo_tokens_threshold,
+                          const std::string & filter_query, filter_result_cache_t* filter_cache,
+                          const uint64_t write_generation);
+
+    Option<uint32_t> remove(const uint32_t seq_id);
 
-    Option<uint32_t> remove(const uint32_t seq_id, nlohmann::json & document);
+    // purges up to `max_ids` removed documents from the leaves and the facet index, returning their number
+    size_t compact(const size_t max_ids);
+
+    size_t num_deleted() const {
+        return deleted_ids.size();
+    }
 
     art_leaf* get_token_leaf(const std::string & field_name, const unsigned char* token, uint32_t token_len);
 
@@ -234,6 +302,12 @@ public:
                                          size_t result_index,
                                          std::vector<std::vector<std::vector<uint16_t>>> &array_token_positions);
 
+    // `doc_indices` holds the index of the document within the ids of each leaf of `query_suggestion`, or the
+    // number of ids of that leaf when the document is not found in it
+    static void populate_token_positions(const std::vector<art_leaf *> &query_suggestion,
+                                         const uint32_t* doc_indices,
+                                         std::vector<std::vector<std::vector<uint16_t>>> &array_token_positions);
+
     void score_results(const std::vector<sort_by> & sort_fields, const uint16_t & query_index, const uint8_t & field_id,
                        const uint32_t total_cost, Topster &topster, const std::vector<art_leaf *> & query_suggestion,
                        const uint32_t *result_ids, const size_t result_size) const;
@@ -256,6 +330,12 @@ public:
 
     const spp::sparse_hash_map<std::string, art_tree *> &_get_search_index() const;
 
+    // adds the memory held for each field of this index to `field_memory`
+    void add_memory_usage(std::map<std::string, field_memory_t> & field_memory) const;
+
+    // adds the bytes held by the arenas of the trees of this index to `memory`, without walking the trees
+    void add_arena_usage(art_memory & memory) const;
+
     // for limiting number of results on multiple candidates / query rewrites
     enum {TYPO_TOKENS_THRESHOLD = 100};
 
@@ -266,22 +346,8 @@ public:
     // in the query that have the least individual hits one by one until enough results are found.
     static const int DROP_TOKENS_THRESHOLD = 10;
 
-    /*
-     * Concurrency Primitives
-    */
-
-    // Used for passing control back and forth between main and worker threads
-    std::mutex m;
-    std::condition_variable cv;
-
-    bool ready;       // prevents spurious wake up of the worker thread
-    bool processed;   // prevents spurious wake up of the main thread
-    bool terminate;   // used for interrupting the thread during tear down
-
-    search_args search_params;
-
     static void populate_array_token_positions(std::vector<std::vector<std::vector<uint16_t>>> & array_token_positions,
-                                               const art_leaf *token_leaf, uint32_t doc_index);
+                                               const std::vector<uint32_t> & doc_positions);
 
     int get_bounded_typo_cost(const size_t max_cost, const size_t token_len) const;
 
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include "threadpool.h"
+
+/*
+ * Calls `fn(i)` for each `i` below `n` on the calling thread and on up to `n - 1` tasks of `pool`, or only on the
+ * calling thread when `pool` is null, and returns once all the calls are done. An exception thrown by a call is
+ * rethrown here, after the other calls have finished.
+ *
+ * The calls are claimed one at a time by whichever thread gets to them first. The calling thread only ever waits for
+ * calls that another thread is already running, never for a task that is still queued, so this is safe to use from a
+ * task of the same pool even when all its threads are busy. Tasks that start late find nothing left to claim.
+ */
+inline void parallel_for(ThreadPool* pool, const size_t n, const std::function<void(size_t)> & fn) {
+    if(pool == nullptr || n <= 1) {
+        for(size_t i = 0; i < n; i++) {
+            fn(i);
+        }
+
+        return ;
+    }
+
+    struct state_t {
+        std::atomic<size_t> next;
+        size_t num_pool_done;
+        std::exception_ptr error;
+        std::mutex mutex;
+        std::condition_variable cv;
+
+        state_t(): next(0), num_pool_done(0) {
+
+        }
+    };
+
+    std::shared_ptr<state_t> state = std::make_shared<state_t>();
+    const std::function<void(size_t)>* fn_ptr = &fn;
+
+    for(size_t t = 1; t < n; t++) {
+        pool->enqueue([state, fn_ptr, n]() {
+            size_t i;
+
+            while((i = state->next++) < n) {
+                std::exception_ptr error;
+
+                try {
+                    (*fn_ptr)(i);
+                } catch(...) {
+                    error = std::current_exception();
+                }
+
+                std::lock_guard<std::mutex> lock(state->mutex);
+
+                if(error && !state->error) {
+                    state->error = error;
+                }
+
+                state->num_pool_done++;
+                state->cv.notify_one();
+            }
+        });
+    }
+
+    size_t num_done = 0;
+    std::exception_ptr error;
+    size_t i;
+
+    while((i = state->next++) < n) {
+        try {
+            fn(i);
+        } catch(...) {
+            if(!error) {
+                error = std::current_exception();
+            }
+        }
+
+        num_done++;
+    }
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cv.wait(lock, [&state, num_done, n]() {
+        return num_done + state->num_pool_done == n;
+    });
+
+    if(!error) {
+        error = state->error;
+    }
+
+    if(error) {
+        std::rethrow_exception(error);
+    }
+}
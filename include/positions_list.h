@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "sorted_array.h"
+
+/*
+ * Token positions of every document of a leaf, in the same order as the leaf's ids. The positions of a document
+ * are delta encoded against the previous value and written as zigzag varints to a single byte stream, while the
+ * start of each document's bytes is kept in a frame-of-reference compressed array.
+ *
+ * Positions within a string grow, so most deltas fit in a byte. The end-of-element markers of an array field
+ * (a repeat of the last position followed by the element's index) take a zero delta and a small negative one.
+ * A document indexed without positions has an empty stream and costs only its entry in the starts array.
+ */
+class positions_list {
+private:
+    uint8_t* data = nullptr;
+    uint32_t data_length = 0;
+    uint32_t data_capacity = 0;
+
+    sorted_array doc_starts;
+
+    uint32_t doc_end(uint32_t doc_index) {
+        return (doc_index + 1 == doc_starts.getLength()) ? data_length : doc_starts.at(doc_index + 1);
+    }
+
+    bool reserve(uint32_t size);
+
+    // writes the zigzag varint deltas of `positions` to the end of the stream, which must have room for them
+    void encode(const uint32_t* positions, uint32_t positions_length);
+
+public:
+    positions_list() = default;
+
+    positions_list(const positions_list &) = delete;
+    positions_list & operator=(const positions_list &) = delete;
+
+    ~positions_list() {
+        free(data);
+        data = nullptr;
+    }
+
+    // adds the positions of the next document: returns false if malloc fails
+    bool append(const uint32_t* positions, uint32_t positions_length);
+
+    // adds the positions of the next `num_docs` documents, which are back to back in `positions`
+    bool append(const uint32_t* positions, const uint32_t* positions_lengths, uint32_t num_docs);
+
+    // replaces the contents of `positions` with the positions of the document at `doc_index`
+    void get(uint32_t doc_index, std::vector<uint32_t> & positions);
+
+    void remove(uint32_t doc_index);
+
+    void remove(const uint32_t* sorted_doc_indices, uint32_t num_indices);
+
+    uint32_t getSizeInBytes() {
+        return data_capacity + doc_starts.getSizeInBytes();
+    }
+
+    // number of documents
+    uint32_t getLength() {
+        return doc_starts.getLength();
+    }
+};
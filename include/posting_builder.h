@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "art.h"
+
+/*
+ * Gathers the postings of a batch of documents by token, so that every token's leaf is looked up and added to
+ * once per batch, instead of once per document. The documents of a batch must be added in ascending order of id,
+ * as they are by imports and by the reload of a collection on startup.
+ */
+class posting_builder {
+private:
+    struct token_run_t {
+        int32_t max_score = INT32_MIN;
+        std::vector<uint32_t> ids;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> offsets_lens;
+    };
+
+    std::unordered_map<art_tree*, std::unordered_map<std::string, token_run_t>> tree_runs;
+
+public:
+    void add(art_tree *t, const unsigned char *key, int key_len, const art_document *document);
+
+    // adds the gathered runs to their trees and clears them
+    void build();
+};
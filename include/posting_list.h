@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "sorted_array.h"
+#include "ids_bitmap.h"
+
+/*
+ * Sorted list of document ids, stored as a sequence of frame-of-reference compressed blocks of `BLOCK_SIZE` ids.
+ * Every block is full, so that the block of an index is known without a search, and the min/max kept by each block
+ * lets a search skip whole blocks without decoding them. Ids past the last full block are appended to an
+ * uncompressed tail, which is compressed into a block once it fills up, so that an append does not re-pack anything.
+ *
+ * A list that covers a large share of the ids below its max (a boolean field, an enum-like string) is instead held
+ * as a bitmap, which is smaller than the blocks at that density and can be combined with other bitmaps word by word.
+ */
+class posting_list {
+public:
+    static const uint32_t BLOCK_SIZE = 128;
+
+    // a list switches to a bitmap once it has this many ids, averaging at most `DENSE_MAX_GAP` between them
+    static const uint32_t DENSE_MIN_LENGTH = 1024;
+    static const uint32_t DENSE_MAX_GAP = 8;
+
+    // Forward iterator over the ids of a posting list, which decodes only the blocks it stops in.
+    class iterator_t {
+    private:
+        posting_list* list;
+        size_t block_index;
+        uint32_t block_length;
+        uint32_t offset;
+        uint32_t block_base_index;  // index of the first id of the block within the list
+        uint32_t block_ids[BLOCK_SIZE];
+
+        void load_block();
+
+    public:
+        explicit iterator_t(posting_list* list);
+
+        bool valid() const {
+            return offset < block_length;
+        }
+
+        uint32_t id() const {
+            return block_ids[offset];
+        }
+
+        // index of the current id within the list
+        uint32_t index() const {
+            return block_base_index + offset;
+        }
+
+        void next();
+
+        // moves to the first id that is not smaller than `id`
+        void advance_to(uint32_t id);
+    };
+
+private:
+    // a bitmap of the ids, along with the number of ids before every `RANK_SPAN_WORDS` words of it
+    struct dense_ids_t {
+        static const size_t RANK_SPAN_WORDS = 8;
+
+        std::vector<uint64_t> words;  // bit `i` of `words[w]` stands for the id `w * 64 + i`
+        std::vector<uint32_t> ranks;
+        uint32_t length = 0;
+
+        void add(uint32_t id);
+        bool contains(uint32_t id) const;
+        uint32_t rank(uint32_t id) const;
+        uint32_t select(uint32_t index) const;
+        size_t intersect(uint32_t* ids, size_t ids_length) const;
+    };
+
+    std::vector<sorted_array> blocks;
+    dense_ids_t* dense = nullptr;
+    uint32_t* tail = nullptr;
+    uint32_t tail_capacity = 0;
+    uint32_t length = 0;
+
+    // the tail counts as the block after the compressed ones
+    uint32_t tail_length() const {
+        return (dense == nullptr) ? uint32_t(length - blocks.size() * BLOCK_SIZE) : 0;
+    }
+
+    uint32_t block_max(size_t block_index);
+
+    uint32_t num_block_ids(size_t block_index) const {
+        return (block_index < blocks.size()) ? BLOCK_SIZE : tail_length();
+    }
+
+    // offset of the value within the block, or the block's length when it is not found there
+    uint32_t block_offset_of(size_t block_index, uint32_t value);
+
+    size_t find_block(uint32_t value, size_t from_block);
+
+    size_t num_blocks() const;
+
+    void clear();
+
+    void load_blocks(const uint32_t *sorted_array, const uint32_t array_length);
+
+    void load_dense(const uint32_t *sorted_array, const uint32_t array_length);
+
+    static bool is_dense(uint32_t length, uint32_t max_id) {
+        return length >= DENSE_MIN_LENGTH && max_id / DENSE_MAX_GAP < length;
+    }
+
+public:
+    posting_list() = default;
+
+    posting_list(const posting_list &) = delete;
+    posting_list & operator=(const posting_list &) = delete;
+
+    ~posting_list() {
+        clear();
+    }
+
+    void load(const uint32_t *sorted_array, const uint32_t array_length);
+
+    uint32_t at(uint32_t index);
+
+    bool contains(uint32_t value);
+
+    uint32_t indexOf(uint32_t value);
+
+    void indexOf(const uint32_t *values, const size_t values_len, uint32_t* indices);
+
+    // `value` must be greater than every id in the list
+    bool append(uint32_t value);
+
+    // sorted `values` must be greater than every id in the list: whole blocks of them are compressed directly
+    bool append(const uint32_t* values, uint32_t values_length);
+
+    void remove_values(uint32_t *sorted_values, uint32_t values_length);
+
+    uint32_t* uncompress();
+
+    // Retains the ids of sorted `ids` that are present in this list, writing them to the front of `ids`.
+    // Returns the number of ids retained.
+    size_t intersect(uint32_t* ids, size_t ids_length);
+
+    // adds the ids of this list to `bitmap`: a dense list does so word by word
+    void add_to(ids_bitmap & bitmap);
+
+    bool is_dense() const {
+        return dense != nullptr;
+    }
+
+    iterator_t new_iterator() {
+        return iterator_t(this);
+    }
+
+    uint32_t getSizeInBytes();
+
+    uint32_t getLength() const {
+        return length;
+    }
+};
@@ -86,6 +86,9 @@ private:
     ThreadPool* thread_pool;
     http_message_dispatcher* message_dispatcher;
 
+    // applies a write that has been committed to the log: invoked on the state machine's own thread
+    bool (*write_applier)(void*);
+
     std::atomic<size_t> init_readiness_count;
 
     bool create_init_db_snapshot;
@@ -97,7 +100,7 @@ public:
     static constexpr const char* snapshot_dir_name = "snapshot";
 
     ReplicationState(Store* store, ThreadPool* thread_pool, http_message_dispatcher* message_dispatcher,
-                     bool create_init_db_snapshot);
+                     bool (*write_applier)(void*), bool create_init_db_snapshot);
 
     ~ReplicationState() {
         delete node;
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <pthread.h>
+
+// Many readers or a single writer. Searches running on worker threads hold a read lock, while writes applied by the
+// raft state machine hold the write lock. Writers are preferred: once a writer waits, new readers queue up behind it,
+// so that a steady stream of searches cannot starve the write path. A thread must therefore never take the same
+// lock for reading twice, since the inner acquire would wait on the queued writer.
+class rw_lock_t {
+private:
+    pthread_rwlock_t lock;
+
+public:
+    rw_lock_t() {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+        pthread_rwlock_init(&lock, &attr);
+        pthread_rwlockattr_destroy(&attr);
+    }
+
+    ~rw_lock_t() {
+        pthread_rwlock_destroy(&lock);
+    }
+
+    rw_lock_t(const rw_lock_t&) = delete;
+    rw_lock_t& operator=(const rw_lock_t&) = delete;
+
+    void lock_read() {
+        pthread_rwlock_rdlock(&lock);
+    }
+
+    void lock_write() {
+        pthread_rwlock_wrlock(&lock);
+    }
+
+    void unlock() {
+        pthread_rwlock_unlock(&lock);
+    }
+};
+
+struct read_lock_guard {
+    rw_lock_t& rw_lock;
+
+    explicit read_lock_guard(rw_lock_t& rw_lock): rw_lock(rw_lock) {
+        rw_lock.lock_read();
+    }
+
+    ~read_lock_guard() {
+        rw_lock.unlock();
+    }
+};
+
+struct write_lock_guard {
+    rw_lock_t& rw_lock;
+
+    explicit write_lock_guard(rw_lock_t& rw_lock): rw_lock(rw_lock) {
+        rw_lock.lock_write();
+    }
+
+    ~write_lock_guard() {
+        rw_lock.unlock();
+    }
+};
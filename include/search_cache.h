@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include "json.hpp"
+
+/*
+ * Memory bounded LRU cache of search results, shared by all collections. Every entry remembers the write
+ * generation of its collection at the time of the search, so a write to the collection turns its entries into
+ * misses without having to walk the cache.
+ */
+class SearchCache {
+private:
+    struct entry_t {
+        std::string key;
+        uint64_t write_generation;
+        nlohmann::json result;
+        size_t num_bytes;
+    };
+
+    // most recently used entry is at the front
+    std::list<entry_t> entries;
+    std::unordered_map<std::string, std::list<entry_t>::iterator> key_to_entry;
+
+    size_t max_bytes;
+    size_t num_bytes;
+
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+
+    std::mutex mutex;
+
+    void erase(std::list<entry_t>::iterator entry_it);
+
+public:
+    SearchCache(): max_bytes(0), num_bytes(0), hits(0), misses(0) {
+
+    }
+
+    SearchCache(const SearchCache&) = delete;
+    SearchCache& operator=(const SearchCache&) = delete;
+
+    // a limit of 0 disables the cache
+    void set_max_bytes(size_t max_bytes);
+
+    bool is_enabled() const {
+        return max_bytes != 0;
+    }
+
+    bool get(const std::string & key, uint64_t write_generation, nlohmann::json & result);
+
+    void put(const std::string & key, uint64_t write_generation, const nlohmann::json & result);
+
+    void clear();
+
+    uint64_t get_hits() const {
+        return hits;
+    }
+
+    uint64_t get_misses() const {
+        return misses;
+    }
+
+    size_t get_num_bytes();
+};
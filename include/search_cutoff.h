@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+
+/*
+ * Cooperative time budget of a search.
+ *
+ * The deadline is tracked per thread: Index::run_search arms it, and work on the same search that is handed off
+ * to another thread must arm that thread too. Loops that can run for long poll `exceeded()` and wind down when it
+ * returns true, keeping whatever results were found so far.
+ */
+class search_cutoff {
+private:
+    // microseconds on the steady clock after which the search must stop, 0 when there is no budget
+    static thread_local uint64_t stop_us;
+    static thread_local bool cutoff;
+    static thread_local uint32_t num_polls;
+
+public:
+    static uint64_t now_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // returns the deadline for a budget starting now, 0 (no deadline) when `cutoff_ms` is 0
+    static uint64_t get_stop_us(const size_t cutoff_ms) {
+        return (cutoff_ms == 0) ? 0 : now_us() + cutoff_ms * 1000;
+    }
+
+    // the deadline armed on this thread, for arming other threads that work on the same search
+    static uint64_t get_stop_us() {
+        return stop_us;
+    }
+
+    static void arm(const uint64_t search_stop_us) {
+        stop_us = search_stop_us;
+        cutoff = false;
+        num_polls = 0;
+    }
+
+    static bool is_cutoff() {
+        return cutoff;
+    }
+
+    // reads the clock on every call, meant for loops whose iterations do a fair amount of work
+    static bool exceeded() {
+        if(stop_us == 0) {
+            return false;
+        }
+
+        if(!cutoff && now_us() >= stop_us) {
+            cutoff = true;
+        }
+
+        return cutoff;
+    }
+
+    // reads the clock only once every 256 calls, meant for tight loops
+    static bool exceeded_sampled() {
+        if(stop_us == 0 || cutoff) {
+            return cutoff;
+        }
+
+        if((++num_polls & 255) != 0) {
+            return false;
+        }
+
+        return exceeded();
+    }
+};
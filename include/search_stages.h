@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
+#include "json.hpp"
+
+enum search_stage_t {
+    TOKENIZE = 0,
+    FUZZY,
+    INTERSECT,
+    FILTER,
+    SCORE,
+    FACET,
+    MERGE,
+    HYDRATE,
+    HIGHLIGHT,
+    NUM_SEARCH_STAGES
+};
+
+// time spent in each stage of a search, summed over all the threads that worked on it
+struct search_stage_times_t {
+    uint64_t stage_us[NUM_SEARCH_STAGES];
+
+    // whether the stage ran at all, since a stage that ran can still take less than a microsecond
+    bool ran[NUM_SEARCH_STAGES];
+
+    // the result came from the search cache, so no stage was run and the times above are all zero
+    bool from_cache;
+
+    search_stage_times_t(): from_cache(false) {
+        for(size_t i = 0; i < NUM_SEARCH_STAGES; i++) {
+            stage_us[i] = 0;
+            ran[i] = false;
+        }
+    }
+
+    void add(const search_stage_times_t & other) {
+        for(size_t i = 0; i < NUM_SEARCH_STAGES; i++) {
+            stage_us[i] += other.stage_us[i];
+            ran[i] = ran[i] || other.ran[i];
+        }
+    }
+
+    nlohmann::json to_json() const;
+};
+
+/*
+ * Accumulates stage times of the search running on the current thread. Collection::search and Index::run_search
+ * reset it and collect the times once done: work handed off to another thread must be collected on that thread
+ * and added back.
+ */
+class search_stage_timer {
+private:
+    static thread_local search_stage_times_t times;
+
+    const search_stage_t stage;
+    const std::chrono::steady_clock::time_point begin;
+
+public:
+    // times the enclosing scope
+    explicit search_stage_timer(const search_stage_t stage): stage(stage), begin(std::chrono::steady_clock::now()) {
+
+    }
+
+    ~search_stage_timer() {
+        times.stage_us[stage] += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - begin).count();
+        times.ran[stage] = true;
+    }
+
+    static void reset() {
+        times = search_stage_times_t();
+    }
+
+    static const search_stage_times_t & get_times() {
+        return times;
+    }
+
+    static void add(const search_stage_times_t & other_times) {
+        times.add(other_times);
+    }
+};
+
+// Histogram of stage latencies with power of two microsecond buckets, shared by all searches
+class search_stage_histograms {
+private:
+    static const size_t NUM_BUCKETS = 32;
+
+    std::atomic<uint64_t> buckets[NUM_SEARCH_STAGES][NUM_BUCKETS];
+    std::atomic<uint64_t> counts[NUM_SEARCH_STAGES];
+    std::atomic<uint64_t> sums_us[NUM_SEARCH_STAGES];
+
+    search_stage_histograms();
+
+    uint64_t get_percentile(size_t stage, double percentile) const;
+
+public:
+    static search_stage_histograms & get_instance() {
+        static search_stage_histograms instance;
+        return instance;
+    }
+
+    search_stage_histograms(const search_stage_histograms&) = delete;
+    void operator=(const search_stage_histograms&) = delete;
+
+    // records the stages of a search that ran, leaving out those it had no use for
+    void record(const search_stage_times_t & times);
+
+    nlohmann::json to_json() const;
+};
+
+extern const char* const SEARCH_STAGE_NAMES[NUM_SEARCH_STAGES];
@@ -6,6 +6,14 @@ uint32_t* array_base::uncompress() {
     return out;
 }
 
+void array_base::uncompress(uint32_t* out) {
+    for_uncompress(in, out, length);
+}
+
+uint32_t array_base::getMax() {
+    return max;
+}
+
 uint32_t array_base::getSizeInBytes() {
     return size_bytes;
 }
@@ -1,15 +1,16 @@
 #include "array_utils.h"
 #include <memory.h>
+#include <algorithm>
+#include "ids_bitmap.h"
 
-size_t ArrayUtils::and_scalar(const uint32_t *A, const size_t lenA,
-                              const uint32_t *B, const size_t lenB, uint32_t **results) {
-  if (lenA == 0 || lenB == 0) {
-    return 0;
-  }
-
-  *results = new uint32_t[std::min(lenA, lenB)];
-  uint32_t *out = *results;
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ARRAY_UTILS_SIMD
+#include <immintrin.h>
+#endif
 
+// Fast scalar scheme designed by N. Kurz. `out` may point into `A` as long as it does not run ahead of it.
+static size_t and_merge_scalar(const uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB,
+                               uint32_t *out) {
   const uint32_t *const initout(out);
   const uint32_t *endA = A + lenA;
   const uint32_t *endB = B + lenB;
@@ -36,6 +37,306 @@ size_t ArrayUtils::and_scalar(const uint32_t *A, const size_t lenA,
   return (out - initout); // NOTREACHED
 }
 
+static size_t and_merge_scalar_inplace(uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB) {
+  return and_merge_scalar(A, lenA, B, lenB, A);
+}
+
+#ifdef ARRAY_UTILS_SIMD
+
+/*
+ * The SIMD merges compare a block of `A` with every rotation of a block of `B`, remember which lanes of the `A`
+ * block were found, and pack those lanes to the front of the output once the `A` block is done with. Since the
+ * output never runs ahead of the block being read, the intersected set can be written over `A` itself.
+ */
+
+// control vectors that pack the lanes set in a mask to the front of a vector
+struct simd_pack_tables_t {
+  alignas(16) uint8_t sse[16][16];
+  alignas(32) uint32_t avx2[256][8];
+
+  simd_pack_tables_t() {
+    for(size_t mask = 0; mask < 16; mask++) {
+      size_t num_packed = 0;
+      memset(sse[mask], 0x80, sizeof(sse[mask]));
+
+      for(size_t lane = 0; lane < 4; lane++) {
+        if(mask & (1 << lane)) {
+          for(size_t byte = 0; byte < 4; byte++) {
+            sse[mask][num_packed*4 + byte] = uint8_t(lane*4 + byte);
+          }
+          num_packed++;
+        }
+      }
+    }
+
+    for(size_t mask = 0; mask < 256; mask++) {
+      size_t num_packed = 0;
+      memset(avx2[mask], 0, sizeof(avx2[mask]));
+
+      for(size_t lane = 0; lane < 8; lane++) {
+        if(mask & (1 << lane)) {
+          avx2[mask][num_packed++] = uint32_t(lane);
+        }
+      }
+    }
+  }
+};
+
+static const simd_pack_tables_t simd_pack_tables;
+
+// Merges what is left after the blocks: `lanes` holds the last block of `A` read at `i`, with `matched` lanes found
+// in the blocks of `B` before `j`. Those lanes are all smaller than B[j], so they are written out and skipped.
+static size_t and_merge_tail_inplace(uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB,
+                                     size_t i, size_t j, size_t out,
+                                     const uint32_t *lanes, const size_t num_lanes, const int matched) {
+  if(lanes != nullptr) {
+    for(size_t lane = 0; lane < num_lanes; lane++) {
+      if(matched & (1 << lane)) {
+        A[out++] = lanes[lane];
+      }
+    }
+
+    while(i < lenA && j < lenB && A[i] < B[j]) {
+      i++;
+    }
+  }
+
+  if(i == lenA || j == lenB) {
+    return out;
+  }
+
+  return out + and_merge_scalar(A + i, lenA - i, B + j, lenB - j, A + out);
+}
+
+__attribute__((target("sse4.1")))
+static size_t and_merge_sse_inplace(uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB) {
+  const size_t BLOCK = 4;
+  size_t i = 0, j = 0, out = 0;
+
+  if(lenA < BLOCK || lenB < BLOCK) {
+    return and_merge_scalar_inplace(A, lenA, B, lenB);
+  }
+
+  __m128i a = _mm_loadu_si128((const __m128i *) A);
+  uint32_t a_max = A[BLOCK - 1];
+  int matched = 0;
+
+  while(true) {
+    const __m128i b = _mm_loadu_si128((const __m128i *) (B + j));
+    const uint32_t b_max = B[j + BLOCK - 1];
+
+    const __m128i cmp = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi32(a, b), _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1)))),
+      _mm_or_si128(_mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))),
+                   _mm_cmpeq_epi32(a, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3))))
+    );
+
+    matched |= _mm_movemask_ps(_mm_castsi128_ps(cmp));
+
+    const bool advance_a = (a_max <= b_max);
+    const bool advance_b = (b_max <= a_max);
+
+    if(advance_a) {
+      const __m128i pack = _mm_load_si128((const __m128i *) simd_pack_tables.sse[matched]);
+      _mm_storeu_si128((__m128i *) (A + out), _mm_shuffle_epi8(a, pack));
+      out += __builtin_popcount(matched);
+      matched = 0;
+      i += BLOCK;
+    }
+
+    if(advance_b) {
+      j += BLOCK;
+    }
+
+    if(i + BLOCK > lenA || j + BLOCK > lenB) {
+      break;
+    }
+
+    if(advance_a) {
+      a = _mm_loadu_si128((const __m128i *) (A + i));
+      a_max = A[i + BLOCK - 1];
+    }
+  }
+
+  if(i + BLOCK <= lenA) {
+    // the block at `i` was not done with
+    alignas(16) uint32_t lanes[BLOCK];
+    _mm_store_si128((__m128i *) lanes, a);
+    return and_merge_tail_inplace(A, lenA, B, lenB, i, j, out, lanes, BLOCK, matched);
+  }
+
+  return and_merge_tail_inplace(A, lenA, B, lenB, i, j, out, nullptr, 0, 0);
+}
+
+__attribute__((target("avx2")))
+static size_t and_merge_avx2_inplace(uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB) {
+  const size_t BLOCK = 8;
+  size_t i = 0, j = 0, out = 0;
+
+  if(lenA < BLOCK || lenB < BLOCK) {
+    return and_merge_sse_inplace(A, lenA, B, lenB);
+  }
+
+  const __m256i rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+
+  __m256i a = _mm256_loadu_si256((const __m256i *) A);
+  uint32_t a_max = A[BLOCK - 1];
+  int matched = 0;
+
+  while(true) {
+    __m256i b = _mm256_loadu_si256((const __m256i *) (B + j));
+    const uint32_t b_max = B[j + BLOCK - 1];
+
+    __m256i cmp = _mm256_cmpeq_epi32(a, b);
+    for(size_t rotation = 1; rotation < BLOCK; rotation++) {
+      b = _mm256_permutevar8x32_epi32(b, rotate);
+      cmp = _mm256_or_si256(cmp, _mm256_cmpeq_epi32(a, b));
+    }
+
+    matched |= _mm256_movemask_ps(_mm256_castsi256_ps(cmp));
+
+    const bool advance_a = (a_max <= b_max);
+    const bool advance_b = (b_max <= a_max);
+
+    if(advance_a) {
+      const __m256i pack = _mm256_load_si256((const __m256i *) simd_pack_tables.avx2[matched]);
+      _mm256_storeu_si256((__m256i *) (A + out), _mm256_permutevar8x32_epi32(a, pack));
+      out += __builtin_popcount(matched);
+      matched = 0;
+      i += BLOCK;
+    }
+
+    if(advance_b) {
+      j += BLOCK;
+    }
+
+    if(i + BLOCK > lenA || j + BLOCK > lenB) {
+      break;
+    }
+
+    if(advance_a) {
+      a = _mm256_loadu_si256((const __m256i *) (A + i));
+      a_max = A[i + BLOCK - 1];
+    }
+  }
+
+  if(i + BLOCK <= lenA) {
+    // the block at `i` was not done with
+    alignas(32) uint32_t lanes[BLOCK];
+    _mm256_store_si256((__m256i *) lanes, a);
+    return and_merge_tail_inplace(A, lenA, B, lenB, i, j, out, lanes, BLOCK, matched);
+  }
+
+  return and_merge_tail_inplace(A, lenA, B, lenB, i, j, out, nullptr, 0, 0);
+}
+
+#endif
+
+typedef size_t (*and_inplace_t)(uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB);
+
+// picks the widest merge that the CPU we are running on supports
+static and_inplace_t get_and_merge_inplace() {
+#ifdef ARRAY_UTILS_SIMD
+  __builtin_cpu_init();
+
+  if(__builtin_cpu_supports("avx2")) {
+    return and_merge_avx2_inplace;
+  }
+
+  if(__builtin_cpu_supports("sse4.1")) {
+    return and_merge_sse_inplace;
+  }
+#endif
+
+  return and_merge_scalar_inplace;
+}
+
+static const and_inplace_t and_merge_inplace = get_and_merge_inplace();
+
+// index of the first element not below `target`, probing `arr` from `begin` in exponentially growing steps
+static size_t gallop(const uint32_t *arr, const size_t begin, const size_t len, const uint32_t target) {
+  if(begin >= len || arr[begin] >= target) {
+    return begin;
+  }
+
+  // arr[low] < target
+  size_t low = begin;
+  size_t step = 1;
+
+  while(low + step < len && arr[low + step] < target) {
+    low += step;
+    step <<= 1;
+  }
+
+  const size_t high = std::min(low + step, len);
+  return std::lower_bound(arr + low + 1, arr + high, target) - arr;
+}
+
+size_t ArrayUtils::and_galloping_inplace(uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB) {
+  size_t i = 0, j = 0, out = 0;
+
+  if(lenA <= lenB) {
+    for(i = 0; i < lenA; i++) {
+      j = gallop(B, j, lenB, A[i]);
+      if(j == lenB) {
+        break;
+      }
+
+      if(B[j] == A[i]) {
+        A[out++] = A[i];
+      }
+    }
+  } else {
+    for(j = 0; j < lenB; j++) {
+      i = gallop(A, i, lenA, B[j]);
+      if(i == lenA) {
+        break;
+      }
+
+      if(A[i] == B[j]) {
+        A[out++] = A[i++];
+      }
+    }
+  }
+
+  return out;
+}
+
+size_t ArrayUtils::and_inplace(uint32_t *A, const size_t lenA, const uint32_t *B, const size_t lenB) {
+  if (lenA == 0 || lenB == 0) {
+    return 0;
+  }
+
+  const size_t shorter = std::min(lenA, lenB);
+  const size_t longer = std::max(lenA, lenB);
+
+  if(longer / shorter >= GALLOPING_RATIO) {
+    return and_galloping_inplace(A, lenA, B, lenB);
+  }
+
+  return and_merge_inplace(A, lenA, B, lenB);
+}
+
+size_t ArrayUtils::and_scalar(const uint32_t *A, const size_t lenA,
+                              const uint32_t *B, const size_t lenB, uint32_t **results) {
+  if (lenA == 0 || lenB == 0) {
+    return 0;
+  }
+
+  // intersect in place over a copy of the shorter list
+  if(lenA > lenB) {
+    std::swap(A, B);
+  }
+
+  const size_t len_shorter = std::min(lenA, lenB);
+  const size_t len_longer = std::max(lenA, lenB);
+
+  *results = new uint32_t[len_shorter];
+  memcpy(*results, A, len_shorter * sizeof(uint32_t));
+
+  return and_inplace(*results, len_shorter, B, len_longer);
+}
+
 // merges two sorted arrays and also removes duplicates
 size_t ArrayUtils::or_scalar(const uint32_t *A, const size_t lenA,
                              const uint32_t *B, const size_t lenB, uint32_t **out) {
@@ -102,6 +403,87 @@ size_t ArrayUtils::or_scalar(const uint32_t *A, const size_t lenA,
   return res_index;
 }
 
+size_t ArrayUtils::or_many(const std::vector<std::pair<uint32_t*, size_t>> & arrays, uint32_t **out) {
+  size_t total_length = 0;
+  uint32_t max_id = 0;
+
+  // (array index, position within that array)
+  typedef std::pair<size_t, size_t> cursor_t;
+  std::vector<cursor_t> heap;
+
+  for(size_t i = 0; i < arrays.size(); i++) {
+    if(arrays[i].second != 0) {
+      total_length += arrays[i].second;
+      max_id = std::max(max_id, arrays[i].first[arrays[i].second - 1]);
+      heap.emplace_back(i, 0);
+    }
+  }
+
+  if(heap.empty()) {
+    *out = nullptr;
+    return 0;
+  }
+
+  if(heap.size() <= 2) {
+    const std::pair<uint32_t*, size_t> & first = arrays[heap[0].first];
+    const std::pair<uint32_t*, size_t> & second = (heap.size() == 2) ? arrays[heap[1].first] :
+                                                  std::pair<uint32_t*, size_t>(nullptr, 0);
+    return or_scalar(first.first, first.second, second.first, second.second, out);
+  }
+
+  // when the ids are dense enough that scanning a bitmap of the whole id range costs no more than reading the
+  // inputs, setting bits beats merging
+  if(size_t(max_id / 64) <= total_length) {
+    ids_bitmap bitmap;
+
+    for(const std::pair<uint32_t*, size_t> & array: arrays) {
+      bitmap.add(array.first, array.second);
+    }
+
+    return bitmap.to_array(out);
+  }
+
+  // min-heap: the cursor pointing to the smallest id is on top
+  auto cursor_greater = [&arrays](const cursor_t & a, const cursor_t & b) -> bool {
+    return arrays[a.first].first[a.second] > arrays[b.first].first[b.second];
+  };
+
+  std::make_heap(heap.begin(), heap.end(), cursor_greater);
+
+  uint32_t* results = new uint32_t[total_length];
+  size_t res_index = 0;
+
+  while(!heap.empty()) {
+    std::pop_heap(heap.begin(), heap.end(), cursor_greater);
+    cursor_t & cursor = heap.back();
+    const uint32_t id = arrays[cursor.first].first[cursor.second];
+
+    if(res_index == 0 || results[res_index-1] != id) {
+      results[res_index++] = id;
+    }
+
+    cursor.second++;
+
+    if(cursor.second < arrays[cursor.first].second) {
+      std::push_heap(heap.begin(), heap.end(), cursor_greater);
+    } else {
+      heap.pop_back();
+    }
+  }
+
+  if(res_index == total_length) {
+    *out = results;
+    return res_index;
+  }
+
+  // shrink fit
+  *out = new uint32_t[res_index];
+  memcpy(*out, results, res_index * sizeof(uint32_t));
+  delete[] results;
+
+  return res_index;
+}
+
 size_t ArrayUtils::exclude_scalar(const uint32_t *A, const size_t lenA,
                                  const uint32_t *B, const size_t lenB, uint32_t **out) {
   size_t indexA = 0, indexB = 0, res_index = 0;
@@ -13,7 +13,9 @@
 #include <queue>
 #include <stdint.h>
 #include "art.h"
+#include "art_arena.h"
 #include "logger.h"
+#include "search_cutoff.h"
 
 /**
  * Macros to manipulate pointer tags
@@ -32,13 +34,15 @@
 
 enum recurse_progress { RECURSE, ABORT, ITERATE };
 
-static void art_fuzzy_recurse(unsigned char p, unsigned char c, const art_node *n, int depth, const unsigned char *term,
-                              const int term_len, const int* irow, const int* jrow, const int min_cost,
-                              const int max_cost, const bool prefix, std::vector<const art_node *> &results);
-
 void art_int_fuzzy_recurse(art_node *n, int depth, const unsigned char* int_str, int int_str_len,
                            NUM_COMPARATOR comparator, std::vector<const art_leaf *> &results);
 
+static void topk_iter(const art_node *root, token_ordering token_order, size_t max_results, bool use_caches,
+                      std::vector<art_leaf *> &results);
+
+// Below this many keys, walking a subtree costs about as much as reading its cache
+static const uint64_t TOPK_MIN_KEYS = 1000;
+
 bool compare_art_leaf_frequency(const art_leaf *a, const art_leaf *b) {
     return a->values->ids.getLength() > b->values->ids.getLength();
 }
@@ -95,34 +99,88 @@ bool compare_art_node_score_pq(const art_node* a, const art_node* b) {
     return !compare_art_node_score(a, b);
 }
 
-/**
- * Allocates a node of the given type,
- * initializes to zero and sets the type.
- */
-static art_node* alloc_node(uint8_t type) {
-    art_node* n;
+static size_t node_size(uint8_t type) {
     switch (type) {
         case NODE4:
-            n = (art_node *) calloc(1, sizeof(art_node4));
-            break;
+            return sizeof(art_node4);
         case NODE16:
-            n = (art_node *) calloc(1, sizeof(art_node16));
-            break;
+            return sizeof(art_node16);
         case NODE48:
-            n = (art_node *) calloc(1, sizeof(art_node48));
-            break;
+            return sizeof(art_node48);
         case NODE256:
-            n = (art_node *) calloc(1, sizeof(art_node256));
-            break;
+            return sizeof(art_node256);
         default:
             abort();
     }
+}
+
+/**
+ * Allocates a node of the given type from the arena,
+ * initializes to zero and sets the type.
+ */
+static art_node* alloc_node(art_arena *arena, uint8_t type) {
+    const size_t size = node_size(type);
+    art_node* n = (art_node *) arena->alloc(size);
+    memset(n, 0, size);
     n->type = type;
     n->max_score = 0;
     n->max_token_count = 0;
     return n;
 }
 
+// Returns a node to the arena, for the next node of its type
+static void free_node(art_arena *arena, art_node *n) {
+    arena->release(n, node_size(n->type));
+}
+
+// Returns the cached leaves of a node to the arena
+static void free_topk(art_arena *arena, art_node *n) {
+    if(n->topk != nullptr) {
+        arena->release(n->topk, sizeof(art_topk));
+        n->topk = nullptr;
+    }
+}
+
+// Returns the bytes of the prefix of a node, wherever they are held
+static inline unsigned char* node_partial(const art_node *n) {
+    return (n->partial_len > MAX_PREFIX_LEN) ? n->long_partial : (unsigned char *) n->partial;
+}
+
+// Returns the buffer of a long prefix to the arena
+static void free_partial(art_arena *arena, art_node *n) {
+    if(n->partial_len > MAX_PREFIX_LEN) {
+        arena->release(n->long_partial, n->partial_len);
+        n->partial_len = 0;
+    }
+}
+
+/**
+ * Replaces the prefix of a node. The new prefix may be taken from the current one.
+ */
+static void set_partial(art_arena *arena, art_node *n, const unsigned char *partial, uint32_t partial_len) {
+    unsigned char* old_partial = (n->partial_len > MAX_PREFIX_LEN) ? n->long_partial : nullptr;
+    const uint32_t old_partial_len = n->partial_len;
+
+    if(partial_len > MAX_PREFIX_LEN) {
+        unsigned char* long_partial = (unsigned char *) arena->alloc(partial_len);
+        memcpy(long_partial, partial, partial_len);
+        n->long_partial = long_partial;
+    } else {
+        memmove(n->partial, partial, partial_len);
+    }
+
+    n->partial_len = partial_len;
+
+    if(old_partial != nullptr) {
+        arena->release(old_partial, old_partial_len);
+    }
+}
+
+// Returns a leaf to the arena: its values are not freed
+static void free_leaf(art_arena *arena, art_leaf *l) {
+    arena->release(l, sizeof(art_leaf) + l->key_len);
+}
+
 /**
  * Initializes an ART tree
  * @return 0 on success.
@@ -130,11 +188,12 @@ static art_node* alloc_node(uint8_t type) {
 int art_tree_init(art_tree *t) {
     t->root = NULL;
     t->size = 0;
+    t->arena = new art_arena();
     return 0;
 }
 
 // Recursively destroys the tree
-static void destroy_node(art_node *n) {
+static void destroy_node(art_arena *arena, art_node *n) {
     // Break if null
     if (!n) return;
 
@@ -142,7 +201,7 @@ static void destroy_node(art_node *n) {
     if (IS_LEAF(n)) {
         art_leaf *leaf = (art_leaf *) LEAF_RAW(n);
         delete leaf->values;
-        free(leaf);
+        free_leaf(arena, leaf);
         return;
     }
 
@@ -158,21 +217,21 @@ static void destroy_node(art_node *n) {
         case NODE4:
             p.p1 = (art_node4*)n;
             for (i=0;i<n->num_children;i++) {
-                destroy_node(p.p1->children[i]);
+                destroy_node(arena, p.p1->children[i]);
             }
             break;
 
         case NODE16:
             p.p2 = (art_node16*)n;
             for (i=0;i<n->num_children;i++) {
-                destroy_node(p.p2->children[i]);
+                destroy_node(arena, p.p2->children[i]);
             }
             break;
 
         case NODE48:
             p.p3 = (art_node48*)n;
             for (i=0;i<48;i++) {
-                destroy_node(p.p3->children[i]);
+                destroy_node(arena, p.p3->children[i]);
             }
             break;
 
@@ -180,7 +239,7 @@ static void destroy_node(art_node *n) {
             p.p4 = (art_node256*)n;
             for (i=0;i<256;i++) {
                 if (p.p4->children[i])
-                    destroy_node(p.p4->children[i]);
+                    destroy_node(arena, p.p4->children[i]);
             }
             break;
 
@@ -189,7 +248,78 @@ static void destroy_node(art_node *n) {
     }
 
     // Free ourself on the way up
-    free(n);
+    free_topk(arena, n);
+    free_partial(arena, n);
+    free_node(arena, n);
+}
+
+static void node_memory_usage(art_node *n, art_memory *memory) {
+    if (!n) return;
+
+    if (IS_LEAF(n)) {
+        art_leaf *leaf = (art_leaf *) LEAF_RAW(n);
+        memory->num_leaves++;
+        memory->leaf_bytes += sizeof(art_leaf) + leaf->key_len + sizeof(art_values);
+        memory->posting_bytes += leaf->values->ids.getSizeInBytes();
+        memory->position_bytes += leaf->values->positions.getSizeInBytes();
+        return;
+    }
+
+    if (n->topk) {
+        memory->node_bytes += sizeof(art_topk);
+    }
+
+    if (n->partial_len > MAX_PREFIX_LEN) {
+        memory->node_bytes += n->partial_len;
+    }
+
+    int i;
+    switch (n->type) {
+        case NODE4:
+            memory->num_nodes[0]++;
+            memory->node_bytes += sizeof(art_node4);
+            for (i=0;i<n->num_children;i++) {
+                node_memory_usage(((art_node4*)n)->children[i], memory);
+            }
+            break;
+
+        case NODE16:
+            memory->num_nodes[1]++;
+            memory->node_bytes += sizeof(art_node16);
+            for (i=0;i<n->num_children;i++) {
+                node_memory_usage(((art_node16*)n)->children[i], memory);
+            }
+            break;
+
+        case NODE48:
+            memory->num_nodes[2]++;
+            memory->node_bytes += sizeof(art_node48);
+            for (i=0;i<48;i++) {
+                node_memory_usage(((art_node48*)n)->children[i], memory);
+            }
+            break;
+
+        case NODE256:
+            memory->num_nodes[3]++;
+            memory->node_bytes += sizeof(art_node256);
+            for (i=0;i<256;i++) {
+                node_memory_usage(((art_node256*)n)->children[i], memory);
+            }
+            break;
+
+        default:
+            abort();
+    }
+}
+
+void art_memory_usage(art_tree *t, art_memory *memory) {
+    node_memory_usage(t->root, memory);
+    art_arena_usage(t, memory);
+}
+
+void art_arena_usage(art_tree *t, art_memory *memory) {
+    memory->arena_bytes += t->arena->get_slab_bytes();
+    memory->arena_free_bytes += t->arena->get_free_bytes();
 }
 
 /**
@@ -197,7 +327,10 @@ static void destroy_node(art_node *n) {
  * @return 0 on success.
  */
 int art_tree_destroy(art_tree *t) {
-    destroy_node(t->root);
+    destroy_node(t->arena, t->root);
+    delete t->arena;
+    t->root = NULL;
+    t->arena = NULL;
     return 0;
 }
 
@@ -282,10 +415,11 @@ static inline int min(int a, int b) {
  * the key and node.
  */
 static int check_prefix(const art_node *n, const unsigned char *key, int key_len, int depth) {
-    int max_cmp = min(min(n->partial_len, MAX_PREFIX_LEN), key_len - depth);
+    const unsigned char* partial = node_partial(n);
+    int max_cmp = min(n->partial_len, key_len - depth);
     int idx;
     for (idx=0; idx < max_cmp; idx++) {
-        if (n->partial[idx] != key[depth+idx])
+        if (partial[idx] != key[depth+idx])
             return idx;
     }
     return idx;
@@ -330,7 +464,7 @@ void* art_search(const art_tree *t, const unsigned char *key, int key_len) {
         // Bail if the prefix does not match
         if (n->partial_len) {
             prefix_len = check_prefix(n, key, key_len, depth);
-            if (prefix_len != min(MAX_PREFIX_LEN, n->partial_len)) {
+            if (prefix_len != (int) n->partial_len) {
                 return NULL;
             }
 
@@ -419,16 +553,11 @@ art_leaf* art_maximum(art_tree *t) {
 static void add_document_to_leaf(const art_document *document, art_leaf *leaf) {
     leaf->max_score = MAX(leaf->max_score, document->score);
     leaf->values->ids.append(document->id);
-    uint32_t curr_index = leaf->values->offsets.getLength();
-    leaf->values->offset_index.append(curr_index);
-
-    for(uint32_t i=0; i<document->offsets_len; i++) {
-        leaf->values->offsets.append(document->offsets[i]);
-    }
+    leaf->values->positions.append(document->offsets, document->offsets_len);
 }
 
-static art_leaf* make_leaf(const unsigned char *key, uint32_t key_len, art_document *document) {
-    art_leaf *l = (art_leaf *) malloc(sizeof(art_leaf) + key_len);
+static art_leaf* make_leaf(art_arena *arena, const unsigned char *key, uint32_t key_len, art_document *document) {
+    art_leaf *l = (art_leaf *) arena->alloc(sizeof(art_leaf) + key_len);
     l->values = new art_values;
     l->max_score = 0;
     l->key_len = key_len;
@@ -450,12 +579,14 @@ static uint32_t longest_common_prefix(art_leaf *l1, art_leaf *l2, int depth) {
 static void copy_header(art_node *dest, art_node *src) {
     dest->max_score = src->max_score;
     dest->max_token_count = src->max_token_count;
+    dest->topk = src->topk;
     dest->num_children = src->num_children;
+    // a long prefix moves along with its buffer
     dest->partial_len = src->partial_len;
-    memcpy(dest->partial, src->partial, min(MAX_PREFIX_LEN, src->partial_len));
+    memcpy(dest->partial, src->partial, MAX_PREFIX_LEN);
 }
 
-static void add_child256(art_node256 *n, art_node **ref, unsigned char c, void *child) {
+static void add_child256(art_arena *arena, art_node256 *n, art_node **ref, unsigned char c, void *child) {
     (void)ref;
     n->n.max_score = MAX(n->n.max_score, ((art_leaf *) LEAF_RAW(child))->max_score);
     n->n.max_token_count = MAX(n->n.max_token_count, ((art_leaf *) LEAF_RAW(child))->values->ids.getLength());
@@ -463,7 +594,7 @@ static void add_child256(art_node256 *n, art_node **ref, unsigned char c, void *
     n->children[c] = (art_node *) child;
 }
 
-static void add_child48(art_node48 *n, art_node **ref, unsigned char c, void *child) {
+static void add_child48(art_arena *arena, art_node48 *n, art_node **ref, unsigned char c, void *child) {
     if (n->n.num_children < 48) {
         int pos = 0;
         while (n->children[pos]) pos++;
@@ -473,7 +604,7 @@ static void add_child48(art_node48 *n, art_node **ref, unsigned char c, void *ch
         n->keys[c] = pos + 1;
         n->n.num_children++;
     } else {
-        art_node256 *new_n = (art_node256*)alloc_node(NODE256);
+        art_node256 *new_n = (art_node256*)alloc_node(arena, NODE256);
         for (int i=0;i<256;i++) {
             if (n->keys[i]) {
                 new_n->children[i] = n->children[n->keys[i] - 1];
@@ -481,12 +612,12 @@ static void add_child48(art_node48 *n, art_node **ref, unsigned char c, void *ch
         }
         copy_header((art_node*)new_n, (art_node*)n);
         *ref = (art_node*)new_n;
-        free(n);
-        add_child256(new_n, ref, c, child);
+        free_node(arena, (art_node *) n);
+        add_child256(arena, new_n, ref, c, child);
     }
 }
 
-static void add_child16(art_node16 *n, art_node **ref, unsigned char c, void *child) {
+static void add_child16(art_arena *arena, art_node16 *n, art_node **ref, unsigned char c, void *child) {
     if (n->n.num_children < 16) {
         __m128i cmp;
 
@@ -516,7 +647,7 @@ static void add_child16(art_node16 *n, art_node **ref, unsigned char c, void *ch
         n->n.num_children++;
 
     } else {
-        art_node48 *new_n = (art_node48*)alloc_node(NODE48);
+        art_node48 *new_n = (art_node48*)alloc_node(arena, NODE48);
 
         // Copy the child pointers and populate the key map
         memcpy(new_n->children, n->children,
@@ -526,12 +657,12 @@ static void add_child16(art_node16 *n, art_node **ref, unsigned char c, void *ch
         }
         copy_header((art_node*)new_n, (art_node*)n);
         *ref = (art_node*)new_n;
-        free(n);
-        add_child48(new_n, ref, c, child);
+        free_node(arena, (art_node *) n);
+        add_child48(arena, new_n, ref, c, child);
     }
 }
 
-static void add_child4(art_node4 *n, art_node **ref, unsigned char c, void *child) {
+static void add_child4(art_arena *arena, art_node4 *n, art_node **ref, unsigned char c, void *child) {
     if (n->n.num_children < 4) {
         int idx;
         for (idx=0; idx < n->n.num_children; idx++) {
@@ -554,7 +685,7 @@ static void add_child4(art_node4 *n, art_node **ref, unsigned char c, void *chil
         n->n.num_children++;
 
     } else {
-        art_node16 *new_n = (art_node16*)alloc_node(NODE16);
+        art_node16 *new_n = (art_node16*)alloc_node(arena, NODE16);
 
         // Copy the child pointers and the key map
         memcpy(new_n->children, n->children,
@@ -563,54 +694,30 @@ static void add_child4(art_node4 *n, art_node **ref, unsigned char c, void *chil
                 sizeof(unsigned char)*n->n.num_children);
         copy_header((art_node*)new_n, (art_node*)n);
         *ref = (art_node*)new_n;
-        free(n);
-        add_child16(new_n, ref, c, child);
+        free_node(arena, (art_node *) n);
+        add_child16(arena, new_n, ref, c, child);
     }
 }
 
-static void add_child(art_node *n, art_node **ref, unsigned char c, void *child) {
+static void add_child(art_arena *arena, art_node *n, art_node **ref, unsigned char c, void *child) {
     switch (n->type) {
         case NODE4:
-            return add_child4((art_node4*)n, ref, c, child);
+            return add_child4(arena, (art_node4*)n, ref, c, child);
         case NODE16:
-            return add_child16((art_node16*)n, ref, c, child);
+            return add_child16(arena, (art_node16*)n, ref, c, child);
         case NODE48:
-            return add_child48((art_node48*)n, ref, c, child);
+            return add_child48(arena, (art_node48*)n, ref, c, child);
         case NODE256:
-            return add_child256((art_node256*)n, ref, c, child);
+            return add_child256(arena, (art_node256*)n, ref, c, child);
         default:
             abort();
     }
 }
 
-/**
- * Calculates the index at which the prefixes mismatch
- */
-static int prefix_mismatch(const art_node *n, const unsigned char *key, int key_len, int depth) {
-    int max_cmp = min(min(MAX_PREFIX_LEN, n->partial_len), key_len - depth);
-    int idx;
-    for (idx=0; idx < max_cmp; idx++) {
-        if (n->partial[idx] != key[depth+idx])
-            return idx;
-    }
-
-    // If the prefix is short we can avoid finding a leaf
-    if (n->partial_len > MAX_PREFIX_LEN) {
-        // Prefix is longer than what we've checked, find a leaf
-        art_leaf *l = minimum(n);
-        max_cmp = min(l->key_len, key_len)- depth;
-        for (; idx < max_cmp; idx++) {
-            if (l->key[idx+depth] != key[depth+idx])
-                return idx;
-        }
-    }
-    return idx;
-}
-
-static void* recursive_insert(art_node *n, art_node **ref, const unsigned char *key, uint32_t key_len, art_document *document, uint32_t num_hits, int depth, int *old) {
+static void* recursive_insert(art_arena *arena, art_node *n, art_node **ref, const unsigned char *key, uint32_t key_len, art_document *document, uint32_t num_hits, int depth, int *old) {
     // If we are at a NULL node, inject a leaf
     if (!n) {
-        *ref = (art_node*)SET_LEAF(make_leaf(key, key_len, document));
+        *ref = (art_node*)SET_LEAF(make_leaf(arena, key, key_len, document));
         return NULL;
     }
 
@@ -632,19 +739,18 @@ static void* recursive_insert(art_node *n, art_node **ref, const unsigned char *
         }
 
         // New value, we must split the leaf into a node4
-        art_node4 *new_n = (art_node4*)alloc_node(NODE4);
+        art_node4 *new_n = (art_node4*)alloc_node(arena, NODE4);
 
         // Create a new leaf
-        art_leaf *l2 = make_leaf(key, key_len, document);
+        art_leaf *l2 = make_leaf(arena, key, key_len, document);
 
         uint32_t longest_prefix = longest_common_prefix(l, l2, depth);
-        new_n->n.partial_len = longest_prefix;
-        memcpy(new_n->n.partial, key+depth, min(MAX_PREFIX_LEN, longest_prefix));
+        set_partial(arena, (art_node *) new_n, key+depth, longest_prefix);
 
         // Add the leafs to the new node4
         *ref = (art_node*)new_n;
-        add_child4(new_n, ref, l->key[depth+longest_prefix], SET_LEAF(l));
-        add_child4(new_n, ref, l2->key[depth+longest_prefix], SET_LEAF(l2));
+        add_child4(arena, new_n, ref, l->key[depth+longest_prefix], SET_LEAF(l));
+        add_child4(arena, new_n, ref, l2->key[depth+longest_prefix], SET_LEAF(l2));
         return NULL;
     }
 
@@ -654,35 +760,29 @@ static void* recursive_insert(art_node *n, art_node **ref, const unsigned char *
     // Check if given node has a prefix
     if (n->partial_len) {
         // Determine if the prefixes differ, since we need to split
-        int prefix_diff = prefix_mismatch(n, key, key_len, depth);
+        int prefix_diff = check_prefix(n, key, key_len, depth);
         if ((uint32_t)prefix_diff >= n->partial_len) {
             depth += n->partial_len;
             goto RECURSE_SEARCH;
         }
 
         // Create a new node
-        art_node4 *new_n = (art_node4*)alloc_node(NODE4);
+        art_node4 *new_n = (art_node4*)alloc_node(arena, NODE4);
         *ref = (art_node*)new_n;
-        new_n->n.partial_len = prefix_diff;
-        memcpy(new_n->n.partial, n->partial, min(MAX_PREFIX_LEN, prefix_diff));
+        set_partial(arena, (art_node *) new_n, node_partial(n), prefix_diff);
 
         // Adjust the prefix of the old node
-        if (n->partial_len <= MAX_PREFIX_LEN) {
-            add_child4(new_n, ref, n->partial[prefix_diff], n);
-            n->partial_len -= (prefix_diff+1);
-            memmove(n->partial, n->partial+prefix_diff+1,
-                    min(MAX_PREFIX_LEN, n->partial_len));
-        } else {
-            n->partial_len -= (prefix_diff+1);
-            art_leaf *l = minimum(n);
-            add_child4(new_n, ref, l->key[depth+prefix_diff], n);
-            memcpy(n->partial, l->key+depth+prefix_diff+1,
-                   min(MAX_PREFIX_LEN, n->partial_len));
+        add_child4(arena, new_n, ref, node_partial(n)[prefix_diff], n);
+        set_partial(arena, n, node_partial(n) + prefix_diff + 1, n->partial_len - (prefix_diff+1));
+
+        // The old node now starts too deep in the keys to keep a cache
+        if (depth + prefix_diff + 1 >= ART_TOPK_DEPTH) {
+            free_topk(arena, n);
         }
 
         // Insert the new leaf
-        art_leaf *l = make_leaf(key, key_len, document);
-        add_child4(new_n, ref, key[depth+prefix_diff], SET_LEAF(l));
+        art_leaf *l = make_leaf(arena, key, key_len, document);
+        add_child4(arena, new_n, ref, key[depth+prefix_diff], SET_LEAF(l));
         return NULL;
     }
 
@@ -691,15 +791,181 @@ static void* recursive_insert(art_node *n, art_node **ref, const unsigned char *
     // Find a child to recurse to
     art_node **child = find_child(n, key[depth]);
     if (child) {
-        return recursive_insert(*child, child, key, key_len, document, num_hits, depth + 1, old);
+        return recursive_insert(arena, *child, child, key, key_len, document, num_hits, depth + 1, old);
     }
 
     // No child, node goes within us
-    art_leaf *l = make_leaf(key, key_len, document);
-    add_child(n, ref, key[depth], SET_LEAF(l));
+    art_leaf *l = make_leaf(arena, key, key_len, document);
+    add_child(arena, n, ref, key[depth], SET_LEAF(l));
     return NULL;
 }
 
+static art_leaf** topk_leaves(art_topk *topk, token_ordering token_order) {
+    return (token_order == FREQUENCY) ? topk->by_frequency : topk->by_score;
+}
+
+static bool topk_before(token_ordering token_order, const art_leaf *a, const art_leaf *b) {
+    return (token_order == FREQUENCY) ? compare_art_leaf_frequency(a, b) : compare_art_leaf_score(a, b);
+}
+
+/**
+ * Moves a leaf up to its rank among the cached leaves, which is only ever higher than before
+ * since leaves gain documents on insertion. Returns the number of cached leaves.
+ */
+static uint8_t topk_rank(art_leaf **leaves, uint8_t num_leaves, token_ordering token_order, art_leaf *leaf) {
+    int pos = 0;
+    while(pos < num_leaves && leaves[pos] != leaf) {
+        pos++;
+    }
+
+    if(pos == num_leaves) {
+        if(num_leaves == ART_TOPK_SIZE) {
+            // a full cache: the leaf must beat the last one to get in
+            if(!topk_before(token_order, leaf, leaves[num_leaves - 1])) {
+                return num_leaves;
+            }
+            pos--;
+        } else {
+            num_leaves++;
+        }
+    }
+
+    while(pos > 0 && topk_before(token_order, leaf, leaves[pos - 1])) {
+        leaves[pos] = leaves[pos - 1];
+        pos--;
+    }
+
+    leaves[pos] = leaf;
+    return num_leaves;
+}
+
+static bool topk_contains(const art_topk *topk, const art_leaf *leaf) {
+    for(int i = 0; i < topk->num_leaves; i++) {
+        if(topk->by_score[i] == leaf || topk->by_frequency[i] == leaf) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Ranks the leaves of the subtree of a node from scratch, with the help of the caches below it
+static void topk_fill(art_node *n) {
+    art_topk *topk = n->topk;
+    std::vector<art_leaf *> leaves;
+
+    n->topk = nullptr;
+
+    topk_iter(n, MAX_SCORE, ART_TOPK_SIZE, true, leaves);
+    std::copy(leaves.begin(), leaves.end(), topk->by_score);
+    topk->num_leaves = leaves.size();
+
+    leaves.clear();
+    topk_iter(n, FREQUENCY, ART_TOPK_SIZE, true, leaves);
+    std::copy(leaves.begin(), leaves.end(), topk->by_frequency);
+
+    n->topk = topk;
+}
+
+/**
+ * Collects the nodes that can hold a cache on the way to a leaf, from the root down.
+ * Nodes that start `ART_TOPK_DEPTH` bytes or more into the keys never do.
+ */
+static void topk_path(art_tree *t, const art_leaf *leaf, std::vector<art_node *> &path) {
+    art_node *n = t->root;
+    uint32_t depth = 0;
+
+    while(n != nullptr && !IS_LEAF(n) && depth < ART_TOPK_DEPTH) {
+        path.push_back(n);
+
+        depth += n->partial_len;
+        if(depth >= leaf->key_len) {
+            break;
+        }
+
+        art_node **child = find_child(n, leaf->key[depth]);
+        n = (child == nullptr) ? nullptr : *child;
+        depth++;
+    }
+}
+
+/**
+ * Ranks a leaf that has gained documents within the caches on its way, creating the missing ones.
+ * The deepest ones go first, since new caches are filled from the ones below them.
+ */
+static void topk_insert(art_tree *t, art_leaf *leaf) {
+    std::vector<art_node *> path;
+    topk_path(t, leaf, path);
+
+    for(auto it = path.rbegin(); it != path.rend(); ++it) {
+        art_node *n = *it;
+        if(n->topk == nullptr) {
+            n->topk = (art_topk *) t->arena->alloc(sizeof(art_topk));
+            topk_fill(n);
+            continue;
+        }
+
+        const uint8_t num_leaves = n->topk->num_leaves;
+        n->topk->num_leaves = topk_rank(n->topk->by_score, num_leaves, MAX_SCORE, leaf);
+        topk_rank(n->topk->by_frequency, num_leaves, FREQUENCY, leaf);
+    }
+}
+
+// Ranks again the caches that hold a leaf which was just taken out of the tree, deepest first
+static void topk_delete(art_tree *t, const art_leaf *leaf) {
+    std::vector<art_node *> path;
+    topk_path(t, leaf, path);
+
+    for(auto it = path.rbegin(); it != path.rend(); ++it) {
+        art_node *n = *it;
+        if(n->topk != nullptr && topk_contains(n->topk, leaf)) {
+            topk_fill(n);
+        }
+    }
+}
+
+static void topk_refresh(art_node *n, uint32_t depth) {
+    if (!n || IS_LEAF(n) || depth >= ART_TOPK_DEPTH) return;
+
+    const uint32_t child_depth = depth + n->partial_len + 1;
+
+    int idx;
+    switch (n->type) {
+        case NODE4:
+            for (int i=0; i < n->num_children; i++) {
+                topk_refresh(((art_node4*)n)->children[i], child_depth);
+            }
+            break;
+        case NODE16:
+            for (int i=0; i < n->num_children; i++) {
+                topk_refresh(((art_node16*)n)->children[i], child_depth);
+            }
+            break;
+        case NODE48:
+            for (int i=0; i < 256; i++) {
+                idx = ((art_node48*)n)->keys[i];
+                if (!idx) continue;
+                topk_refresh(((art_node48*)n)->children[idx - 1], child_depth);
+            }
+            break;
+        case NODE256:
+            for (int i=0; i < 256; i++) {
+                topk_refresh(((art_node256*)n)->children[i], child_depth);
+            }
+            break;
+        default:
+            abort();
+    }
+
+    if(n->topk != nullptr) {
+        topk_fill(n);
+    }
+}
+
+void art_topk_refresh(art_tree *t) {
+    topk_refresh(t->root, 0);
+}
+
 /**
  * Inserts a new value into the ART tree
  * @arg t The tree
@@ -712,19 +978,67 @@ static void* recursive_insert(art_node *n, art_node **ref, const unsigned char *
 void* art_insert(art_tree *t, const unsigned char *key, int key_len, art_document* document, uint32_t num_hits) {
     int old_val = 0;
 
-    void *old = recursive_insert(t->root, &t->root, key, key_len, document, num_hits, 0, &old_val);
+    void *old = recursive_insert(t->arena, t->root, &t->root, key, key_len, document, num_hits, 0, &old_val);
     if (!old_val) t->size++;
+
+    if (!IS_LEAF(t->root)) {
+        topk_insert(t, (art_leaf *) art_search(t, key, key_len));
+    }
+
+    return old;
+}
+
+void* art_insert_many(art_tree *t, const unsigned char *key, int key_len, const art_document_run* run) {
+    art_leaf* leaf = (art_leaf *) art_search(t, key, key_len);
+    uint32_t num_hits = (leaf == NULL) ? 0 : leaf->values->ids.getLength();
+
+    // updates are not supported: documents already in the leaf are skipped
+    uint32_t doc_index = 0;
+    const uint32_t* offsets = run->offsets;
+
+    while(leaf != NULL && doc_index < run->num_documents && leaf->values->ids.contains(run->ids[doc_index])) {
+        offsets += run->offsets_lens[doc_index];
+        doc_index++;
+    }
+
+    if(doc_index == run->num_documents) {
+        return (leaf == NULL) ? NULL : leaf->values;
+    }
+
+    // the nodes on the way are updated once, with the best score and the final number of hits of the run
+    art_document document;
+    document.score = run->max_score;
+    document.id = run->ids[doc_index];
+    document.offsets_len = run->offsets_lens[doc_index];
+    document.offsets = (uint32_t *) offsets;
+
+    num_hits += run->num_documents - doc_index;
+    void* old = art_insert(t, key, key_len, &document, num_hits);
+
+    offsets += run->offsets_lens[doc_index];
+    doc_index++;
+
+    if(doc_index < run->num_documents) {
+        leaf = (art_leaf *) art_search(t, key, key_len);
+        leaf->values->ids.append(run->ids + doc_index, run->num_documents - doc_index);
+        leaf->values->positions.append(offsets, run->offsets_lens + doc_index, run->num_documents - doc_index);
+
+        if (!IS_LEAF(t->root)) {
+            topk_insert(t, leaf);
+        }
+    }
+
     return old;
 }
 
-static void remove_child256(art_node256 *n, art_node **ref, unsigned char c) {
+static void remove_child256(art_arena *arena, art_node256 *n, art_node **ref, unsigned char c) {
     n->children[c] = NULL;
     n->n.num_children--;
 
     // Resize to a node48 on underflow, not immediately to prevent
     // trashing if we sit on the 48/49 boundary
     if (n->n.num_children == 37) {
-        art_node48 *new_n = (art_node48*)alloc_node(NODE48);
+        art_node48 *new_n = (art_node48*)alloc_node(arena, NODE48);
         *ref = (art_node*)new_n;
         copy_header((art_node*)new_n, (art_node*)n);
 
@@ -736,18 +1050,18 @@ static void remove_child256(art_node256 *n, art_node **ref, unsigned char c) {
                 pos++;
             }
         }
-        free(n);
+        free_node(arena, (art_node *) n);
     }
 }
 
-static void remove_child48(art_node48 *n, art_node **ref, unsigned char c) {
+static void remove_child48(art_arena *arena, art_node48 *n, art_node **ref, unsigned char c) {
     int pos = n->keys[c];
     n->keys[c] = 0;
     n->children[pos-1] = NULL;
     n->n.num_children--;
 
     if (n->n.num_children == 12) {
-        art_node16 *new_n = (art_node16*)alloc_node(NODE16);
+        art_node16 *new_n = (art_node16*)alloc_node(arena, NODE16);
         *ref = (art_node*)new_n;
         copy_header((art_node*)new_n, (art_node*)n);
 
@@ -760,27 +1074,27 @@ static void remove_child48(art_node48 *n, art_node **ref, unsigned char c) {
                 child++;
             }
         }
-        free(n);
+        free_node(arena, (art_node *) n);
     }
 }
 
-static void remove_child16(art_node16 *n, art_node **ref, art_node **l) {
+static void remove_child16(art_arena *arena, art_node16 *n, art_node **ref, art_node **l) {
     int pos = l - n->children;
     memmove(n->keys+pos, n->keys+pos+1, n->n.num_children - 1 - pos);
     memmove(n->children+pos, n->children+pos+1, (n->n.num_children - 1 - pos)*sizeof(void*));
     n->n.num_children--;
 
     if (n->n.num_children == 3) {
-        art_node4 *new_n = (art_node4*)alloc_node(NODE4);
+        art_node4 *new_n = (art_node4*)alloc_node(arena, NODE4);
         *ref = (art_node*)new_n;
         copy_header((art_node*)new_n, (art_node*)n);
         memcpy(new_n->keys, n->keys, 4);
         memcpy(new_n->children, n->children, 4*sizeof(void*));
-        free(n);
+        free_node(arena, (art_node *) n);
     }
 }
 
-static void remove_child4(art_node4 *n, art_node **ref, art_node **l) {
+static void remove_child4(art_arena *arena, art_node4 *n, art_node **ref, art_node **l) {
     int pos = l - n->children;
     memmove(n->keys+pos, n->keys+pos+1, n->n.num_children - 1 - pos);
     memmove(n->children+pos, n->children+pos+1, (n->n.num_children - 1 - pos)*sizeof(void*));
@@ -791,42 +1105,36 @@ static void remove_child4(art_node4 *n, art_node **ref, art_node **l) {
         art_node *child = n->children[0];
         if (!IS_LEAF(child)) {
             // Concatenate the prefixes
-            int prefix = n->n.partial_len;
-            if (prefix < MAX_PREFIX_LEN) {
-                n->n.partial[prefix] = n->keys[0];
-                prefix++;
-            }
-            if (prefix < MAX_PREFIX_LEN) {
-                int sub_prefix = min(child->partial_len, MAX_PREFIX_LEN - prefix);
-                memcpy(n->n.partial+prefix, child->partial, sub_prefix);
-                prefix += sub_prefix;
-            }
+            std::vector<unsigned char> prefix(node_partial((art_node *) n), node_partial((art_node *) n) + n->n.partial_len);
+            prefix.push_back(n->keys[0]);
+            prefix.insert(prefix.end(), node_partial(child), node_partial(child) + child->partial_len);
 
             // Store the prefix in the child
-            memcpy(child->partial, n->n.partial, min(prefix, MAX_PREFIX_LEN));
-            child->partial_len += n->n.partial_len + 1;
+            set_partial(arena, child, &prefix[0], prefix.size());
         }
         *ref = child;
-        free(n);
+        free_topk(arena, (art_node *) n);
+        free_partial(arena, (art_node *) n);
+        free_node(arena, (art_node *) n);
     }
 }
 
-static void remove_child(art_node *n, art_node **ref, unsigned char c, art_node **l) {
+static void remove_child(art_arena *arena, art_node *n, art_node **ref, unsigned char c, art_node **l) {
     switch (n->type) {
         case NODE4:
-            return remove_child4((art_node4*)n, ref, l);
+            return remove_child4(arena, (art_node4*)n, ref, l);
         case NODE16:
-            return remove_child16((art_node16*)n, ref, l);
+            return remove_child16(arena, (art_node16*)n, ref, l);
         case NODE48:
-            return remove_child48((art_node48*)n, ref, c);
+            return remove_child48(arena, (art_node48*)n, ref, c);
         case NODE256:
-            return remove_child256((art_node256*)n, ref, c);
+            return remove_child256(arena, (art_node256*)n, ref, c);
         default:
             abort();
     }
 }
 
-static art_leaf* recursive_delete(art_node *n, art_node **ref, const unsigned char *key, int key_len, int depth) {
+static art_leaf* recursive_delete(art_arena *arena, art_node *n, art_node **ref, const unsigned char *key, int key_len, int depth) {
     // Search terminated
     if (!n) return NULL;
 
@@ -843,7 +1151,7 @@ static art_leaf* recursive_delete(art_node *n, art_node **ref, const unsigned ch
     // Bail if the prefix does not match
     if (n->partial_len) {
         int prefix_len = check_prefix(n, key, key_len, depth);
-        if (prefix_len != min(MAX_PREFIX_LEN, n->partial_len)) {
+        if (prefix_len != (int) n->partial_len) {
             return NULL;
         }
         depth = depth + n->partial_len;
@@ -862,14 +1170,14 @@ static art_leaf* recursive_delete(art_node *n, art_node **ref, const unsigned ch
     if (IS_LEAF(*child)) {
         art_leaf *l = (art_leaf *) LEAF_RAW(*child);
         if (!leaf_matches(l, key, key_len, depth)) {
-            remove_child(n, ref, key[depth], child);
+            remove_child(arena, n, ref, key[depth], child);
             return l;
         }
         return NULL;
 
         // Recurse
     } else {
-        return recursive_delete(*child, child, key, key_len, depth+1);
+        return recursive_delete(arena, *child, child, key, key_len, depth+1);
     }
 }
 
@@ -882,11 +1190,12 @@ static art_leaf* recursive_delete(art_node *n, art_node **ref, const unsigned ch
  * the value pointer is returned.
  */
 void* art_delete(art_tree *t, const unsigned char *key, int key_len) {
-    art_leaf *l = recursive_delete(t->root, &t->root, key, key_len, 0);
+    art_leaf *l = recursive_delete(t->arena, t->root, &t->root, key, key_len, 0);
     if (l) {
         t->size--;
+        topk_delete(t, l);
         void *old = l->values;
-        free(l);
+        free_leaf(t->arena, l);
         return old;
     }
     return NULL;
@@ -903,8 +1212,20 @@ void* art_delete(art_tree *t, const unsigned char *key, int key_len) {
 
 int art_topk_iter(const art_node *root, token_ordering token_order, size_t max_results,
                          std::vector<art_leaf *> &results) {
+    topk_iter(root, token_order, max_results, true, results);
+    return 0;
+}
+
+/**
+ * Walks the subtree of a node best first. A node with a cache is replaced by its cached leaves,
+ * which is enough as long as no more than `ART_TOPK_SIZE` leaves are asked for.
+ */
+static void topk_iter(const art_node *root, token_ordering token_order, size_t max_results, bool use_caches,
+                      std::vector<art_leaf *> &results) {
     printf("INSIDE art_topk_iter: root->type: %d\n", root->type);
 
+    use_caches = use_caches && max_results <= ART_TOPK_SIZE;
+
     std::priority_queue<const art_node *, std::vector<const art_node *>,
             decltype(&compare_art_node_score_pq)> q(compare_art_node_score_pq);
 
@@ -926,6 +1247,14 @@ int art_topk_iter(const art_node *root, token_ordering token_order, size_t max_r
             continue;
         }
 
+        if (use_caches && n->topk != nullptr) {
+            art_leaf** leaves = topk_leaves(n->topk, token_order);
+            for (int i=0; i < n->topk->num_leaves; i++) {
+                q.push((art_node *) SET_LEAF(leaves[i]));
+            }
+            continue;
+        }
+
         int idx;
         switch (n->type) {
             case NODE4:
@@ -969,7 +1298,6 @@ int art_topk_iter(const art_node *root, token_ordering token_order, size_t max_r
     }
 
     printf("OUTSIDE art_topk_iter: results size: %d\n", results.size());
-    return 0;
 }
 
 // Recursively iterates over the tree
@@ -1087,32 +1415,22 @@ int art_iter_prefix(art_tree *t, const unsigned char *key, int key_len, art_call
         printf("IS_INTERNAL\n");
         printf("Prefix len: %d, children: %d, depth: %d, partial: %s\n", n->partial_len, n->num_children, depth, n->partial);
 
-        // If the depth matches the prefix, we need to handle this node
+        // If the depth matches the prefix, the path to the node has been compared in full
         if (depth == key_len) {
-            art_leaf *l = minimum(n);
-            printf("DEPTH LEAF len: %d, key: %s\n", l->key_len, l->key);
-
-            if (!leaf_prefix_matches(l, key, key_len))
-                return recursive_iter(n, cb, data);
-            return 0;
+            return recursive_iter(n, cb, data);
         }
 
         // Bail if the prefix does not match
         if (n->partial_len) {
-            prefix_len = prefix_mismatch(n, key, key_len, depth);
+            prefix_len = check_prefix(n, key, key_len, depth);
 
-            // Guard if the mis-match is longer than the MAX_PREFIX_LEN
-            if (prefix_len > n->partial_len) {
-                prefix_len = n->partial_len;
+            // If we've matched the prefix, iterate on this node
+            if (depth + prefix_len == key_len) {
+                return recursive_iter(n, cb, data);
             }
 
             // If there is no match, search is terminated
-            if (!prefix_len) {
-                return 0;
-            } else if (depth + prefix_len == key_len) {
-                // If we've matched the prefix, iterate on this node
-                return recursive_iter(n, cb, data);
-            } else if(depth + n->partial_len >= key_len) {
+            if (prefix_len != (int) n->partial_len) {
                 return 0;
             }
 
@@ -1138,12 +1456,6 @@ void print_row(const int* row, const int row_len) {
     printf("\n");
 }
 
-static inline void copyIntArray2(const int *src, int *dest, const int len) {
-    for(int t=0; t<len; t++) {
-        dest[t] = src[t];
-    }
-}
-
 static inline int levenshtein_dist(const int depth, const unsigned char p, const unsigned char c,
                                    const unsigned char* term, const int term_len,
                                    const int* irow, const int* jrow, int* krow) {
@@ -1174,8 +1486,144 @@ static inline int levenshtein_dist(const int depth, const unsigned char p, const
     return row_min;
 }
 
-static inline void art_fuzzy_children(unsigned char p, const art_node *n, int depth, const unsigned char *term, const int term_len,
-                                      const int* irow, const int* jrow, const int min_cost, const int max_cost,
+/*
+ * Levenshtein automaton of a term, with an adjacent transposition counted as a single edit, simulated bit-parallel.
+ * Bit `j` of `rows[e]` is set when the first `j` chars of the term are within `e` edits of the key chars fed so far,
+ * so a row of the distance matrix is held up to `max_cost` in a word per cost, and a char is fed with a few word
+ * operations per cost instead of a pass over the term. Any cost above `max_cost` reads as `max_cost + 1`.
+ */
+struct fuzzy_bit_rows {
+    static const int MAX_TERM_LEN = 63;
+    static const int MAX_COST = 2;
+
+    // compiled once per search: bit `j` of the mask of a char is set when it is the `j`th char of the term
+    struct automaton_t {
+        uint64_t char_masks[256];
+        uint64_t row_mask;
+        int term_len;
+        int max_cost;
+
+        automaton_t(const unsigned char* term, const int term_len, const int max_cost):
+                    term_len(term_len), max_cost(max_cost) {
+            memset(char_masks, 0, sizeof(char_masks));
+            for(int j = 1; j <= term_len; j++) {
+                char_masks[term[j-1]] |= (1ULL << j);
+            }
+
+            row_mask = (term_len == 63) ? ~0ULL : ((1ULL << (term_len + 1)) - 1);
+        }
+    };
+
+    const automaton_t* automaton;
+    uint64_t prev_rows[MAX_COST + 1];
+    uint64_t rows[MAX_COST + 1];
+
+    explicit fuzzy_bit_rows(const automaton_t* automaton): automaton(automaton) {
+        // the first `e` chars of the term are within `e` edits of the empty key
+        for(int e = 0; e <= automaton->max_cost; e++) {
+            rows[e] = prev_rows[e] = ((1ULL << (e + 1)) - 1) & automaton->row_mask;
+        }
+    }
+
+    // feeds the key char `c` at `depth`, following `p`, and returns the lowest cost of the new row past its start
+    int feed(const int depth, const unsigned char p, const unsigned char c) {
+        const uint64_t c_mask = automaton->char_masks[c];
+        const uint64_t transposed_mask = (depth > 1) ? ((c_mask << 1) & automaton->char_masks[p]) : 0;
+        uint64_t new_rows[MAX_COST + 1];
+
+        new_rows[0] = (rows[0] << 1) & c_mask & automaton->row_mask;
+
+        for(int e = 1; e <= automaton->max_cost; e++) {
+            new_rows[e] = (((rows[e] << 1) & c_mask) |           // match
+                           (rows[e-1] << 1) |                    // substitution
+                           rows[e-1] |                           // deletion
+                           (new_rows[e-1] << 1) |                // insertion
+                           ((prev_rows[e-1] << 2) & transposed_mask)) & automaton->row_mask;
+        }
+
+        int row_min = automaton->max_cost + 1;
+
+        for(int e = 0; e <= automaton->max_cost; e++) {
+            prev_rows[e] = rows[e];
+            rows[e] = new_rows[e];
+
+            if(row_min > automaton->max_cost && (new_rows[e] & ~1ULL) != 0) {
+                row_min = e;
+            }
+        }
+
+        return row_min;
+    }
+
+    // cost of the whole term against the key chars fed so far
+    int final_cost() const {
+        for(int e = 0; e <= automaton->max_cost; e++) {
+            if(rows[e] & (1ULL << automaton->term_len)) {
+                return e;
+            }
+        }
+
+        return automaton->max_cost + 1;
+    }
+};
+
+/*
+ * Rows of the distance matrix as ints, for a term too long or a cost too high for `fuzzy_bit_rows`.
+ * The rows of every depth of the walk are kept one after the other in a matrix shared by the whole search, so that
+ * a copy of the rows is only a count of the chars fed: the rows of a depth are overwritten only once the walk has
+ * come back up to feed another char at that depth, and nothing is allocated per node.
+ */
+struct fuzzy_dp_rows {
+    struct automaton_t {
+        const unsigned char* term;
+        int term_len;
+        std::vector<int> matrix;
+
+        automaton_t(const unsigned char* term, const int term_len): term(term), term_len(term_len) {
+
+        }
+    };
+
+    automaton_t* automaton;
+    size_t num_fed;  // the current row is the one at `num_fed + 1`, the one before it at `num_fed`
+
+    explicit fuzzy_dp_rows(automaton_t* automaton): automaton(automaton), num_fed(0) {
+        const size_t row_len = automaton->term_len + 1;
+        automaton->matrix.resize(2 * row_len);
+
+        for(size_t i = 0; i < row_len; i++) {
+            automaton->matrix[i] = automaton->matrix[row_len + i] = (int) i;
+        }
+    }
+
+    int feed(const int depth, const unsigned char p, const unsigned char c) {
+        const size_t row_len = automaton->term_len + 1;
+        std::vector<int> & matrix = automaton->matrix;
+
+        if(matrix.size() < (num_fed + 3) * row_len) {
+            matrix.resize(std::max(2 * matrix.size(), (num_fed + 3) * row_len));
+        }
+
+        int* prev_row = &matrix[num_fed * row_len];
+        int row_min = levenshtein_dist(depth, p, c, automaton->term, automaton->term_len,
+                                       prev_row, prev_row + row_len, prev_row + 2 * row_len);
+        num_fed++;
+        return row_min;
+    }
+
+    int final_cost() const {
+        return automaton->matrix[(num_fed + 1) * (automaton->term_len + 1) + automaton->term_len];
+    }
+};
+
+template <class rows_t>
+static void art_fuzzy_recurse(unsigned char p, unsigned char c, const art_node *n, int depth, const int term_len,
+                              rows_t rows, const int min_cost, const int max_cost, const bool prefix,
+                              std::vector<const art_node *> &results);
+
+template <class rows_t>
+static inline void art_fuzzy_children(unsigned char p, const art_node *n, int depth, const int term_len,
+                                      const rows_t & rows, const int min_cost, const int max_cost,
                                       const bool prefix, std::vector<const art_node *> &results) {
     char child_char;
     art_node* child;
@@ -1187,7 +1635,7 @@ static inline void art_fuzzy_children(unsigned char p, const art_node *n, int de
                 child_char = ((art_node4*)n)->keys[i];
                 printf("4!child_char: %c, %d, depth: %d\n", child_char, child_char, depth);
                 child = ((art_node4*)n)->children[i];
-                art_fuzzy_recurse(p, child_char, child, depth, term, term_len, irow, jrow, min_cost, max_cost, prefix, results);
+                art_fuzzy_recurse(p, child_char, child, depth, term_len, rows, min_cost, max_cost, prefix, results);
             }
             break;
         case NODE16:
@@ -1196,7 +1644,7 @@ static inline void art_fuzzy_children(unsigned char p, const art_node *n, int de
                 child_char = ((art_node16*)n)->keys[i];
                 printf("16!child_char: %c, depth: %d\n", child_char, depth);
                 child = ((art_node16*)n)->children[i];
-                art_fuzzy_recurse(p, child_char, child, depth, term, term_len, irow, jrow, min_cost, max_cost, prefix, results);
+                art_fuzzy_recurse(p, child_char, child, depth, term_len, rows, min_cost, max_cost, prefix, results);
             }
             break;
         case NODE48:
@@ -1207,7 +1655,7 @@ static inline void art_fuzzy_children(unsigned char p, const art_node *n, int de
                 child = ((art_node48*)n)->children[ix - 1];
                 child_char = (char)i;
                 printf("48!child_char: %c, depth: %d, ix: %d\n", child_char, depth, ix);
-                art_fuzzy_recurse(p, child_char, child, depth, term, term_len, irow, jrow, min_cost, max_cost, prefix, results);
+                art_fuzzy_recurse(p, child_char, child, depth, term_len, rows, min_cost, max_cost, prefix, results);
             }
             break;
         case NODE256:
@@ -1217,7 +1665,7 @@ static inline void art_fuzzy_children(unsigned char p, const art_node *n, int de
                 child_char = (char) i;
                 printf("256!child_char: %c, depth: %d\n", child_char, depth);
                 child = ((art_node256*)n)->children[i];
-                art_fuzzy_recurse(p, child_char, child, depth, term, term_len, irow, jrow, min_cost, max_cost, prefix, results);
+                art_fuzzy_recurse(p, child_char, child, depth, term_len, rows, min_cost, max_cost, prefix, results);
             }
             break;
         default:
@@ -1225,29 +1673,16 @@ static inline void art_fuzzy_children(unsigned char p, const art_node *n, int de
     }
 }
 
-static inline void rotate(int &i, int &j, int &k) {
-    int old_i = i;
-    i = j;
-    j = k;
-    k = old_i;
-}
-
 // e.g. catapult against coratapult
 // e.g. microafot against microsoft
-static void art_fuzzy_recurse(unsigned char p, unsigned char c, const art_node *n, int depth, const unsigned char *term,
-                              const int term_len, const int* irow, const int* jrow, const int min_cost,
-                              const int max_cost, const bool prefix, std::vector<const art_node *> &results) {
+template <class rows_t>
+static void art_fuzzy_recurse(unsigned char p, unsigned char c, const art_node *n, int depth, const int term_len,
+                              rows_t rows, const int min_cost, const int max_cost, const bool prefix,
+                              std::vector<const art_node *> &results) {
     if (!n) return ;
 
-    const int columns = term_len+1;
-    int i=0, j=1, k=2;
-    int row0[columns];
-    int row1[columns];
-    int row2[columns];
-    int* rows[3] = {row0, row1, row2};
-
-    copyIntArray2(irow, rows[i], columns);
-    copyIntArray2(jrow, rows[j], columns);
+    // stop walking the tree once the search is out of time: candidates found so far are still used
+    if (search_cutoff::exceeded_sampled()) return ;
 
     int temp_cost = 0;
 
@@ -1257,8 +1692,7 @@ static void art_fuzzy_recurse(unsigned char p, unsigned char c, const art_node *
     }
 
     // First calculate cost with node char `c` and then leaf/partial related costs
-    temp_cost = levenshtein_dist(depth, p, c, term, term_len, rows[i], rows[j], rows[k]);
-    rotate(i, j, k);
+    temp_cost = rows.feed(depth, p, c);
     p = c;
 
     depth++;
@@ -1285,23 +1719,22 @@ static void art_fuzzy_recurse(unsigned char p, unsigned char c, const art_node *
          */
         const int end_index = prefix ? min(l->key_len, term_len) : l->key_len;
 
-        // If at any point, `temp_cost > 2*max_cost` we can terminate immediately as we can never recover from that
-        while(depth < end_index && temp_cost <= 2*max_cost) {
+        // The lowest cost of a row never goes down further into the key, so once past `max_cost` we can terminate
+        while(depth < end_index && temp_cost <= max_cost) {
             c = l->key[depth];
-            temp_cost = levenshtein_dist(depth, p, c, term, term_len, rows[i], rows[j], rows[k]);
+            temp_cost = rows.feed(depth, p, c);
             printf("leaf char: %c\n", l->key[depth]);
             printf("cost: %d, depth: %d, term_len: %d\n", cost, depth, term_len);
-            rotate(i, j, k);
             p = c;
             depth++;
         }
 
-        /* `rows[j][columns-1]` holds the final cost, `temp_cost` holds the temporary cost.
+        /* `rows.final_cost()` holds the final cost, `temp_cost` holds the temporary cost.
             We will use the intermediate cost if the term is shorter than the key and if it's a prefix search.
             For non-prefix, we will only use final cost.
          */
 
-        int final_cost = rows[j][columns-1];
+        int final_cost = rows.final_cost();
 
         if(prefix && term_len < (int) l->key_len && temp_cost >= min_cost && temp_cost <= max_cost) {
             results.push_back(n);
@@ -1331,19 +1764,24 @@ static void art_fuzzy_recurse(unsigned char p, unsigned char c, const art_node *
 
     // For non-prefix search or if we have not reached term length, we will recurse further
 
-    const int partial_len = min(MAX_PREFIX_LEN, n->partial_len);
-    const int end_index = min(partial_len, term_len+max_cost);
+    const unsigned char* partial = node_partial(n);
+    const int partial_len = n->partial_len;
 
     printf("partial_len: %d\n", partial_len);
-    
-    for(int idx=0; idx<end_index; idx++) {
-        c = n->partial[idx];
+
+    // the whole prefix is fed, since every byte of it is on the path of the keys below
+    for(int idx=0; idx<partial_len; idx++) {
+        c = partial[idx];
         printf("partial: %c\n", c);
-        temp_cost = levenshtein_dist(depth+idx, p, c, term, term_len, rows[i], rows[j], rows[k]);
-        rotate(i, j, k);
+        temp_cost = rows.feed(depth+idx, p, c);
         p = c;
 
-        if(prefix && depth+idx+1 >= term_len && temp_cost <= max_cost) {
+        // no key below this node can come back within `max_cost`
+        if(temp_cost > max_cost) {
+            return ;
+        }
+
+        if(prefix && depth+idx+1 >= term_len) {
             // For a prefix search, we store the node and not recurse further right now
             results.push_back(n);
             return ;
@@ -1353,7 +1791,23 @@ static void art_fuzzy_recurse(unsigned char p, unsigned char c, const art_node *
     depth += n->partial_len;
     printf("cost: %d\n", cost);
 
-    art_fuzzy_children(c, n, depth, term, term_len, rows[i], rows[j], min_cost, max_cost, prefix, results);
+    art_fuzzy_children(c, n, depth, term_len, rows, min_cost, max_cost, prefix, results);
+}
+
+template <class rows_t>
+static void art_fuzzy_walk(art_tree *t, const int term_len, const rows_t & rows, const int min_cost,
+                           const int max_cost, const bool prefix, std::vector<const art_node *> &nodes) {
+    if(IS_LEAF(t->root)) {
+        art_leaf *l = (art_leaf *) LEAF_RAW(t->root);
+        art_fuzzy_recurse(0, l->key[0], t->root, 0, term_len, rows, min_cost, max_cost, prefix, nodes);
+    } else {
+        if(t->root == nullptr) {
+            return ;
+        }
+
+        // send depth as -1 to indicate that this is a root node
+        art_fuzzy_recurse(0, 0, t->root, -1, term_len, rows, min_cost, max_cost, prefix, nodes);
+    }
 }
 
 /**
@@ -1364,24 +1818,15 @@ int art_fuzzy_search(art_tree *t, const unsigned char *term, const int term_len,
                      std::vector<art_leaf *> &results) {
 
     std::vector<const art_node*> nodes;
-    int irow[term_len + 1];
-    int jrow[term_len + 1];
-    for (int i = 0; i <= term_len; i++){
-        irow[i] = jrow[i] = i;
-    }
 
     //auto begin = std::chrono::high_resolution_clock::now();
 
-    if(IS_LEAF(t->root)) {
-        art_leaf *l = (art_leaf *) LEAF_RAW(t->root);
-        art_fuzzy_recurse(0, l->key[0], t->root, 0, term, term_len, irow, jrow, min_cost, max_cost, prefix, nodes);
+    if(term_len <= fuzzy_bit_rows::MAX_TERM_LEN && max_cost <= fuzzy_bit_rows::MAX_COST) {
+        const fuzzy_bit_rows::automaton_t automaton(term, term_len, max_cost);
+        art_fuzzy_walk(t, term_len, fuzzy_bit_rows(&automaton), min_cost, max_cost, prefix, nodes);
     } else {
-        if(t->root == nullptr) {
-            return 0;
-        }
-
-        // send depth as -1 to indicate that this is a root node
-        art_fuzzy_recurse(0, 0, t->root, -1, term, term_len, irow, jrow, min_cost, max_cost, prefix, nodes);
+        fuzzy_dp_rows::automaton_t automaton(term, term_len);
+        art_fuzzy_walk(t, term_len, fuzzy_dp_rows(&automaton), min_cost, max_cost, prefix, nodes);
     }
 
     PROCESS_NODES:
@@ -1397,8 +1842,11 @@ int art_fuzzy_search(art_tree *t, const unsigned char *term, const int term_len,
 
     //begin = std::chrono::high_resolution_clock::now();
 
+    // the caches of the nodes are only read for large trees, whose walks they actually cut short
+    const bool use_caches = (t->size >= TOPK_MIN_KEYS);
+
     for(auto node: nodes) {
-        art_topk_iter(node, token_order, max_words, results);
+        topk_iter(node, token_order, max_words, use_caches, results);
     }
 
     if(token_order == FREQUENCY) {
@@ -1611,13 +2059,14 @@ void art_int_fuzzy_recurse(art_node *n, int depth, const unsigned char* int_str,
         return ;
     }
 
-    const int partial_len = min(MAX_PREFIX_LEN, n->partial_len);
+    const unsigned char* partial = node_partial(n);
+    const int partial_len = n->partial_len;
     const int end_index = min(partial_len, int_str_len);
 
     printf("\npartial_len: %d", partial_len);
 
     for(int idx=0; idx<end_index; idx++) {
-        unsigned char c = n->partial[idx];
+        unsigned char c = partial[idx];
         recurse_progress progress = matches(c, int_str[depth+idx], comparator);
         if(progress == ABORT) {
             return;
@@ -0,0 +1,70 @@
+#include "art_arena.h"
+#include <cstdlib>
+
+art_arena::~art_arena() {
+    for(char* slab: slabs) {
+        free(slab);
+    }
+}
+
+void art_arena::push_free(void* p, size_t size) {
+    void** head = &free_lists[size / CLASS_ALIGN];
+    *(void**) p = *head;
+    *head = p;
+}
+
+void art_arena::new_slab() {
+    // the rest of the current slab is too small for the object being allocated, but not for a smaller class
+    if(slab_left != 0) {
+        push_free(slab_head, slab_left);
+    }
+
+    slab_head = (char *) malloc(next_slab_size);
+    slab_left = next_slab_size;
+    slabs.push_back(slab_head);
+
+    slab_bytes += next_slab_size;
+    if(next_slab_size < MAX_SLAB_SIZE) {
+        next_slab_size *= 2;
+    }
+}
+
+void* art_arena::alloc(size_t size) {
+    const size_t object_size = class_size(size);
+
+    if(object_size > MAX_CLASS_SIZE) {
+        large_bytes += size;
+        return malloc(size);
+    }
+
+    used_bytes += object_size;
+
+    void** head = &free_lists[object_size / CLASS_ALIGN];
+    if(*head != nullptr) {
+        void* p = *head;
+        *head = *(void**) p;
+        return p;
+    }
+
+    if(slab_left < object_size) {
+        new_slab();
+    }
+
+    void* p = slab_head;
+    slab_head += object_size;
+    slab_left -= object_size;
+    return p;
+}
+
+void art_arena::release(void* p, size_t size) {
+    const size_t object_size = class_size(size);
+
+    if(object_size > MAX_CLASS_SIZE) {
+        large_bytes -= size;
+        free(p);
+        return ;
+    }
+
+    used_bytes -= object_size;
+    push_free(p, object_size);
+}
@@ -63,7 +63,11 @@ Option<api_key_t> AuthManager::create_key(api_key_t& api_key) {
         return Option<api_key_t>(500, "Could not store generated API key.");
     }
 
-    api_keys.emplace(api_key.value, api_key);
+    {
+        write_lock_guard lock(api_keys_lock);
+        api_keys.emplace(api_key.value, api_key);
+    }
+
     return Option<api_key_t>(api_key);
 }
 
@@ -80,7 +84,11 @@ Option<api_key_t> AuthManager::remove_key(uint32_t id) {
     }
 
     api_key_t&& key = key_op.get();
-    api_keys.erase(key.value);
+
+    {
+        write_lock_guard lock(api_keys_lock);
+        api_keys.erase(key.value);
+    }
 
     return Option<api_key_t>(key.truncate_value());
 }
@@ -125,6 +133,8 @@ Option<bool> AuthManager::init(Store *store) {
 bool AuthManager::authenticate(const std::string& req_api_key, const std::string& action,
                                const std::string& collection, std::map<std::string, std::string> & params) {
 
+    read_lock_guard lock(api_keys_lock);
+
     if(req_api_key.size() > KEY_LEN) {
         // scoped API key: validate and if valid, extract params
         Option<std::string> params_op = params_from_scoped_key(req_api_key, action, collection);
@@ -166,7 +176,7 @@ bool AuthManager::authenticate(const std::string& req_api_key, const std::string
         return false;
     }
 
-    const api_key_t& api_key = api_keys[req_api_key];
+    const api_key_t& api_key = api_keys.at(req_api_key);
 
     // check if action is allowed
 
@@ -36,9 +36,12 @@ struct match_index_t {
 
 Collection::Collection(const std::string name, const uint32_t collection_id, const uint64_t created_at,
                        const uint32_t next_seq_id, Store *store, const std::vector<field> &fields,
-                       const std::string & default_sorting_field, const size_t num_indices):
-                       name(name), collection_id(collection_id), next_seq_id(next_seq_id), store(store),
-                       fields(fields), default_sorting_field(default_sorting_field), num_indices(num_indices) {
+                       const std::string & default_sorting_field, const size_t num_indices,
+                       ThreadPool* search_pool, SearchCache* search_cache):
+                       name(name), collection_id(collection_id), search_pool(search_pool),
+                       search_cache(search_cache), write_generation(0), next_seq_id(next_seq_id),
+                       store(store), fields(fields), default_sorting_field(default_sorting_field),
+                       num_indices(num_indices) {
 
     for(const field& field: fields) {
         search_schema.emplace(field.name, field);
@@ -53,10 +56,8 @@ Collection::Collection(const std::string name, const uint32_t collection_id, con
     }
 
     for(size_t i = 0; i < num_indices; i++) {
-        Index* index = new Index(name+std::to_string(i), search_schema, facet_schema, sort_schema);
+        Index* index = new Index(name+std::to_string(i), search_schema, facet_schema, sort_schema, search_pool);
         indices.push_back(index);
-        std::thread* thread = new std::thread(&Index::run_search, index);
-        index_threads.push_back(thread);
     }
 
     this->created_at = created_at;
@@ -65,21 +66,11 @@ Collection::Collection(const std::string name, const uint32_t collection_id, con
 
 Collection::~Collection() {
     for(size_t i = 0; i < indices.size(); i++) {
-        std::thread *t = index_threads[i];
-        Index* index = indices[i];
-        index->ready = true;
-        index->terminate = true;
-        index->cv.notify_one();
-        t->join();
-
-        delete t;
         delete indices[i];
-        t = nullptr;
         indices[i] = nullptr;
     }
 
     indices.clear();
-    index_threads.clear();
 }
 
 uint32_t Collection::get_next_seq_id() {
@@ -131,7 +122,7 @@ nlohmann::json Collection::get_summary_json() {
     nlohmann::json json_response;
 
     json_response["name"] = name;
-    json_response["num_documents"] = num_documents;
+    json_response["num_documents"] = get_num_documents();
     json_response["created_at"] = created_at;
 
     nlohmann::json fields_arr;
@@ -142,6 +133,11 @@ nlohmann::json Collection::get_summary_json() {
         field_json[fields::type] = coll_field.type;
         field_json[fields::facet] = coll_field.facet;
         field_json[fields::optional] = coll_field.optional;
+
+        if(coll_field.is_string()) {
+            field_json[fields::positions] = coll_field.positions;
+        }
+
         fields_arr.push_back(field_json);
     }
 
@@ -150,6 +146,64 @@ nlohmann::json Collection::get_summary_json() {
     return json_response;
 }
 
+nlohmann::json Collection::get_memory_json() {
+    std::map<std::string, field_memory_t> field_memory;
+
+    {
+        read_lock_guard read_lock(lock);
+        for(Index* index: indices) {
+            index->add_memory_usage(field_memory);
+        }
+    }
+
+    nlohmann::json memory_json;
+    nlohmann::json fields_json = nlohmann::json::object();
+    size_t total_bytes = 0;
+
+    for(const auto & name_memory: field_memory) {
+        const field_memory_t & memory = name_memory.second;
+        nlohmann::json field_json;
+
+        field_json["node4"] = memory.tree.num_nodes[0];
+        field_json["node16"] = memory.tree.num_nodes[1];
+        field_json["node48"] = memory.tree.num_nodes[2];
+        field_json["node256"] = memory.tree.num_nodes[3];
+        field_json["node_bytes"] = memory.tree.node_bytes;
+        field_json["leaves"] = memory.tree.num_leaves;
+        field_json["leaf_bytes"] = memory.tree.leaf_bytes;
+        field_json["posting_bytes"] = memory.tree.posting_bytes;
+        field_json["position_bytes"] = memory.tree.position_bytes;
+        field_json["arena_bytes"] = memory.tree.arena_bytes;
+        field_json["arena_free_bytes"] = memory.tree.arena_free_bytes;
+        field_json["facet_bytes"] = memory.facet_bytes;
+        field_json["sort_bytes"] = memory.sort_bytes;
+        field_json["total_bytes"] = memory.total_bytes();
+
+        fields_json[name_memory.first] = field_json;
+        total_bytes += memory.total_bytes();
+    }
+
+    memory_json["total_bytes"] = total_bytes;
+    memory_json["fields"] = fields_json;
+    return memory_json;
+}
+
+nlohmann::json Collection::get_arena_memory_json() {
+    art_memory memory = {};
+
+    {
+        read_lock_guard read_lock(lock);
+        for(Index* index: indices) {
+            index->add_arena_usage(memory);
+        }
+    }
+
+    nlohmann::json memory_json;
+    memory_json["arena_bytes"] = memory.arena_bytes;
+    memory_json["arena_free_bytes"] = memory.arena_free_bytes;
+    return memory_json;
+}
+
 Option<nlohmann::json> Collection::add(const std::string & json_str) {
     nlohmann::json document;
     Option<uint32_t> doc_seq_id_op = to_doc(json_str, document);
@@ -161,6 +215,9 @@ Option<nlohmann::json> Collection::add(const std::string & json_str) {
     const uint32_t seq_id = doc_seq_id_op.get();
     const std::string seq_id_str = std::to_string(seq_id);
 
+    // the document is stored before the lock is released, so that a search never finds it missing from the store
+    write_lock_guard write_lock(lock);
+
     const Option<uint32_t> & index_memory_op = index_in_memory(document, seq_id);
 
     if(!index_memory_op.ok()) {
@@ -195,6 +252,8 @@ Option<nlohmann::json> Collection::add_many(const std::string & json_lines_str)
         iter_batch.push_back(std::vector<index_record>());
     }
 
+    size_t num_batched = 0;
+
     for(size_t i=0; i < json_lines.size(); i++) {
         const std::string & json_line = json_lines[i];
 
@@ -204,38 +263,36 @@ Option<nlohmann::json> Collection::add_many(const std::string & json_lines_str)
         if(!doc_seq_id_op.ok()) {
             index_record record(i, 0, "", document);
             result.failure(record, doc_seq_id_op.code(), doc_seq_id_op.error());
-            continue;
+        } else {
+            const uint32_t seq_id = doc_seq_id_op.get();
+            index_record record(i, seq_id, json_line, document);
+            iter_batch[seq_id % this->get_num_indices()].push_back(record);
+            num_batched++;
         }
 
-        const uint32_t seq_id = doc_seq_id_op.get();
-        index_record record(i, seq_id, json_line, document);
-        iter_batch[seq_id % this->get_num_indices()].push_back(record);
-    }
-
-    par_index_in_memory(iter_batch, result);
+        // searches on the collection are held off for one batch at a time, instead of the whole import
+        if(num_batched == IMPORT_BATCH_SIZE || (i == json_lines.size() - 1 && num_batched != 0)) {
+            batch_index_result batch_result;
 
-    std::sort(result.items.begin(), result.items.end());
-
-    // store documents only documents that were indexed in-memory successfully
-    for(index_result & item: result.items) {
-        if(item.index_op.ok()) {
-            rocksdb::WriteBatch batch;
-            const std::string seq_id_str = std::to_string(item.record.seq_id);
-
-            batch.Put(get_doc_id_key(item.record.document["id"]), seq_id_str);
-            batch.Put(get_seq_id_key(item.record.seq_id), item.record.document.dump());
-            bool write_ok = store->batch_write(batch);
+            {
+                write_lock_guard write_lock(lock);
+                par_index_in_memory(iter_batch, batch_result);
+                store_indexed_documents(batch_result);
+            }
 
-            if(!write_ok) {
-                Option<bool> index_op_failure(500, "Could not write to on-disk storage.");
-                item.index_op = index_op_failure;
+            result.items.insert(result.items.end(), batch_result.items.begin(), batch_result.items.end());
+            result.num_indexed += batch_result.num_indexed;
 
-                // remove from in-memory store to keep the state synced
-                remove_document(item.record.document, item.record.seq_id, false);
+            for(size_t j = 0; j < num_indices; j++) {
+                iter_batch[j].clear();
             }
+
+            num_batched = 0;
         }
     }
 
+    std::sort(result.items.begin(), result.items.end());
+
     nlohmann::json resp;
     resp["success"] = (result.num_indexed == json_lines.size());
     resp["num_imported"] = result.num_indexed;
@@ -257,6 +314,28 @@ Option<nlohmann::json> Collection::add_many(const std::string & json_lines_str)
     return Option<nlohmann::json>(resp);
 }
 
+void Collection::store_indexed_documents(batch_index_result & result) {
+    // store documents only documents that were indexed in-memory successfully
+    for(index_result & item: result.items) {
+        if(item.index_op.ok()) {
+            rocksdb::WriteBatch batch;
+            const std::string seq_id_str = std::to_string(item.record.seq_id);
+
+            batch.Put(get_doc_id_key(item.record.document["id"]), seq_id_str);
+            batch.Put(get_seq_id_key(item.record.seq_id), item.record.document.dump());
+            bool write_ok = store->batch_write(batch);
+
+            if(!write_ok) {
+                Option<bool> index_op_failure(500, "Could not write to on-disk storage.");
+                item.index_op = index_op_failure;
+
+                // remove from in-memory store to keep the state synced
+                remove_document(item.record.document, item.record.seq_id, false);
+            }
+        }
+    }
+}
+
 Option<uint32_t> Collection::index_in_memory(const nlohmann::json &document, uint32_t seq_id) {
     Option<uint32_t> validation_op = Index::validate_index_in_memory(document, seq_id, default_sorting_field,
                                                                      search_schema, facet_schema);
@@ -269,12 +348,12 @@ Option<uint32_t> Collection::index_in_memory(const nlohmann::json &document, uin
     index->index_in_memory(document, seq_id, default_sorting_field);
 
     num_documents += 1;
+    write_generation++;
     return Option<>(200);
 }
 
 void Collection::par_index_in_memory(std::vector<std::vector<index_record>> & iter_batch,
                                      batch_index_result & result) {
-
     std::vector<std::future<batch_index_result>> futures;
 
     for(size_t i=0; i < num_indices; i++) {
@@ -290,6 +369,8 @@ void Collection::par_index_in_memory(std::vector<std::vector<index_record>> & it
         result.num_indexed += future_res.num_indexed;
         num_documents += future_res.num_indexed;
     }
+
+    write_generation++;
 }
 
 void Collection::prune_document(nlohmann::json &document, const spp::sparse_hash_set<std::string>& include_fields,
@@ -372,7 +453,182 @@ Option<nlohmann::json> Collection::search(const std::string & query, const std::
                                   const std::string & highlight_full_fields,
                                   size_t typo_tokens_threshold,
                                   const std::map<std::string, size_t>& pinned_hits,
-                                  const std::vector<std::string>& hidden_hits) {
+                                  const std::vector<std::string>& hidden_hits,
+                                  const size_t search_cutoff_ms,
+                                  filter_result_cache_t* filter_cache,
+                                  search_stage_times_t* stage_times) {
+
+    // writes to the collection wait for the search to finish, including the highlighting of its leaves
+    read_lock_guard read_lock(lock);
+
+    // stages timed on this thread, plus those reported back by each index, add up here
+    search_stage_timer::reset();
+
+    auto record_stage_times = [stage_times](const Option<nlohmann::json> & result_op) {
+        if(!result_op.ok()) {
+            return ;
+        }
+
+        const search_stage_times_t & times = search_stage_timer::get_times();
+        search_stage_histograms::get_instance().record(times);
+
+        if(stage_times != nullptr) {
+            *stage_times = times;
+        }
+    };
+
+    if(search_cache == nullptr || !search_cache->is_enabled()) {
+        const Option<nlohmann::json> & result_op = do_search(
+            query, search_fields, simple_filter_query, facet_fields, sort_fields, num_typos,
+            per_page, page, token_order, prefix, drop_tokens_threshold, include_fields, exclude_fields,
+            max_facet_values, simple_facet_query, snippet_threshold, highlight_full_fields,
+            typo_tokens_threshold, pinned_hits, hidden_hits, search_cutoff_ms, filter_cache
+        );
+
+        record_stage_times(result_op);
+        return result_op;
+    }
+
+    const std::string & cache_key = get_search_cache_key(
+        query, search_fields, simple_filter_query, facet_fields, sort_fields, num_typos, per_page, page, token_order,
+        prefix, drop_tokens_threshold, include_fields, exclude_fields, max_facet_values, simple_facet_query,
+        snippet_threshold, highlight_full_fields, typo_tokens_threshold, pinned_hits, hidden_hits,
+        search_cutoff_ms
+    );
+
+    // read the generation before searching, so that a write racing with the search invalidates this entry
+    const uint64_t search_write_generation = write_generation;
+
+    nlohmann::json cached_result;
+    if(search_cache->get(cache_key, search_write_generation, cached_result)) {
+        if(stage_times != nullptr) {
+            *stage_times = search_stage_times_t();
+            stage_times->from_cache = true;
+        }
+
+        return Option<nlohmann::json>(cached_result);
+    }
+
+    const Option<nlohmann::json> & result_op = do_search(
+        query, search_fields, simple_filter_query, facet_fields, sort_fields, num_typos, per_page, page, token_order,
+        prefix, drop_tokens_threshold, include_fields, exclude_fields, max_facet_values, simple_facet_query,
+        snippet_threshold, highlight_full_fields, typo_tokens_threshold, pinned_hits, hidden_hits,
+        search_cutoff_ms, filter_cache
+    );
+
+    record_stage_times(result_op);
+
+    // a result cut short by the time budget is not worth keeping around
+    if(result_op.ok() && !result_op.get()["search_cutoff"].get<bool>()) {
+        search_cache->put(cache_key, search_write_generation, result_op.get());
+    }
+
+    return result_op;
+}
+
+std::string Collection::get_search_cache_key(const std::string & query, const std::vector<std::string> & search_fields,
+                                  const std::string & simple_filter_query, const std::vector<std::string> & facet_fields,
+                                  const std::vector<sort_by> & sort_fields, const int num_typos,
+                                  const size_t per_page, const size_t page,
+                                  const token_ordering token_order, const bool prefix,
+                                  const size_t drop_tokens_threshold,
+                                  const spp::sparse_hash_set<std::string> & include_fields,
+                                  const spp::sparse_hash_set<std::string> & exclude_fields,
+                                  const size_t max_facet_values,
+                                  const std::string & simple_facet_query,
+                                  const size_t snippet_threshold,
+                                  const std::string & highlight_full_fields,
+                                  size_t typo_tokens_threshold,
+                                  const std::map<std::string, size_t>& pinned_hits,
+                                  const std::vector<std::string>& hidden_hits,
+                                  const size_t search_cutoff_ms) {
+    std::string key;
+
+    // every value is length prefixed so that separators inside values can not produce colliding keys
+    auto append = [&key](const std::string & value) {
+        key += std::to_string(value.size());
+        key += ':';
+        key += value;
+    };
+
+    auto append_set = [&append](const spp::sparse_hash_set<std::string> & values) {
+        std::vector<std::string> sorted_values(values.begin(), values.end());
+        std::sort(sorted_values.begin(), sorted_values.end());
+        append(std::to_string(sorted_values.size()));
+        for(const std::string & value: sorted_values) {
+            append(value);
+        }
+    };
+
+    append(std::to_string(collection_id));
+    append(query);
+
+    append(std::to_string(search_fields.size()));
+    for(const std::string & search_field: search_fields) {
+        append(search_field);
+    }
+
+    append(simple_filter_query);
+
+    append(std::to_string(facet_fields.size()));
+    for(const std::string & facet_field: facet_fields) {
+        append(facet_field);
+    }
+
+    append(std::to_string(sort_fields.size()));
+    for(const sort_by & sort_field: sort_fields) {
+        append(sort_field.name);
+        append(sort_field.order);
+    }
+
+    append(std::to_string(num_typos));
+    append(std::to_string(per_page));
+    append(std::to_string(page));
+    append(std::to_string(token_order));
+    append(std::to_string(prefix));
+    append(std::to_string(drop_tokens_threshold));
+    append_set(include_fields);
+    append_set(exclude_fields);
+    append(std::to_string(max_facet_values));
+    append(simple_facet_query);
+    append(std::to_string(snippet_threshold));
+    append(highlight_full_fields);
+    append(std::to_string(typo_tokens_threshold));
+
+    append(std::to_string(pinned_hits.size()));
+    for(const auto & pinned_hit: pinned_hits) {
+        append(pinned_hit.first);
+        append(std::to_string(pinned_hit.second));
+    }
+
+    append(std::to_string(hidden_hits.size()));
+    for(const std::string & hidden_hit: hidden_hits) {
+        append(hidden_hit);
+    }
+
+    append(std::to_string(search_cutoff_ms));
+
+    return key;
+}
+
+Option<nlohmann::json> Collection::do_search(const std::string & query, const std::vector<std::string> & search_fields,
+                                  const std::string & simple_filter_query, const std::vector<std::string> & facet_fields,
+                                  const std::vector<sort_by> & sort_fields, const int num_typos,
+                                  const size_t per_page, const size_t page,
+                                  const token_ordering token_order, const bool prefix,
+                                  const size_t drop_tokens_threshold,
+                                  const spp::sparse_hash_set<std::string> & include_fields,
+                                  const spp::sparse_hash_set<std::string> & exclude_fields,
+                                  const size_t max_facet_values,
+                                  const std::string & simple_facet_query,
+                                  const size_t snippet_threshold,
+                                  const std::string & highlight_full_fields,
+                                  size_t typo_tokens_threshold,
+                                  const std::map<std::string, size_t>& pinned_hits,
+                                  const std::vector<std::string>& hidden_hits,
+                                  const size_t search_cutoff_ms,
+                                  filter_result_cache_t* filter_cache) {
+    const uint64_t search_stop_us = search_cutoff::get_stop_us(search_cutoff_ms);
 
     std::vector<uint32_t> included_ids;
     std::vector<uint32_t> excluded_ids;
@@ -631,79 +887,62 @@ Option<nlohmann::json> Collection::search(const std::string & query, const std::
     const size_t max_hits = std::min((page * per_page), get_num_documents());
 
     std::vector<std::vector<art_leaf*>> searched_queries;  // search queries used for generating the results
-    std::vector<KV> raw_result_kvs;
     std::vector<KV> override_result_kvs;
 
     size_t total_found = 0;
+    bool cutoff = false;  // when any of the indices ran out of time
 
-    // send data to individual index threads
-    size_t index_id = 0;
-    for(Index* index: indices) {
-        index->search_params = search_args(query, search_fields, filters, facets,
-                                           index_to_included_ids[index_id], index_to_excluded_ids[index_id],
-                                           sort_fields_std, facet_query, num_typos, max_facet_values, max_hits,
-                                           per_page, page, token_order, prefix,
-                                           drop_tokens_threshold, typo_tokens_threshold);
-        {
-            std::lock_guard<std::mutex> lk(index->m);
-            index->ready = true;
-            index->processed = false;
-        }
-        index->cv.notify_one();
-        index_id++;
+    // each index is searched by a separate task that owns its own query state
+    std::vector<search_args> index_search_params;
+    index_search_params.reserve(indices.size());
+
+    std::vector<std::future<void>> index_futures;
+
+    for(size_t index_id = 0; index_id < indices.size(); index_id++) {
+        index_search_params.emplace_back(query, search_fields, filters, facets,
+                                         index_to_included_ids[index_id], index_to_excluded_ids[index_id],
+                                         sort_fields_std, facet_query, num_typos, max_facet_values, max_hits,
+                                         per_page, page, token_order, prefix,
+                                         drop_tokens_threshold, typo_tokens_threshold, search_stop_us,
+                                         simple_filter_query, filter_cache, write_generation);
+        index_futures.push_back(search_pool->enqueue(&Index::run_search, indices[index_id],
+                                                     &index_search_params[index_id]));
     }
 
     Option<nlohmann::json> index_search_op({});  // stores the last error across all index threads
 
-    for(Index* index: indices) {
-        // wait for the worker
-        {
-            std::unique_lock<std::mutex> lk(index->m);
-            index->cv.wait(lk, [index]{return index->processed;});
-        }
+    for(size_t index_id = 0; index_id < indices.size(); index_id++) {
+        // wait for the task
+        index_futures[index_id].wait();
+        search_args & search_params = index_search_params[index_id];
 
-        if(!index->search_params.outcome.ok()) {
-            index_search_op = Option<nlohmann::json>(index->search_params.outcome.code(),
-                                                    index->search_params.outcome.error());
+        if(!search_params.outcome.ok()) {
+            index_search_op = Option<nlohmann::json>(search_params.outcome.code(), search_params.outcome.error());
         }
 
         if(!index_search_op.ok()) {
-            // we still need to iterate without breaking to release the locks
+            // we still need to wait for the remaining tasks since they refer to `index_search_params`
             continue;
         }
 
-        for(auto & field_order_kv: index->search_params.raw_result_kvs) {
+        // raw results are merged across indices further below, after the query indices are re-based
+        for(auto & field_order_kv: search_params.raw_result_kvs) {
             field_order_kv.query_index += searched_queries.size();
-            raw_result_kvs.push_back(field_order_kv);
         }
 
-        for(auto & field_order_kv: index->search_params.override_result_kvs) {
+        for(auto & field_order_kv: search_params.override_result_kvs) {
             field_order_kv.query_index += searched_queries.size();
             override_result_kvs.push_back(field_order_kv);
         }
 
-        searched_queries.insert(searched_queries.end(), index->search_params.searched_queries.begin(),
-                                index->search_params.searched_queries.end());
+        searched_queries.insert(searched_queries.end(), search_params.searched_queries.begin(),
+                                search_params.searched_queries.end());
 
-        for(size_t fi = 0; fi < index->search_params.facets.size(); fi++) {
-            auto & this_facet = index->search_params.facets[fi];
+        for(size_t fi = 0; fi < search_params.facets.size(); fi++) {
+            auto & this_facet = search_params.facets[fi];
             auto & acc_facet = facets[fi];
 
-            for(auto & facet_kv: this_facet.result_map) {
-                size_t count = 0;
-
-                if(acc_facet.result_map.count(facet_kv.first) == 0) {
-                    // not found, so set it
-                    count = facet_kv.second.count;
-                } else {
-                    count = acc_facet.result_map[facet_kv.first].count + facet_kv.second.count;
-                }
-
-                acc_facet.result_map[facet_kv.first].count = count;
-                acc_facet.result_map[facet_kv.first].doc_id = facet_kv.second.doc_id;
-                acc_facet.result_map[facet_kv.first].array_pos = facet_kv.second.array_pos;
-                acc_facet.result_map[facet_kv.first].query_token_pos = facet_kv.second.query_token_pos;
-            }
+            merge_facet_counts(this_facet.result_map, acc_facet.result_map);
 
             if(this_facet.stats.fvcount != 0) {
                 acc_facet.stats.fvcount += this_facet.stats.fvcount;
@@ -713,15 +952,18 @@ Option<nlohmann::json> Collection::search(const std::string & query, const std::
             }
         }
 
-        total_found += index->search_params.all_result_ids_len;
+        total_found += search_params.all_result_ids_len;
+        cutoff = cutoff || search_params.search_cutoff;
+        search_stage_timer::add(search_params.stage_times);
     }
 
     if(!index_search_op.ok()) {
         return index_search_op;
     }
 
-    // All fields are sorted descending
-    std::sort(raw_result_kvs.begin(), raw_result_kvs.end(), Topster::is_greater_kv_value);
+    // Each index returns its results already sorted descending, so only the top `max_hits` need to be merged
+    std::vector<KV> raw_result_kvs;
+    merge_index_results(index_search_params, max_hits, raw_result_kvs);
 
     // Sort based on position in overriden list
     std::sort(
@@ -735,6 +977,7 @@ Option<nlohmann::json> Collection::search(const std::string & query, const std::
 
     result["hits"] = nlohmann::json::array();
     result["found"] = total_found;
+    result["search_cutoff"] = cutoff;
 
     std::vector<KV> result_kvs;
     size_t override_kv_index = 0;
@@ -993,7 +1236,8 @@ void Collection::highlight_result(const field &search_field,
                                   StringUtils & string_utils, size_t snippet_threshold,
                                   bool highlighted_fully,
                                   highlight_t & highlight) {
-    
+    search_stage_timer timer(HIGHLIGHT);
+
     spp::sparse_hash_map<const art_leaf*, uint32_t*> leaf_to_indices;
     std::vector<art_leaf *> query_suggestion;
 
@@ -1128,6 +1372,78 @@ void Collection::highlight_result(const field &search_field,
     free_leaf_indices(leaf_to_indices);
 }
 
+void Collection::merge_index_results(std::vector<search_args> & index_search_params, const size_t max_hits,
+                                     std::vector<KV> & result_kvs) {
+    search_stage_timer timer(MERGE);
+
+    // (index_id, position within that index's results)
+    typedef std::pair<size_t, size_t> cursor_t;
+
+    auto cursor_kv = [&index_search_params](const cursor_t & cursor) -> const KV & {
+        return index_search_params[cursor.first].raw_result_kvs[cursor.second];
+    };
+
+    // max-heap: the cursor pointing to the greatest KV is on top
+    auto cursor_less = [&cursor_kv](const cursor_t & a, const cursor_t & b) -> bool {
+        return Topster::is_greater_kv_value(cursor_kv(b), cursor_kv(a));
+    };
+
+    std::vector<cursor_t> heap;
+    heap.reserve(index_search_params.size());
+
+    for(size_t index_id = 0; index_id < index_search_params.size(); index_id++) {
+        if(!index_search_params[index_id].raw_result_kvs.empty()) {
+            heap.emplace_back(index_id, 0);
+        }
+    }
+
+    std::make_heap(heap.begin(), heap.end(), cursor_less);
+    result_kvs.reserve(max_hits);
+
+    while(!heap.empty() && result_kvs.size() < max_hits) {
+        std::pop_heap(heap.begin(), heap.end(), cursor_less);
+        cursor_t & cursor = heap.back();
+        result_kvs.push_back(cursor_kv(cursor));
+
+        cursor.second++;
+
+        if(cursor.second < index_search_params[cursor.first].raw_result_kvs.size()) {
+            std::push_heap(heap.begin(), heap.end(), cursor_less);
+        } else {
+            heap.pop_back();
+        }
+    }
+}
+
+void Collection::merge_facet_counts(std::map<uint64_t, facet_count_t> & src,
+                                    std::map<uint64_t, facet_count_t> & dest) {
+    search_stage_timer timer(MERGE);
+
+    if(dest.empty()) {
+        dest.swap(src);
+        return ;
+    }
+
+    // both maps are ordered on the facet hash, so walk them together and insert new keys with a hint
+    auto dest_it = dest.begin();
+
+    for(auto & facet_kv: src) {
+        while(dest_it != dest.end() && dest_it->first < facet_kv.first) {
+            dest_it++;
+        }
+
+        if(dest_it != dest.end() && dest_it->first == facet_kv.first) {
+            facet_count_t & facet_count = dest_it->second;
+            facet_count.count += facet_kv.second.count;
+            facet_count.doc_id = facet_kv.second.doc_id;
+            facet_count.array_pos = facet_kv.second.array_pos;
+            facet_count.query_token_pos = std::move(facet_kv.second.query_token_pos);
+        } else {
+            dest.emplace_hint(dest_it, facet_kv.first, std::move(facet_kv.second));
+        }
+    }
+}
+
 void Collection::free_leaf_indices(spp::sparse_hash_map<const art_leaf *, uint32_t *>& leaf_to_indices) const {
     for (auto it = leaf_to_indices.begin(); it != leaf_to_indices.end(); it++) {
         delete [] it->second;
@@ -1175,8 +1491,9 @@ void Collection::remove_document(nlohmann::json & document, const uint32_t seq_i
     std::string id = document["id"];
 
     Index* index = indices[seq_id % num_indices];
-    index->remove(seq_id, document);
+    index->remove(seq_id);
     num_documents -= 1;
+    write_generation++;
 
     if(remove_from_store) {
         store->remove(get_doc_id_key(id));
@@ -1217,6 +1534,7 @@ Option<std::string> Collection::remove(const std::string & id, const bool remove
         return Option<std::string>(500, "Error while parsing stored document.");
     }
 
+    write_lock_guard write_lock(lock);
     remove_document(document, seq_id, remove_from_store);
     return Option<std::string>(id);
 }
@@ -1231,7 +1549,9 @@ Option<uint32_t> Collection::add_override(const override_t & override) {
         return Option<uint32_t>(500, "Error while storing the override on disk.");
     }
 
+    write_lock_guard write_lock(lock);
     overrides[override.id] = override;
+    write_generation++;
     return Option<uint32_t>(200);
 }
 
@@ -1241,13 +1561,39 @@ Option<uint32_t> Collection::remove_override(const std::string & id) {
         if(!removed) {
             return Option<uint32_t>(500, "Error while deleting the override from disk.");
         }
+
+        write_lock_guard write_lock(lock);
         overrides.erase(id);
+        write_generation++;
         return Option<uint32_t>(200);
     }
 
     return Option<uint32_t>(404, "Could not find that `id`.");
 }
 
+size_t Collection::compact(const size_t max_ids, const size_t min_ids, const size_t min_percent) {
+    write_lock_guard write_lock(lock);
+    size_t num_compacted = 0;
+
+    // documents are spread evenly across the indices
+    const size_t num_index_documents = num_documents / indices.size();
+
+    for(Index* index: indices) {
+        const size_t num_deleted = index->num_deleted();
+
+        // removed documents still count in the frequencies that tokens are ranked by until they are purged,
+        // so an index in which they make up a large share is compacted without waiting for `min_ids` of them
+        const bool large_share = (min_percent != 0) &&
+                                 (num_deleted * 100 >= (num_index_documents + num_deleted) * min_percent);
+
+        if(num_deleted != 0 && (num_deleted >= min_ids || large_share)) {
+            num_compacted += index->compact(max_ids);
+        }
+    }
+
+    return num_compacted;
+}
+
 size_t Collection::get_num_indices() {
     return num_indices;
 }
@@ -1282,7 +1628,7 @@ uint64_t Collection::get_created_at() {
 }
 
 size_t Collection::get_num_documents() {
-    return num_documents;
+    return num_documents.load();
 }
 
 uint32_t Collection::get_collection_id() {
@@ -1347,6 +1693,8 @@ std::string Collection::get_default_sorting_field() {
 }
 
 Option<bool> Collection::get_document_from_store(const std::string &seq_id_key, nlohmann::json & document) {
+    search_stage_timer timer(HYDRATE);
+
     std::string json_doc_str;
     StoreStatus json_doc_status = store->get(seq_id_key, json_doc_str);
 
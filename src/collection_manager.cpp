@@ -4,10 +4,14 @@
 #include "collection_manager.h"
 #include "logger.h"
 
-CollectionManager::CollectionManager() {
+CollectionManager::CollectionManager(): search_pool(nullptr) {
 
 }
 
+CollectionManager::~CollectionManager() {
+    delete search_pool;
+}
+
 Collection* CollectionManager::init_collection(const nlohmann::json & collection_meta,
                                                const uint32_t collection_next_seq_id) {
     std::string this_collection_name = collection_meta[COLLECTION_NAME_KEY].get<std::string>();
@@ -23,8 +27,13 @@ Collection* CollectionManager::init_collection(const nlohmann::json & collection
             field_obj[fields::optional] = false;
         }
 
+        // and before positions could be dropped: non-string fields do not store the property at all
+        if(field_obj.count(fields::positions) == 0) {
+            field_obj[fields::positions] = true;
+        }
+
         fields.push_back({field_obj[fields::name], field_obj[fields::type],
-                          field_obj[fields::facet], field_obj[fields::optional]});
+                          field_obj[fields::facet], field_obj[fields::optional], field_obj[fields::positions]});
     }
 
     std::string default_sorting_field = collection_meta[COLLECTION_DEFAULT_SORTING_FIELD_KEY].get<std::string>();
@@ -38,7 +47,9 @@ Collection* CollectionManager::init_collection(const nlohmann::json & collection
                                             store,
                                             fields,
                                             default_sorting_field,
-                                            default_num_indices);
+                                            default_num_indices,
+                                            search_pool,
+                                            &search_cache);
 
     return collection;
 }
@@ -50,11 +61,17 @@ void CollectionManager::add_to_collections(Collection* collection) {
 
 void CollectionManager::init(Store *store,
                              const size_t default_num_indices,
-                             const std::string & auth_key) {
+                             const std::string & auth_key,
+                             const size_t num_search_threads) {
     this->store = store;
     this->bootstrap_auth_key = auth_key;
     this->default_num_indices = default_num_indices;
 
+    // collections keep a pointer to the pool, so it is sized once, by the first init
+    if(search_pool == nullptr) {
+        search_pool = new ThreadPool(num_search_threads);
+    }
+
     auth_manager.init(store);
 }
 
@@ -203,6 +220,7 @@ void CollectionManager::dispose() {
     }
 
     collections.clear();
+    search_cache.clear();
     store->close();
 }
 
@@ -239,6 +257,12 @@ Option<Collection*> CollectionManager::create_collection(const std::string name,
         field_val[fields::type] = field.type;
         field_val[fields::facet] = field.facet;
         field_val[fields::optional] = field.optional;
+
+        // only the tokens of string fields have positions
+        if(field.is_string()) {
+            field_val[fields::positions] = field.positions;
+        }
+
         fields_json.push_back(field_val);
 
         if(field.name == default_sorting_field && !(field.type == field_types::INT32 ||
@@ -270,7 +294,8 @@ Option<Collection*> CollectionManager::create_collection(const std::string name,
     collection_meta[COLLECTION_CREATED] = created_at;
 
     Collection* new_collection = new Collection(name, next_collection_id, created_at, 0, store, fields,
-                                                default_sorting_field, this->default_num_indices);
+                                                default_sorting_field, this->default_num_indices, search_pool,
+                                                &search_cache);
     next_collection_id++;
 
     rocksdb::WriteBatch batch;
@@ -412,3 +437,7 @@ Store* CollectionManager::get_store() {
 AuthManager& CollectionManager::getAuthManager() {
     return auth_manager;
 }
+
+SearchCache& CollectionManager::get_search_cache() {
+    return search_cache;
+}
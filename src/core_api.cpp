@@ -7,6 +7,7 @@
 #include "collection.h"
 #include "collection_manager.h"
 #include "system_metrics.h"
+#include "parallel_for.h"
 #include "logger.h"
 
 bool handle_authentication(http_req& req, const route_path& rpath, const std::string& auth_key) {
@@ -23,6 +24,11 @@ bool handle_authentication(http_req& req, const route_path& rpath, const std::st
         return true;
     }
 
+    if(rpath.handler == post_multi_search) {
+        // all searches of the batch run against the `collection` query parameter, so one check covers them
+        return collectionManager.auth_key_matches(auth_key, "documents:search", collection, req.params);
+    }
+
     return collectionManager.auth_key_matches(auth_key, rpath.action, collection, req.params);
 }
 
@@ -117,8 +123,26 @@ bool post_create_collection(http_req & req, http_res & res) {
             field_json["optional"] = false;
         }
 
+        if(field_json.count(fields::positions) != 0 && !field_json.at(fields::positions).is_boolean()) {
+            res.set_400(std::string("The `positions` property of the field `") +
+                        field_json.at(fields::name).get<std::string>() + "` should be a boolean.");
+            return false;
+        }
+
+        if(field_json.count(fields::positions) != 0 &&
+           !field(field_json[fields::name], field_json[fields::type], false).is_string()) {
+            res.set_400(std::string("The `positions` property of the field `") +
+                        field_json.at(fields::name).get<std::string>() + "` applies only to string fields.");
+            return false;
+        }
+
+        if(field_json.count(fields::positions) == 0) {
+            field_json[fields::positions] = true;
+        }
+
         fields.emplace_back(
-            field(field_json["name"], field_json["type"], field_json["facet"], field_json["optional"])
+            field(field_json["name"], field_json["type"], field_json["facet"], field_json["optional"],
+                  field_json[fields::positions])
         );
     }
 
@@ -192,11 +216,26 @@ bool get_metrics_json(http_req &req, http_res &res) {
     SystemMetrics sys_metrics;
     sys_metrics.get(data_dir_path, result);
 
+    SearchCache & search_cache = collectionManager.get_search_cache();
+    result["search_cache_hits"] = search_cache.get_hits();
+    result["search_cache_misses"] = search_cache.get_misses();
+    result["search_cache_used_bytes"] = search_cache.get_num_bytes();
+
+    result["search_stage_latency_us"] = search_stage_histograms::get_instance().to_json();
+
+    // only the arena counters are read here: the walk of every tree is left to the summary of each collection
+    nlohmann::json collection_memory = nlohmann::json::object();
+    for(Collection* collection: collectionManager.get_collections()) {
+        collection_memory[collection->get_name()] = collection->get_arena_memory_json();
+    }
+
+    result["collection_memory"] = collection_memory;
+
     res.set_body(200, result.dump(2));
     return true;
 }
 
-bool get_search(http_req & req, http_res & res) {
+static bool search_collection(http_req & req, http_res & res, filter_result_cache_t* filter_cache) {
     auto begin = std::chrono::high_resolution_clock::now();
 
     const char *NUM_TYPOS = "num_typos";
@@ -228,6 +267,12 @@ bool get_search(http_req & req, http_res & res) {
     // list of fields which will be highlighted fully without snippeting
     const char *HIGHLIGHT_FULL_FIELDS = "highlight_full_fields";
 
+    // stop searching after this many milliseconds and return the results found so far (0 means no limit)
+    const char *SEARCH_CUTOFF_MS = "search_cutoff_ms";
+
+    // when "true", the response includes the time spent in each stage of the search
+    const char *DEBUG = "debug";
+
     if(req.params.count(NUM_TYPOS) == 0) {
         req.params[NUM_TYPOS] = "2";
     }
@@ -270,6 +315,10 @@ bool get_search(http_req & req, http_res & res) {
         req.params[HIGHLIGHT_FULL_FIELDS] = "";
     }
 
+    if(req.params.count(SEARCH_CUTOFF_MS) == 0) {
+        req.params[SEARCH_CUTOFF_MS] = "0";
+    }
+
     if(req.params.count(PER_PAGE) == 0) {
         if(req.params[FACET_QUERY].empty()) {
             req.params[PER_PAGE] = "10";
@@ -326,6 +375,11 @@ bool get_search(http_req & req, http_res & res) {
         return false;
     }
 
+    if(!StringUtils::is_uint64_t(req.params[SEARCH_CUTOFF_MS])) {
+        res.set_400("Parameter `" + std::string(SEARCH_CUTOFF_MS) + "` must be an unsigned integer.");
+        return false;
+    }
+
     std::string filter_str = req.params.count(FILTER) != 0 ? req.params[FILTER] : "";
 
     std::vector<std::string> search_fields;
@@ -420,6 +474,8 @@ bool get_search(http_req & req, http_res & res) {
     StringUtils::toupper(req.params[RANK_TOKENS_BY]);
     token_ordering token_order = (req.params[RANK_TOKENS_BY] == "DEFAULT_SORTING_FIELD") ? MAX_SCORE : FREQUENCY;
 
+    search_stage_times_t stage_times;
+
     Option<nlohmann::json> result_op = collection->search(req.params[QUERY], search_fields, filter_str, facet_fields,
                                                           sort_fields, std::stoi(req.params[NUM_TYPOS]),
                                                           static_cast<size_t>(std::stoi(req.params[PER_PAGE])),
@@ -432,7 +488,10 @@ bool get_search(http_req & req, http_res & res) {
                                                           req.params[HIGHLIGHT_FULL_FIELDS],
                                                           typo_tokens_threshold,
                                                           pinned_hits,
-                                                          hidden_hits
+                                                          hidden_hits,
+                                                          static_cast<size_t>(std::stoul(req.params[SEARCH_CUTOFF_MS])),
+                                                          filter_cache,
+                                                          &stage_times
                                                           );
 
     uint64_t timeMillis = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -449,6 +508,15 @@ bool get_search(http_req & req, http_res & res) {
     nlohmann::json result = result_op.get();
     result["search_time_ms"] = timeMillis;
     result["page"] = std::stoi(req.params[PAGE]);
+
+    if(req.params.count(DEBUG) != 0 && req.params[DEBUG] == "true") {
+        if(stage_times.from_cache) {
+            result["from_cache"] = true;
+        } else {
+            result["stage_times_us"] = stage_times.to_json();
+        }
+    }
+
     const std::string & results_json_str = result.dump();
 
     //struct rusage r_usage;
@@ -465,6 +533,107 @@ bool get_search(http_req & req, http_res & res) {
     return true;
 }
 
+bool get_search(http_req & req, http_res & res) {
+    return search_collection(req, res, nullptr);
+}
+
+bool post_multi_search(http_req & req, http_res & res) {
+    const size_t MULTI_SEARCH_MAX_SEARCHES = 50;
+
+    if(req.params.count("collection") == 0) {
+        res.set_400("Parameter `collection` is required.");
+        return false;
+    }
+
+    nlohmann::json req_json;
+
+    try {
+        req_json = nlohmann::json::parse(req.body);
+    } catch(const std::exception& e) {
+        res.set_400("Bad JSON.");
+        return false;
+    }
+
+    if(!req_json.is_object() || req_json.count("searches") == 0 || !req_json["searches"].is_array()) {
+        res.set_400("Parameter `searches` must be an array of search objects.");
+        return false;
+    }
+
+    const nlohmann::json & searches = req_json["searches"];
+
+    if(searches.size() > MULTI_SEARCH_MAX_SEARCHES) {
+        res.set_400("Only upto " + std::to_string(MULTI_SEARCH_MAX_SEARCHES) + " searches can be sent in a request.");
+        return false;
+    }
+
+    std::vector<http_req> search_reqs(searches.size());
+    std::vector<http_res> search_ress(searches.size());
+
+    for(size_t i = 0; i < searches.size(); i++) {
+        if(!searches[i].is_object()) {
+            res.set_400("Parameter `searches` must be an array of search objects.");
+            return false;
+        }
+
+        std::map<std::string, std::string> & params = search_reqs[i].params;
+
+        for(auto it = searches[i].begin(); it != searches[i].end(); ++it) {
+            params[it.key()] = it.value().is_string() ? it.value().get<std::string>() : it.value().dump();
+        }
+
+        // query string parameters, including those embedded in a scoped API key, apply to every search:
+        // filters are combined, while other values take precedence over those of the search
+        for(const auto & kv: req.params) {
+            if(kv.first == "filter_by" && params.count(kv.first) != 0 && !params[kv.first].empty()) {
+                params[kv.first] = params[kv.first] + "&&" + kv.second;
+            } else {
+                params[kv.first] = kv.second;
+            }
+        }
+
+        params.erase("callback");
+    }
+
+    // searches with identical filters against the same collection share the filtered ids
+    filter_result_cache_t filter_cache;
+
+    // the searches are shared with idle threads of the worker pool, and the rest are run on this worker: the
+    // worker lock taken for this request covers the other threads too, since it is held until they are all done
+    parallel_for(server->get_search_thread_pool(), searches.size(),
+                 [&search_reqs, &search_ress, &filter_cache](size_t i) {
+        search_collection(search_reqs[i], search_ress[i], &filter_cache);
+    });
+
+    std::string response = "{\"results\": [";
+
+    for(size_t i = 0; i < searches.size(); i++) {
+        const http_res & search_res = search_ress[i];
+
+        if(i != 0) {
+            response += ",";
+        }
+
+        if(search_res.status_code == 200) {
+            response += search_res.body;
+        } else {
+            nlohmann::json error;
+
+            try {
+                error = nlohmann::json::parse(search_res.body);
+            } catch(const std::exception& e) {
+                error["message"] = search_res.body;
+            }
+
+            error["code"] = search_res.status_code;
+            response += error.dump();
+        }
+    }
+
+    response += "]}";
+    res.set_200(response);
+    return true;
+}
+
 bool get_collection_summary(http_req & req, http_res & res) {
     CollectionManager & collectionManager = CollectionManager::get_instance();
     Collection* collection = collectionManager.get_collection(req.params["collection"]);
@@ -475,23 +644,23 @@ bool get_collection_summary(http_req & req, http_res & res) {
     }
 
     nlohmann::json json_response = collection->get_summary_json();
+    json_response["memory"] = collection->get_memory_json();
     res.set_200(json_response.dump());
 
     return true;
 }
 
-bool collection_export_handler(http_req* req, http_res* res, void* data) {
-    CollectionManager & collectionManager = CollectionManager::get_instance();
-    Collection* collection = collectionManager.get_collection(req->params["collection"]);
+struct export_state_t {
+    rocksdb::Iterator* it;
+    std::string seq_id_prefix;
+};
 
-    if(!collection) {
-        res->set_404();
-        return false;
-    }
-
-    const std::string seq_id_prefix = collection->get_seq_id_collection_prefix();
-
-    rocksdb::Iterator* it = reinterpret_cast<rocksdb::Iterator*>(data);
+bool collection_export_handler(http_req* req, http_res* res, void* data) {
+    // runs on the http thread for every chunk: the collection itself is never touched here, so that a concurrent
+    // drop on the write path cannot pull it out from under an export
+    export_state_t* export_state = reinterpret_cast<export_state_t*>(data);
+    rocksdb::Iterator* it = export_state->it;
+    const std::string & seq_id_prefix = export_state->seq_id_prefix;
 
     if(it->Valid() && it->key().ToString().compare(0, seq_id_prefix.size(), seq_id_prefix) == 0) {
         res->body = it->value().ToString();
@@ -506,6 +675,7 @@ bool collection_export_handler(http_req* req, http_res* res, void* data) {
         res->body = "";
         res->final = true;
         delete it;
+        delete export_state;
     }
 
     return true;
@@ -521,14 +691,16 @@ bool get_export_documents(http_req & req, http_res & res) {
         return false;
     }
 
-    const std::string seq_id_prefix = collection->get_seq_id_collection_prefix();
-
-    rocksdb::Iterator* it = collectionManager.get_store()->get_iterator();
-    it->Seek(seq_id_prefix);
+    export_state_t* export_state = new export_state_t{collectionManager.get_store()->get_iterator(),
+                                                      collection->get_seq_id_collection_prefix()};
+    export_state->it->Seek(export_state->seq_id_prefix);
 
     res.content_type_header = "application/octet-stream";
     res.status_code = 200;
-    stream_response(collection_export_handler, req, res, (void *) it);
+
+    // the response is streamed from the http thread since h2o is not thread safe
+    server->send_message(STREAM_RESPONSE_MSG,
+                         new stream_request_response{collection_export_handler, &req, &res, export_state});
     return true;
 }
 
@@ -936,7 +1108,24 @@ bool del_key(http_req &req, http_res &res) {
 }
 
 bool async_write_request(void *data) {
-    //LOG(INFO) << "async_write_request called";
+    // runs on the http thread: responds to a write that was not applied by this node (e.g. forwarded to leader)
+    AsyncIndexArg* index_arg = static_cast<AsyncIndexArg*>(data);
+    std::unique_ptr<AsyncIndexArg> index_arg_guard(index_arg);
+
+    if(index_arg->req->route_hash == static_cast<uint64_t>(ROUTE_CODES::NOT_FOUND)) {
+        // route not found
+        index_arg->res->set_400("Not found.");
+    }
+
+    if(index_arg->req->_req != nullptr) {
+        server->send_response(index_arg->req, index_arg->res);
+    }
+
+    return true;
+}
+
+bool apply_write_request(void *data) {
+    // runs on the raft state machine thread, so that waiting for the locks below never stalls the event loop
     AsyncIndexArg* index_arg = static_cast<AsyncIndexArg*>(data);
     std::unique_ptr<AsyncIndexArg> index_arg_guard(index_arg);
 
@@ -945,12 +1134,20 @@ bool async_write_request(void *data) {
     if(index_arg->req->route_hash == static_cast<uint64_t>(ROUTE_CODES::NOT_FOUND)) {
         // route not found
         index_arg->res->set_400("Not found.");
-    } else if(index_arg->req->route_hash != static_cast<uint64_t>(ROUTE_CODES::ALREADY_HANDLED)) {
+    } else {
         // call the underlying http handler
         route_path* found_rpath = nullptr;
         bool route_found = server->get_route(index_arg->req->route_hash, &found_rpath);
         if(route_found) {
-            found_rpath->handler(*index_arg->req, *index_arg->res);
+            // searches running on worker threads must not observe a partially applied write: a write to the
+            // documents of a collection locks that collection itself, while other writes hold off every search
+            if(found_rpath->collection_write) {
+                found_rpath->handler(*index_arg->req, *index_arg->res);
+            } else {
+                write_lock_guard lock(server->get_worker_lock());
+                found_rpath->handler(*index_arg->req, *index_arg->res);
+            }
+
             async_call = found_rpath->async;
         } else {
             index_arg->res->set_404();
@@ -958,12 +1155,8 @@ bool async_write_request(void *data) {
     }
 
     if(!async_call && index_arg->req->_req != nullptr) {
-        // we have to return a response to the client
-        server->send_response(index_arg->req, index_arg->res);
-    }
-
-    if(index_arg->promise != nullptr) {
-        index_arg->promise->set_value(true);  // returns control back to caller
+        // we have to return a response to the client: h2o is not thread safe, so it is sent from the http thread
+        server->send_message(SEND_RESPONSE_MSG, new request_response{index_arg->req, index_arg->res});
     }
 
     return true;
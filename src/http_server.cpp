@@ -7,6 +7,7 @@
 #include <h2o.h>
 #include <iostream>
 #include "raft_server.h"
+#include "core_api.h"
 #include "logger.h"
 
 struct h2o_custom_req_handler_t {
@@ -25,6 +26,7 @@ HttpServer::HttpServer(const std::string & version, const std::string & listen_a
     register_handler(hostconf, "/", catch_all_handler);
 
     listener_socket = nullptr; // initialized later
+    search_thread_pool = nullptr;
 
     signal(SIGPIPE, SIG_IGN);
     h2o_context_init(&ctx, h2o_evloop_create(), &config);
@@ -385,12 +387,30 @@ int HttpServer::catch_all_handler(h2o_handler_t *_self, h2o_req_t *req) {
         }
 
         // routes match and is an authenticated request
-        // for writes, we defer to replication_state
-        if(http_method != "GET") {
+        // for writes, we defer to replication_state: worker routes only read (they run under a read lock)
+        if(http_method != "GET" && !rpath->use_worker) {
             self->http_server->get_replication_state()->write(request, response);
             return 0;
         }
 
+        if(rpath->use_worker && self->http_server->search_thread_pool != nullptr) {
+            // run the handler on the search pool so that a slow query does not stall the event loop:
+            // the response is posted back to the http thread since h2o is not thread safe
+            HttpServer* http_server = self->http_server;
+            http_server->search_thread_pool->enqueue([http_server, rpath, request, response]() {
+                {
+                    read_lock_guard lock(http_server->worker_lock);
+                    (rpath->handler)(*request, *response);
+                }
+
+                if(!rpath->async) {
+                    http_server->send_message(SEND_RESPONSE_MSG, new request_response{request, response});
+                }
+            });
+
+            return 0;
+        }
+
         (rpath->handler)(*request, *response);
 
         if(!rpath->async) {
@@ -441,31 +461,47 @@ void HttpServer::set_auth_handler(bool (*handler)(http_req& req, const route_pat
     auth_handler = handler;
 }
 
-void HttpServer::get(const std::string & path, bool (*handler)(http_req &, http_res &), bool async) {
+void HttpServer::set_search_thread_pool(ThreadPool* thread_pool) {
+    search_thread_pool = thread_pool;
+}
+
+ThreadPool* HttpServer::get_search_thread_pool() const {
+    return search_thread_pool;
+}
+
+rw_lock_t& HttpServer::get_worker_lock() {
+    return worker_lock;
+}
+
+void HttpServer::get(const std::string & path, bool (*handler)(http_req &, http_res &), bool async,
+                     bool use_worker) {
     std::vector<std::string> path_parts;
     StringUtils::split(path, path_parts, "/");
-    route_path rpath("GET", path_parts, handler, async);
+    route_path rpath("GET", path_parts, handler, async, use_worker);
     routes.emplace_back(rpath.route_hash(), rpath);
 }
 
-void HttpServer::post(const std::string & path, bool (*handler)(http_req &, http_res &), bool async) {
+void HttpServer::post(const std::string & path, bool (*handler)(http_req &, http_res &), bool async,
+                      bool use_worker, bool collection_write) {
     std::vector<std::string> path_parts;
     StringUtils::split(path, path_parts, "/");
-    route_path rpath("POST", path_parts, handler, async);
+    route_path rpath("POST", path_parts, handler, async, use_worker, collection_write);
     routes.emplace_back(rpath.route_hash(), rpath);
 }
 
-void HttpServer::put(const std::string & path, bool (*handler)(http_req &, http_res &), bool async) {
+void HttpServer::put(const std::string & path, bool (*handler)(http_req &, http_res &), bool async,
+                     bool collection_write) {
     std::vector<std::string> path_parts;
     StringUtils::split(path, path_parts, "/");
-    route_path rpath("PUT", path_parts, handler, async);
+    route_path rpath("PUT", path_parts, handler, async, false, collection_write);
     routes.emplace_back(rpath.route_hash(), rpath);
 }
 
-void HttpServer::del(const std::string & path, bool (*handler)(http_req &, http_res &), bool async) {
+void HttpServer::del(const std::string & path, bool (*handler)(http_req &, http_res &), bool async,
+                     bool collection_write) {
     std::vector<std::string> path_parts;
     StringUtils::split(path, path_parts, "/");
-    route_path rpath("DELETE", path_parts, handler, async);
+    route_path rpath("DELETE", path_parts, handler, async, false, collection_write);
     routes.emplace_back(rpath.route_hash(), rpath);
 }
 
@@ -8,11 +8,16 @@
 #include <match_score.h>
 #include <string_utils.h>
 #include <art.h>
+#include "parallel_for.h"
 #include "logger.h"
 
+thread_local StringUtils Index::string_utils;
+
 Index::Index(const std::string name, const std::unordered_map<std::string, field> & search_schema,
-             std::map<std::string, field> facet_schema, std::unordered_map<std::string, field> sort_schema):
-        name(name), search_schema(search_schema), facet_schema(facet_schema), sort_schema(sort_schema) {
+             std::map<std::string, field> facet_schema, std::unordered_map<std::string, field> sort_schema,
+             ThreadPool* search_pool):
+        name(name), search_schema(search_schema), facet_schema(facet_schema), sort_schema(sort_schema),
+        search_pool(search_pool) {
 
     for(const auto & pair: search_schema) {
         art_tree *t = new art_tree;
@@ -33,10 +38,6 @@ Index::Index(const std::string name, const std::unordered_map<std::string, field
     }
 
     num_documents = 0;
-
-    ready = false;
-    processed = false;
-    terminate = false;
 }
 
 Index::~Index() {
@@ -320,6 +321,10 @@ batch_index_result Index::batch_memory_index(Index *index, std::vector<index_rec
 
     batch_index_result result;
 
+    // postings of the whole batch are added to each leaf in one go at the end
+    posting_builder batch_postings;
+    index->batch_postings = &batch_postings;
+
     for(auto & index_rec: iter_batch) {
         if(index_rec.json_str.empty()) {
             // indicates bad record (upstream validation failure)
@@ -344,61 +349,65 @@ batch_index_result Index::batch_memory_index(Index *index, std::vector<index_rec
         result.success(index_rec);
     }
 
+    index->batch_postings = nullptr;
+    batch_postings.build();
+
     return result;
 }
 
 void Index::insert_doc(const uint32_t score, art_tree *t, uint32_t seq_id,
-                       const std::unordered_map<std::string, std::vector<uint32_t>> &token_to_offsets) const {
+                       const std::unordered_map<std::string, std::vector<uint32_t>> &token_to_offsets,
+                       const bool store_positions) const {
     for(auto & kv: token_to_offsets) {
         art_document art_doc;
         art_doc.id = seq_id;
         art_doc.score = score;
-        art_doc.offsets_len = (uint32_t) kv.second.size();
+        art_doc.offsets_len = store_positions ? (uint32_t) kv.second.size() : 0;
         art_doc.offsets = new uint32_t[kv.second.size()];
 
-        uint32_t num_hits = 0;
-
         const unsigned char *key = (const unsigned char *) kv.first.c_str();
         int key_len = (int) kv.first.length() + 1;  // for the terminating \0 char
 
-        art_leaf* leaf = (art_leaf *) art_search(t, key, key_len);
-        if(leaf != NULL) {
-            num_hits = leaf->values->ids.getLength();
-        }
-
-        num_hits += 1;
-
         for(size_t i=0; i<kv.second.size(); i++) {
             art_doc.offsets[i] = kv.second[i];
         }
 
-        art_insert(t, key, key_len, &art_doc, num_hits);
+        insert_token(t, key, key_len, &art_doc);
         delete [] art_doc.offsets;
         art_doc.offsets = nullptr;
     }
 }
 
-void Index::index_int32_field(const int32_t value, uint32_t score, art_tree *t, uint32_t seq_id) const {
-    const int KEY_LEN = 8;
-    unsigned char key[KEY_LEN];
-
-    encode_int32(value, key);
+void Index::insert_token(art_tree *t, const unsigned char *key, int key_len, art_document *document) const {
+    if(batch_postings != nullptr) {
+        batch_postings->add(t, key, key_len, document);
+        return ;
+    }
 
     uint32_t num_hits = 0;
-    art_leaf* leaf = (art_leaf *) art_search(t, key, KEY_LEN);
+    art_leaf* leaf = (art_leaf *) art_search(t, key, key_len);
     if(leaf != NULL) {
         num_hits = leaf->values->ids.getLength();
     }
 
     num_hits += 1;
 
+    art_insert(t, key, key_len, document, num_hits);
+}
+
+void Index::index_int32_field(const int32_t value, uint32_t score, art_tree *t, uint32_t seq_id) const {
+    const int KEY_LEN = 8;
+    unsigned char key[KEY_LEN];
+
+    encode_int32(value, key);
+
     art_document art_doc;
     art_doc.id = seq_id;
     art_doc.score = score;
     art_doc.offsets_len = 0;
     art_doc.offsets = nullptr;
 
-    art_insert(t, key, KEY_LEN, &art_doc, num_hits);
+    insert_token(t, key, KEY_LEN, &art_doc);
 }
 
 void Index::index_int64_field(const int64_t value, uint32_t score, art_tree *t, uint32_t seq_id) const {
@@ -407,21 +416,13 @@ void Index::index_int64_field(const int64_t value, uint32_t score, art_tree *t,
 
     encode_int64(value, key);
 
-    uint32_t num_hits = 0;
-    art_leaf* leaf = (art_leaf *) art_search(t, key, KEY_LEN);
-    if(leaf != NULL) {
-        num_hits = leaf->values->ids.getLength();
-    }
-
-    num_hits += 1;
-
     art_document art_doc;
     art_doc.id = seq_id;
     art_doc.score = score;
     art_doc.offsets_len = 0;
     art_doc.offsets = nullptr;
 
-    art_insert(t, key, KEY_LEN, &art_doc, num_hits);
+    insert_token(t, key, KEY_LEN, &art_doc);
 }
 
 void Index::index_bool_field(const bool value, const uint32_t score, art_tree *t, uint32_t seq_id) const {
@@ -429,21 +430,13 @@ void Index::index_bool_field(const bool value, const uint32_t score, art_tree *t
     unsigned char key[KEY_LEN];
     key[0] = value ? '1' : '0';
 
-    uint32_t num_hits = 0;
-    art_leaf* leaf = (art_leaf *) art_search(t, key, KEY_LEN);
-    if(leaf != NULL) {
-        num_hits = leaf->values->ids.getLength();
-    }
-
-    num_hits += 1;
-
     art_document art_doc;
     art_doc.id = seq_id;
     art_doc.score = score;
     art_doc.offsets_len = 0;
     art_doc.offsets = nullptr;
 
-    art_insert(t, key, KEY_LEN, &art_doc, num_hits);
+    insert_token(t, key, KEY_LEN, &art_doc);
 }
 
 void Index::index_float_field(const float value, uint32_t score, art_tree *t, uint32_t seq_id) const {
@@ -452,21 +445,13 @@ void Index::index_float_field(const float value, uint32_t score, art_tree *t, ui
 
     encode_float(value, key);
 
-    uint32_t num_hits = 0;
-    art_leaf* leaf = (art_leaf *) art_search(t, key, KEY_LEN);
-    if(leaf != NULL) {
-        num_hits = leaf->values->ids.getLength();
-    }
-
-    num_hits += 1;
-
     art_document art_doc;
     art_doc.id = seq_id;
     art_doc.score = score;
     art_doc.offsets_len = 0;
     art_doc.offsets = nullptr;
 
-    art_insert(t, key, KEY_LEN, &art_doc, num_hits);
+    insert_token(t, key, KEY_LEN, &art_doc);
 }
 
 
@@ -509,7 +494,7 @@ void Index::index_string_field(const std::string & text, const uint32_t score, a
         token_to_offsets[token].push_back(i);
     }
 
-    insert_doc(score, t, seq_id, token_to_offsets);
+    insert_doc(score, t, seq_id, token_to_offsets, a_field.positions);
 
     if(facet_id >= 0) {
         facet_index_v2[seq_id][facet_id].shrink_to_fit();
@@ -565,7 +550,7 @@ void Index::index_string_array_field(const std::vector<std::string> & strings, c
         facet_index_v2[seq_id][facet_id].shrink_to_fit();
     }
 
-    insert_doc(score, t, seq_id, token_positions);
+    insert_doc(score, t, seq_id, token_positions, a_field.positions);
 }
 
 void Index::index_int32_array_field(const std::vector<int32_t> & values, const uint32_t score, art_tree *t,
@@ -632,6 +617,11 @@ void Index::compute_facet_stats(facet &a_facet, int64_t raw_value, const std::st
 
 void Index::do_facets(std::vector<facet> & facets, facet_query_t & facet_query,
                       const uint32_t* result_ids, size_t results_size) {
+    if(facets.empty()) {
+        return ;
+    }
+
+    search_stage_timer timer(FACET);
 
     std::map<std::string, size_t> facet_to_index;
 
@@ -694,6 +684,10 @@ void Index::do_facets(std::vector<facet> & facets, facet_query_t & facet_query,
         size_t facet_id = facet_to_index[a_facet.field_name];
 
         for(size_t i = 0; i < results_size; i++) {
+            if(search_cutoff::exceeded_sampled()) {
+                break;
+            }
+
             uint32_t doc_seq_id = result_ids[i];
 
             if(facet_index_v2.count(doc_seq_id) != 0) {
@@ -831,7 +825,7 @@ void Index::search_candidates(const uint8_t & field_id, uint32_t* filter_ids, si
                               const std::vector<sort_by> & sort_fields,
                               std::vector<token_candidates> & token_candidates_vec, const token_ordering token_order,
                               std::vector<std::vector<art_leaf*>> & searched_queries, Topster & topster,
-                              uint32_t** all_result_ids, size_t & all_result_ids_len,
+                              ids_bitmap & all_result_ids,
                               const size_t typo_tokens_threshold) {
     const long long combination_limit = 10;
 
@@ -839,6 +833,10 @@ void Index::search_candidates(const uint8_t & field_id, uint32_t* filter_ids, si
     long long int N = std::accumulate(token_candidates_vec.begin(), token_candidates_vec.end(), 1LL, product);
 
     for(long long n=0; n<N && n<combination_limit; ++n) {
+        if(search_cutoff::exceeded()) {
+            break;
+        }
+
         // every element in `query_suggestion` contains a token and its associated hits
         std::vector<art_leaf *> query_suggestion = next_suggestion(token_candidates_vec, n);
 
@@ -846,27 +844,37 @@ void Index::search_candidates(const uint8_t & field_id, uint32_t* filter_ids, si
             LOG(INFO) << "i: " << i << " - " << query_suggestion[i]->key;
         }*/
 
+        // intersect from the rarest token onwards, so that the running result stays as small as possible
+        std::vector<art_leaf *> leaves_by_length = query_suggestion;
+        std::sort(leaves_by_length.begin(), leaves_by_length.end(), [](const art_leaf* a, const art_leaf* b) {
+            return a->values->ids.getLength() < b->values->ids.getLength();
+        });
+
         // initialize results with the starting element (for further intersection)
-        size_t result_size = query_suggestion[0]->values->ids.getLength();
+        size_t result_size = leaves_by_length[0]->values->ids.getLength();
         if(result_size == 0) {
             continue;
         }
 
         uint32_t total_cost = 0;
-        uint32_t* result_ids = query_suggestion[0]->values->ids.uncompress();
+        uint32_t* result_ids = leaves_by_length[0]->values->ids.uncompress();
 
         for(const auto& tc: token_candidates_vec) {
             total_cost += tc.cost;
         }
 
         // intersect the document ids for each token to find docs that contain all the tokens (stored in `result_ids`)
-        for(size_t i=1; i < query_suggestion.size(); i++) {
-            uint32_t* out = nullptr;
-            uint32_t* ids = query_suggestion[i]->values->ids.uncompress();
-            result_size = ArrayUtils::and_scalar(ids, query_suggestion[i]->values->ids.getLength(), result_ids, result_size, &out);
-            delete[] ids;
-            delete[] result_ids;
-            result_ids = out;
+        {
+            search_stage_timer timer(INTERSECT);
+
+            for(size_t i=1; i < leaves_by_length.size() && result_size != 0; i++) {
+                result_size = leaves_by_length[i]->values->ids.intersect(result_ids, result_size);
+            }
+
+            // filter ids are free of removed documents already
+            if(filter_ids == nullptr && deleted_ids.size() != 0) {
+                result_size = deleted_ids.exclude(result_ids, result_size);
+            }
         }
 
         if(result_size == 0) {
@@ -876,28 +884,24 @@ void Index::search_candidates(const uint8_t & field_id, uint32_t* filter_ids, si
 
         if(filter_ids != nullptr) {
             // intersect once again with filter ids
-            uint32_t* filtered_result_ids = nullptr;
-            size_t filtered_results_size = ArrayUtils::and_scalar(filter_ids, filter_ids_length, result_ids,
-                                                                  result_size, &filtered_result_ids);
+            uint32_t* filtered_result_ids = result_ids;
+            size_t filtered_results_size = 0;
+
+            {
+                search_stage_timer timer(INTERSECT);
+                filtered_results_size = ArrayUtils::and_inplace(filtered_result_ids, result_size,
+                                                                filter_ids, filter_ids_length);
+            }
 
-            uint32_t* new_all_result_ids;
-            all_result_ids_len = ArrayUtils::or_scalar(*all_result_ids, all_result_ids_len, filtered_result_ids,
-                                  filtered_results_size, &new_all_result_ids);
-            delete [] *all_result_ids;
-            *all_result_ids = new_all_result_ids;
+            all_result_ids.add(filtered_result_ids, filtered_results_size);
 
             // go through each matching document id and calculate match score
             score_results(sort_fields, (uint16_t) searched_queries.size(), field_id, total_cost, topster, query_suggestion,
                           filtered_result_ids, filtered_results_size);
 
-            delete[] filtered_result_ids;
             delete[] result_ids;
         } else {
-            uint32_t* new_all_result_ids;
-            all_result_ids_len = ArrayUtils::or_scalar(*all_result_ids, all_result_ids_len, result_ids,
-                                  result_size, &new_all_result_ids);
-            delete [] *all_result_ids;
-            *all_result_ids = new_all_result_ids;
+            all_result_ids.add(result_ids, result_size);
 
             score_results(sort_fields, (uint16_t) searched_queries.size(), field_id, total_cost, topster, query_suggestion,
                           result_ids, result_size);
@@ -906,7 +910,7 @@ void Index::search_candidates(const uint8_t & field_id, uint32_t* filter_ids, si
 
         searched_queries.push_back(query_suggestion);
 
-        if(all_result_ids_len >= typo_tokens_threshold) {
+        if(all_result_ids.size() >= typo_tokens_threshold) {
             break;
         }
     }
@@ -914,39 +918,36 @@ void Index::search_candidates(const uint8_t & field_id, uint32_t* filter_ids, si
 
 size_t Index::union_of_ids(std::vector<std::pair<uint32_t*, size_t>> & result_array_pairs,
                                 uint32_t **results_out) {
-    uint32_t *results = nullptr;
-    size_t results_length = 0;
-
-    uint32_t *prev_results = nullptr;
-    size_t prev_results_length = 0;
+    return ArrayUtils::or_many(result_array_pairs, results_out);
+}
 
-    for(const std::pair<uint32_t*, size_t> & result_array_pair: result_array_pairs) {
-        results_length = ArrayUtils::or_scalar(prev_results, prev_results_length, result_array_pair.first,
-                                               result_array_pair.second, &results);
-        delete [] prev_results;
-        prev_results = results;
-        prev_results_length = results_length;
+Option<uint32_t> Index::do_filtering(uint32_t** filter_ids_out, const std::vector<filter> & filters) {
+    if(filters.empty()) {
+        *filter_ids_out = nullptr;
+        return Option<>(0);
     }
 
-    *results_out = results;
-    return results_length;
-}
+    search_stage_timer timer(FILTER);
 
-Option<uint32_t> Index::do_filtering(uint32_t** filter_ids_out, const std::vector<filter> & filters) {
     uint32_t* filter_ids = nullptr;
     uint32_t filter_ids_length = 0;
 
+    // while every filter so far has matched a dense leaf, the ids are ANDed word by word in a bitmap
+    ids_bitmap filter_bitmap;
+    bool filter_is_bitmap = false;
+
     for(size_t i = 0; i < filters.size(); i++) {
         const filter & a_filter = filters[i];
 
         if(search_index.count(a_filter.field_name) != 0) {
             art_tree* t = search_index.at(a_filter.field_name);
             field f = search_schema.at(a_filter.field_name);
+
+            // leaves matching the filter, and the ids matching multi-token string values
+            std::vector<const art_leaf*> leaves;
             std::vector<std::pair<uint32_t*, size_t>> filter_result_array_pairs;
 
             if(f.is_integer()) {
-                std::vector<const art_leaf*> leaves;
-
                 for(const std::string & filter_value: a_filter.values) {
                     if(f.type == field_types::INT32 || f.type == field_types::INT32_ARRAY) {
                         int32_t value = (int32_t) std::stoi(filter_value);
@@ -955,32 +956,18 @@ Option<uint32_t> Index::do_filtering(uint32_t** filter_ids_out, const std::vecto
                         int64_t value = (int64_t) std::stol(filter_value);
                         art_int64_search(t, value, a_filter.compare_operator, leaves);
                     }
-
-                    for(const art_leaf* leaf: leaves) {
-                        filter_result_array_pairs.push_back(std::make_pair(leaf->values->ids.uncompress(),
-                                                                leaf->values->ids.getLength()));
-                    }
                 }
             } else if(f.is_float()) {
-                std::vector<const art_leaf*> leaves;
-
                 for(const std::string & filter_value: a_filter.values) {
                     float value = (float) std::atof(filter_value.c_str());
                     art_float_search(t, value, a_filter.compare_operator, leaves);
-                    for(const art_leaf* leaf: leaves) {
-                        filter_result_array_pairs.push_back(std::make_pair(leaf->values->ids.uncompress(),
-                                                                leaf->values->ids.getLength()));
-                    }
                 }
             } else if(f.is_bool()) {
-                std::vector<const art_leaf*> leaves;
-
                 for(const std::string & filter_value: a_filter.values) {
                     art_leaf* leaf = (art_leaf *) art_search(t, (const unsigned char*) filter_value.c_str(),
                                                              filter_value.length());
                     if(leaf) {
-                        filter_result_array_pairs.push_back(std::make_pair(leaf->values->ids.uncompress(),
-                                                                           leaf->values->ids.getLength()));
+                        leaves.push_back(leaf);
                     }
                 }
             } else if(f.is_string()) {
@@ -988,6 +975,17 @@ Option<uint32_t> Index::do_filtering(uint32_t** filter_ids_out, const std::vecto
                     std::vector<std::string> str_tokens;
                     StringUtils::split(filter_value, str_tokens, " ");
 
+                    if(str_tokens.size() == 1) {
+                        string_utils.unicode_normalize(str_tokens[0]);
+                        art_leaf* leaf = (art_leaf *) art_search(t, (const unsigned char*) str_tokens[0].c_str(),
+                                                                 str_tokens[0].length()+1);
+                        if(leaf) {
+                            leaves.push_back(leaf);
+                        }
+
+                        continue;
+                    }
+
                     uint32_t* filtered_ids = nullptr;
                     size_t filtered_size = 0;
 
@@ -1006,13 +1004,7 @@ Option<uint32_t> Index::do_filtering(uint32_t** filter_ids_out, const std::vecto
                             filtered_size = leaf->values->ids.getLength();
                         } else {
                             // do AND for an exact match
-                            uint32_t* out = nullptr;
-                            uint32_t* leaf_ids = leaf->values->ids.uncompress();
-                            filtered_size = ArrayUtils::and_scalar(filtered_ids, filtered_size, leaf_ids,
-                                                                   leaf->values->ids.getLength(), &out);
-                            delete[] leaf_ids;
-                            delete[] filtered_ids;
-                            filtered_ids = out;
+                            filtered_size = leaf->values->ids.intersect(filtered_ids, filtered_size);
                         }
                     }
 
@@ -1020,19 +1012,61 @@ Option<uint32_t> Index::do_filtering(uint32_t** filter_ids_out, const std::vecto
                 }
             }
 
+            // dense leaves are ORed into a bitmap word by word, and then the rest of the ids are added to it
+            ids_bitmap result_bitmap;
+            bool result_is_bitmap = false;
+
+            for(const art_leaf* leaf: leaves) {
+                if(leaf->values->ids.is_dense()) {
+                    leaf->values->ids.add_to(result_bitmap);
+                    result_is_bitmap = true;
+                }
+            }
+
+            for(const art_leaf* leaf: leaves) {
+                if(leaf->values->ids.is_dense()) {
+                    continue;
+                }
+
+                if(result_is_bitmap) {
+                    leaf->values->ids.add_to(result_bitmap);
+                } else {
+                    filter_result_array_pairs.push_back(std::make_pair(leaf->values->ids.uncompress(),
+                                                                       leaf->values->ids.getLength()));
+                }
+            }
+
             uint32_t* result_ids = nullptr;
-            size_t result_ids_length = union_of_ids(filter_result_array_pairs, &result_ids);
+            size_t result_ids_length = 0;
+
+            if(result_is_bitmap) {
+                for(const std::pair<uint32_t*, size_t> & filter_result_array_pair: filter_result_array_pairs) {
+                    result_bitmap.add(filter_result_array_pair.first, filter_result_array_pair.second);
+                }
+            } else {
+                result_ids_length = union_of_ids(filter_result_array_pairs, &result_ids);
+            }
 
             if(i == 0) {
+                if(result_is_bitmap) {
+                    filter_bitmap = std::move(result_bitmap);
+                    filter_is_bitmap = true;
+                } else {
+                    filter_ids = result_ids;
+                    filter_ids_length = result_ids_length;
+                }
+            } else if(filter_is_bitmap && result_is_bitmap) {
+                filter_bitmap.intersect(result_bitmap);
+            } else if(filter_is_bitmap) {
+                filter_ids_length = filter_bitmap.intersect(result_ids, result_ids_length);
                 filter_ids = result_ids;
-                filter_ids_length = result_ids_length;
+                filter_is_bitmap = false;
+            } else if(result_is_bitmap) {
+                filter_ids_length = result_bitmap.intersect(filter_ids, filter_ids_length);
             } else {
-                uint32_t* filtered_results = nullptr;
-                filter_ids_length = ArrayUtils::and_scalar(filter_ids, filter_ids_length, result_ids,
-                                                             result_ids_length, &filtered_results);
+                filter_ids_length = ArrayUtils::and_inplace(filter_ids, filter_ids_length, result_ids,
+                                                            result_ids_length);
                 delete [] result_ids;
-                delete [] filter_ids;
-                filter_ids = filtered_results;
             }
 
             for(std::pair<uint32_t*, size_t> & filter_result_array_pair: filter_result_array_pairs) {
@@ -1041,37 +1075,34 @@ Option<uint32_t> Index::do_filtering(uint32_t** filter_ids_out, const std::vecto
         }
     }
 
+    // removed documents are still in the leaves until compaction
+    if(filter_is_bitmap) {
+        filter_bitmap.subtract(deleted_ids);
+        filter_ids_length = filter_bitmap.to_array(&filter_ids);
+    } else if(deleted_ids.size() != 0) {
+        filter_ids_length = deleted_ids.exclude(filter_ids, filter_ids_length);
+    }
+
     *filter_ids_out = filter_ids;
     return Option<>(filter_ids_length);
 }
 
-void Index::run_search() {
-    while(true) {
-        // wait until main thread sends data
-        std::unique_lock<std::mutex> lk(m);
-        cv.wait(lk, [this]{return ready;});
-
-        if(terminate) {
-            break;
-        }
-
-        // after the wait, we own the lock.
-        search(search_params.outcome, search_params.query, search_params.search_fields,
-               search_params.filters, search_params.facets, search_params.facet_query, search_params.included_ids,
-               search_params.excluded_ids, search_params.sort_fields_std, search_params.num_typos,
-               search_params.max_hits, search_params.per_page, search_params.page, search_params.token_order,
-               search_params.prefix, search_params.drop_tokens_threshold, search_params.raw_result_kvs,
-               search_params.all_result_ids_len, search_params.searched_queries, search_params.override_result_kvs,
-               search_params.typo_tokens_threshold);
-
-        // hand control back to main thread
-        processed = true;
-        ready = false;
-
-        // manual unlocking is done before notifying, to avoid waking up the waiting thread only to block again
-        lk.unlock();
-        cv.notify_one();
-    }
+void Index::run_search(search_args* search_params) {
+    search_cutoff::arm(search_params->search_stop_us);
+    search_stage_timer::reset();
+
+    // all query state lives in `search_params`, so any number of these can run against the index at once
+    search(search_params->outcome, search_params->query, search_params->search_fields,
+           search_params->filters, search_params->facets, search_params->facet_query, search_params->included_ids,
+           search_params->excluded_ids, search_params->sort_fields_std, search_params->num_typos,
+           search_params->max_hits, search_params->per_page, search_params->page, search_params->token_order,
+           search_params->prefix, search_params->drop_tokens_threshold, search_params->raw_result_kvs,
+           search_params->all_result_ids_len, search_params->searched_queries, search_params->override_result_kvs,
+           search_params->typo_tokens_threshold, search_params->filter_query, search_params->filter_cache,
+           search_params->write_generation);
+
+    search_params->search_cutoff = search_cutoff::is_cutoff();
+    search_params->stage_times = search_stage_timer::get_times();
 }
 
 void Index::collate_curated_ids(const std::string & query, const std::string & field, const uint8_t field_id,
@@ -1156,14 +1187,28 @@ void Index::search(Option<uint32_t> & outcome,
                    size_t & all_result_ids_len,
                    std::vector<std::vector<art_leaf*>> & searched_queries,
                    std::vector<KV> & override_result_kvs,
-                   const size_t typo_tokens_threshold) {
+                   const size_t typo_tokens_threshold,
+                   const std::string & filter_query,
+                   filter_result_cache_t* filter_cache,
+                   const uint64_t write_generation) {
 
     const size_t num_results = (page * per_page);
 
     // process the filters
 
     uint32_t* filter_ids = nullptr;
-    Option<uint32_t> op_filter_ids_length = do_filtering(&filter_ids, filters);
+    Option<uint32_t> op_filter_ids_length(0);
+
+    if(filter_cache != nullptr && !filters.empty()) {
+        // identical filters of other searches in the same batch are evaluated only once
+        op_filter_ids_length = filter_cache->get(this, write_generation, filter_query,
+                                                 [this, &filters](uint32_t** ids_out) {
+            return do_filtering(ids_out, filters);
+        }, &filter_ids);
+    } else {
+        op_filter_ids_length = do_filtering(&filter_ids, filters);
+    }
+
     if(!op_filter_ids_length.ok()) {
         outcome = Option<uint32_t>(op_filter_ids_length);
         return ;
@@ -1190,18 +1235,32 @@ void Index::search(Option<uint32_t> & outcome,
         all_result_ids_len = filter_ids_length;
     } else {
         const size_t num_search_fields = std::min(search_fields.size(), (size_t) FIELD_LIMIT_NUM);
-        for(size_t i = 0; i < num_search_fields; i++) {
-            // proceed to query search only when no filters are provided or when filtering produces results
-            if(filters.empty() || filter_ids_length > 0) {
+
+        // proceed to query search only when no filters are provided or when filtering produces results
+        if(filters.empty() || filter_ids_length > 0) {
+            // the leaves each field starts from do not depend on the ids matched so far, so they are looked up
+            // for all the fields at once
+            std::vector<token_leaves_t> field_token_leaves;
+            prefetch_fields_token_leaves(query, search_fields, num_search_fields, num_typos, token_order, prefix,
+                                         field_token_leaves);
+
+            // shared across the fields: ids matched by earlier fields count towards the typo and drop tokens
+            // thresholds of the later ones
+            ids_bitmap result_ids;
+
+            for(size_t i = 0; i < num_search_fields; i++) {
                 const uint8_t field_id = (uint8_t)(FIELD_LIMIT_NUM - i); // Order of `fields` are used to sort results
                 const std::string & field = search_fields[i];
 
                 search_field(field_id, query, field, filter_ids, filter_ids_length, facets, sort_fields_std,
-                             num_typos, searched_queries, topster, &all_result_ids, all_result_ids_len,
+                             num_typos, searched_queries, topster, result_ids, field_token_leaves[i],
                              token_order, prefix, drop_tokens_threshold, typo_tokens_threshold);
                 collate_curated_ids(query, field, field_id, included_ids, curated_topster, searched_queries);
             }
+
+            all_result_ids_len = result_ids.to_array(&all_result_ids);
         }
+
         do_facets(facets, facet_query, all_result_ids, all_result_ids_len);
     }
 
@@ -1260,16 +1319,21 @@ void Index::search_field(const uint8_t & field_id, const std::string & query, co
                          uint32_t *filter_ids, size_t filter_ids_length,
                          std::vector<facet> & facets, const std::vector<sort_by> & sort_fields, const int num_typos,
                          std::vector<std::vector<art_leaf*>> & searched_queries,
-                         Topster & topster, uint32_t** all_result_ids, size_t & all_result_ids_len,
+                         Topster & topster, ids_bitmap & all_result_ids,
+                         const token_leaves_t & prefetched_leaves,
                          const token_ordering token_order, const bool prefix, 
                          const size_t drop_tokens_threshold, const size_t typo_tokens_threshold) {
     std::vector<std::string> tokens;
-    StringUtils::split(query, tokens, " ");
+
+    {
+        search_stage_timer timer(TOKENIZE);
+        StringUtils::split(query, tokens, " ");
+    }
 
     const size_t max_cost = (num_typos < 0 || num_typos > 2) ? 2 : num_typos;
 
     // To prevent us from doing ART search repeatedly as we iterate through possible corrections
-    spp::sparse_hash_map<std::string, std::vector<art_leaf*>> token_cost_cache;
+    token_leaves_t token_cost_cache = prefetched_leaves;
 
     // Used to drop the least occurring token(s) for partial searches
     std::unordered_map<std::string, uint32_t> token_to_count;
@@ -1288,6 +1352,8 @@ void Index::search_field(const uint8_t & field_id, const std::string & query, co
         }
 
         token_to_costs.push_back(all_costs);
+
+        search_stage_timer timer(TOKENIZE);
         string_utils.unicode_normalize(tokens[token_index]);
     }
 
@@ -1300,6 +1366,11 @@ void Index::search_field(const uint8_t & field_id, const std::string & query, co
     long long int N = std::accumulate(token_to_costs.begin(), token_to_costs.end(), 1LL, product);
 
     while(n < N && n < combination_limit) {
+        if(search_cutoff::exceeded()) {
+            // return whatever has been found so far
+            return ;
+        }
+
         // Outerloop generates combinations of [cost to max_cost] for each token
         // For e.g. for a 3-token query: [0, 0, 0], [0, 0, 1], [0, 1, 1] etc.
         std::vector<uint32_t> costs(token_to_costs.size());
@@ -1325,12 +1396,7 @@ void Index::search_field(const uint8_t & field_id, const std::string & query, co
             } else {
                 // prefix should apply only for last token
                 const bool prefix_search = prefix && (token_index == tokens.size()-1);
-                const size_t token_len = prefix_search ? (int) token.length() : (int) token.length() + 1;
-
-                // If this is a prefix search, look for more candidates and do a union of those document IDs
-                const int max_candidates = prefix_search ? 10 : 3;
-                art_fuzzy_search(search_index.at(field), (const unsigned char *) token.c_str(), token_len,
-                                 costs[token_index], costs[token_index], max_candidates, token_order, prefix_search, leaves);
+                search_token_leaves(field, token, costs[token_index], prefix_search, token_order, leaves);
 
                 if(!leaves.empty()) {
                     token_cost_cache.emplace(token_cost_hash, leaves);
@@ -1348,7 +1414,7 @@ void Index::search_field(const uint8_t & field_id, const std::string & query, co
                     token_to_costs[token_index].erase(it);
 
                     // when no more costs are left for this token and `drop_tokens_threshold` is breached
-                    if(token_to_costs[token_index].empty() && all_result_ids_len >= drop_tokens_threshold) {
+                    if(token_to_costs[token_index].empty() && all_result_ids.size() >= drop_tokens_threshold) {
                         n = combination_limit; // to break outer loop
                         break;
                     }
@@ -1374,11 +1440,11 @@ void Index::search_field(const uint8_t & field_id, const std::string & query, co
         if(!token_candidates_vec.empty() && token_candidates_vec.size() == tokens.size()) {
             // If all tokens were found, go ahead and search for candidates with what we have so far
             search_candidates(field_id, filter_ids, filter_ids_length, sort_fields, token_candidates_vec,
-                              token_order, searched_queries, topster, all_result_ids, all_result_ids_len,
+                              token_order, searched_queries, topster, all_result_ids,
                               typo_tokens_threshold);
         }
 
-        if (all_result_ids_len >= typo_tokens_threshold) {
+        if (all_result_ids.size() >= typo_tokens_threshold) {
             // If we don't find enough results, we continue outerloop (looking at tokens with greater typo cost)
             break;
         }
@@ -1387,7 +1453,7 @@ void Index::search_field(const uint8_t & field_id, const std::string & query, co
     }
 
     // When there are not enough overall results and atleast one token has results
-    if(all_result_ids_len < drop_tokens_threshold && token_to_count.size() > 1) {
+    if(all_result_ids.size() < drop_tokens_threshold && token_to_count.size() > 1 && !search_cutoff::exceeded()) {
         // Drop token with least hits and try searching again
         std::string truncated_query;
 
@@ -1408,11 +1474,93 @@ void Index::search_field(const uint8_t & field_id, const std::string & query, co
         }
 
         return search_field(field_id, truncated_query, field, filter_ids, filter_ids_length, facets, sort_fields, num_typos,
-                            searched_queries, topster, all_result_ids, all_result_ids_len,
+                            searched_queries, topster, all_result_ids, token_leaves_t(),
                             token_order, prefix);
     }
 }
 
+void Index::search_token_leaves(const std::string & field, const std::string & token, const int cost,
+                                const bool prefix_search, const token_ordering token_order,
+                                std::vector<art_leaf*> & leaves) const {
+    const size_t token_len = prefix_search ? (int) token.length() : (int) token.length() + 1;
+
+    // If this is a prefix search, look for more candidates and do a union of those document IDs
+    const int max_candidates = prefix_search ? 10 : 3;
+    search_stage_timer timer(FUZZY);
+    art_fuzzy_search(search_index.at(field), (const unsigned char *) token.c_str(), token_len,
+                     cost, cost, max_candidates, token_order, prefix_search, leaves);
+}
+
+void Index::prefetch_token_leaves(const std::string & query, const std::string & field, const int num_typos,
+                                  const token_ordering token_order, const bool prefix,
+                                  token_leaves_t & token_leaves) const {
+    std::vector<std::string> tokens;
+
+    {
+        search_stage_timer timer(TOKENIZE);
+        StringUtils::split(query, tokens, " ");
+    }
+
+    const size_t max_cost = (num_typos < 0 || num_typos > 2) ? 2 : num_typos;
+
+    for(size_t token_index = 0; token_index < tokens.size(); token_index++) {
+        std::string & token = tokens[token_index];
+
+        // bounded on the length before normalization, as in `search_field`
+        const int bounded_cost = get_bounded_typo_cost(max_cost, token.length());
+
+        {
+            search_stage_timer timer(TOKENIZE);
+            string_utils.unicode_normalize(token);
+        }
+
+        const bool prefix_search = prefix && (token_index == tokens.size()-1);
+
+        for(int cost = 0; cost <= bounded_cost; cost++) {
+            const std::string token_cost_hash = token + std::to_string(cost);
+
+            // lookups that find nothing are kept too, so that `search_field` does not repeat them
+            if(token_leaves.count(token_cost_hash) == 0) {
+                search_token_leaves(field, token, cost, prefix_search, token_order, token_leaves[token_cost_hash]);
+            }
+
+            if(!token_leaves[token_cost_hash].empty()) {
+                break;
+            }
+        }
+    }
+}
+
+void Index::prefetch_fields_token_leaves(const std::string & query, const std::vector<std::string> & search_fields,
+                                         const size_t num_search_fields, const int num_typos,
+                                         const token_ordering token_order, const bool prefix,
+                                         std::vector<token_leaves_t> & field_token_leaves) const {
+    field_token_leaves.resize(num_search_fields);
+
+    // fields looked up on other threads must run against the same deadline, and their stage times are added back
+    const std::thread::id search_thread = std::this_thread::get_id();
+    const uint64_t search_stop_us = search_cutoff::get_stop_us();
+    search_stage_times_t pool_stage_times;
+    std::mutex pool_stage_times_mutex;
+
+    parallel_for(search_pool, num_search_fields, [&](size_t i) {
+        if(std::this_thread::get_id() == search_thread) {
+            prefetch_token_leaves(query, search_fields[i], num_typos, token_order, prefix, field_token_leaves[i]);
+            return ;
+        }
+
+        search_cutoff::arm(search_stop_us);
+        search_stage_timer::reset();
+
+        prefetch_token_leaves(query, search_fields[i], num_typos, token_order, prefix, field_token_leaves[i]);
+
+        std::lock_guard<std::mutex> lock(pool_stage_times_mutex);
+        pool_stage_times.add(search_stage_timer::get_times());
+    });
+
+    search_stage_timer::add(pool_stage_times);
+}
+
 int Index::get_bounded_typo_cost(const size_t max_cost, const size_t token_len) const {
     int bounded_cost = max_cost;
     if(token_len > 0 && max_cost >= token_len && (token_len == 1 || token_len == 2)) {
@@ -1437,13 +1585,18 @@ void Index::score_results(const std::vector<sort_by> & sort_fields, const uint16
                           const uint8_t & field_id, const uint32_t total_cost, Topster & topster,
                           const std::vector<art_leaf *> &query_suggestion,
                           const uint32_t *result_ids, const size_t result_size) const {
+    search_stage_timer timer(SCORE);
 
-    spp::sparse_hash_map<const art_leaf*, uint32_t*> leaf_to_indices;
+    // `result_ids` are sorted, so a cursor per token walks forward through the token's ids to find each document
+    std::vector<posting_list::iterator_t> leaf_cursors;
+    std::vector<uint32_t> doc_indices(query_suggestion.size());
 
-    for (art_leaf *token_leaf : query_suggestion) {
-        uint32_t *indices = new uint32_t[result_size];
-        token_leaf->values->ids.indexOf(result_ids, result_size, indices);
-        leaf_to_indices.emplace(token_leaf, indices);
+    if(query_suggestion.size() > 1) {
+        leaf_cursors.reserve(query_suggestion.size());
+
+        for (art_leaf *token_leaf : query_suggestion) {
+            leaf_cursors.push_back(token_leaf->values->ids.new_iterator());
+        }
     }
 
     int sort_order[3]; // 1 or -1 based on DESC or ASC respectively
@@ -1467,43 +1620,13 @@ void Index::score_results(const std::vector<sort_by> & sort_fields, const uint16
     Match single_token_match = Match(1, 0, 0, empty_offset_diffs);
     const uint64_t single_token_match_score = single_token_match.get_match_score(total_cost, field_id);
 
-    for(size_t i=0; i<result_size; i++) {
-        const uint32_t seq_id = result_ids[i];
-
-        uint64_t match_score = 0;
-
-        if(query_suggestion.size() <= 1) {
-            match_score = single_token_match_score;
-        } else {
-            std::vector<std::vector<std::vector<uint16_t>>> array_token_positions;
-            populate_token_positions(query_suggestion, leaf_to_indices, i, array_token_positions);
-
-            for(const std::vector<std::vector<uint16_t>> & token_positions: array_token_positions) {
-                if(token_positions.empty()) {
-                    continue;
-                }
-                const Match & match = Match::match(seq_id, token_positions);
-                uint64_t this_match_score = match.get_match_score(total_cost, field_id);
-
-                if(this_match_score > match_score) {
-                    match_score = this_match_score;
-                }
-
-                /*std::ostringstream os;
-                os << name << ", total_cost: " << (255 - total_cost)
-                   << ", words_present: " << match.words_present
-                   << ", match_score: " << match_score
-                   << ", match.distance: " << match.distance
-                   << ", seq_id: " << seq_id << std::endl;
-                std::cout << os.str();*/
-            }
-        }
+    const size_t num_sort_fields = sort_fields.size();
 
+    auto populate_scores = [&](const uint32_t seq_id, const uint64_t match_score, int64_t* scores) {
         const int64_t default_score = 0;
-        int64_t scores[3];
 
         // avoiding loop
-        if(sort_fields.size() > 0) {
+        if(num_sort_fields > 0) {
             if (field_values[0] != nullptr) {
                 auto it = field_values[0]->find(seq_id);
                 scores[0] = (it == field_values[0]->end()) ? default_score : it->second;
@@ -1516,7 +1639,7 @@ void Index::score_results(const std::vector<sort_by> & sort_fields, const uint16
             scores[1] = 0;
         }
 
-        if(sort_fields.size() > 1) {
+        if(num_sort_fields > 1) {
             if (field_values[1] != nullptr) {
                 auto it = field_values[1]->find(seq_id);
                 scores[1] = (it == field_values[1]->end()) ? default_score : it->second;
@@ -1529,7 +1652,7 @@ void Index::score_results(const std::vector<sort_by> & sort_fields, const uint16
             scores[2] = 0;
         }
 
-        if(sort_fields.size() > 2) {
+        if(num_sort_fields > 2) {
             if(field_values[2] != nullptr) {
                 auto it = field_values[2]->find(seq_id);
                 scores[2] = (it == field_values[2]->end()) ? default_score : it->second;
@@ -1540,23 +1663,110 @@ void Index::score_results(const std::vector<sort_by> & sort_fields, const uint16
                 scores[2] = -scores[2];
             }
         }
+    };
+
+    // Once the topster is full, a document whose best possible scores do not beat the smallest topster entry
+    // would be rejected by the topster anyway, so we can skip computing its token positions. The match score is
+    // bounded by all tokens being present with the best possible distance. Only valid when text match is not
+    // sorted in ascending order.
+    bool can_prune = query_suggestion.size() > 1;
+    for(size_t i = 0; i < num_sort_fields; i++) {
+        if(field_values[i] == nullptr && sort_order[i] == -1) {
+            can_prune = false;
+        }
+    }
+
+    const uint8_t max_words_present = (uint8_t) std::min(query_suggestion.size(), WINDOW_SIZE);
+    const Match best_match = Match(max_words_present, std::numeric_limits<uint8_t>::max(), 0, empty_offset_diffs);
+    const uint64_t match_score_upper_bound = best_match.get_match_score(total_cost, field_id);
+
+    // a field indexed without positions has every token present, with nothing known about their proximity
+    const Match positionless_match = Match(max_words_present, 0, 0, empty_offset_diffs);
+    const uint64_t positionless_match_score = positionless_match.get_match_score(total_cost, field_id);
+
+    for(size_t i=0; i<result_size; i++) {
+        const uint32_t seq_id = result_ids[i];
+
+        int64_t scores[3];
+
+        if(can_prune && topster.size >= topster.MAX_SIZE) {
+            populate_scores(seq_id, match_score_upper_bound, scores);
+            if(!Topster::is_greater(topster.getKV(0), scores)) {
+                continue;
+            }
+        }
+
+        uint64_t match_score = 0;
+
+        if(query_suggestion.size() <= 1) {
+            match_score = single_token_match_score;
+        } else {
+            for(size_t token_index = 0; token_index < leaf_cursors.size(); token_index++) {
+                posting_list::iterator_t & leaf_cursor = leaf_cursors[token_index];
+                leaf_cursor.advance_to(seq_id);
+
+                doc_indices[token_index] = (leaf_cursor.valid() && leaf_cursor.id() == seq_id) ?
+                                           leaf_cursor.index() :
+                                           query_suggestion[token_index]->values->ids.getLength();
+            }
+
+            std::vector<std::vector<std::vector<uint16_t>>> array_token_positions;
+            populate_token_positions(query_suggestion, &doc_indices[0], array_token_positions);
+            bool has_positions = false;
+
+            for(const std::vector<std::vector<uint16_t>> & token_positions: array_token_positions) {
+                if(token_positions.empty()) {
+                    continue;
+                }
+
+                has_positions = true;
+                const Match & match = Match::match(seq_id, token_positions);
+                uint64_t this_match_score = match.get_match_score(total_cost, field_id);
+
+                if(this_match_score > match_score) {
+                    match_score = this_match_score;
+                }
+
+                /*std::ostringstream os;
+                os << name << ", total_cost: " << (255 - total_cost)
+                   << ", words_present: " << match.words_present
+                   << ", match_score: " << match_score
+                   << ", match.distance: " << match.distance
+                   << ", seq_id: " << seq_id << std::endl;
+                std::cout << os.str();*/
+            }
+
+            if(!has_positions) {
+                match_score = positionless_match_score;
+            }
+        }
+
+        populate_scores(seq_id, match_score, scores);
 
         topster.add(seq_id, field_id, query_index, match_score, scores);
     }
 
     //long long int timeNanos = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - begin).count();
     //LOG(INFO) << "Time taken for results iteration: " << timeNanos << "ms";
-
-    for (auto it = leaf_to_indices.begin(); it != leaf_to_indices.end(); it++) {
-        delete [] it->second;
-        it->second = nullptr;
-    }
 }
 
 void Index::populate_token_positions(const std::vector<art_leaf *> &query_suggestion,
                                      spp::sparse_hash_map<const art_leaf *, uint32_t *> &leaf_to_indices,
                                      size_t result_index,
                                      std::vector<std::vector<std::vector<uint16_t>>> &array_token_positions) {
+    std::vector<uint32_t> doc_indices;
+    doc_indices.reserve(query_suggestion.size());
+
+    for (const art_leaf *token_leaf : query_suggestion) {
+        doc_indices.push_back(leaf_to_indices.at(token_leaf)[result_index]);
+    }
+
+    populate_token_positions(query_suggestion, doc_indices.data(), array_token_positions);
+}
+
+void Index::populate_token_positions(const std::vector<art_leaf *> &query_suggestion,
+                                     const uint32_t* doc_indices,
+                                     std::vector<std::vector<std::vector<uint16_t>>> &array_token_positions) {
     if(query_suggestion.empty()) {
         return ;
     }
@@ -1564,32 +1774,34 @@ void Index::populate_token_positions(const std::vector<art_leaf *> &query_sugges
     // array_token_positions:
     // for every element in a potential array, for every token in query suggestion, get the positions
 
+    // decode the positions of the document for every token once
+    std::vector<std::vector<uint32_t>> token_positions(query_suggestion.size());
+
     // first ascertain the size of the array
     size_t array_size = 0;
 
-    for (const art_leaf *token_leaf : query_suggestion) {
+    for(size_t token_index = 0; token_index < query_suggestion.size(); token_index++) {
+        const art_leaf *token_leaf = query_suggestion[token_index];
         size_t this_array_size = 1;
 
-        uint32_t doc_index = leaf_to_indices.at(token_leaf)[result_index];
+        uint32_t doc_index = doc_indices[token_index];
         if(doc_index == token_leaf->values->ids.getLength()) {
             continue;
         }
 
-        uint32_t start_offset = token_leaf->values->offset_index.at(doc_index);
-        uint32_t end_offset = (doc_index == token_leaf->values->ids.getLength() - 1) ?
-                              token_leaf->values->offsets.getLength() :
-                              token_leaf->values->offset_index.at(doc_index+1);
+        std::vector<uint32_t> & positions = token_positions[token_index];
+        token_leaf->values->positions.get(doc_index, positions);
 
-        if(end_offset - start_offset < 3) {
+        if(positions.size() < 3) {
             this_array_size = 1; // can only be a string since array needs atleast 3 positions for storage
         } else {
             // Could be either an array or a string.
             // Array offset storage format:
             // a) last element is array_index b) second and third last elements will be largest offset
 
-            auto last_val = (uint16_t) token_leaf->values->offsets.at(end_offset - 1);
-            auto second_last_val = (uint16_t) token_leaf->values->offsets.at(end_offset - 2);
-            auto third_last_val = (uint16_t) token_leaf->values->offsets.at(end_offset - 3);
+            auto last_val = (uint16_t) positions[positions.size() - 1];
+            auto second_last_val = (uint16_t) positions[positions.size() - 2];
+            auto third_last_val = (uint16_t) positions[positions.size() - 3];
 
             if(second_last_val != third_last_val) {
                 // guarantees that this is a string
@@ -1606,38 +1818,35 @@ void Index::populate_token_positions(const std::vector<art_leaf *> &query_sugges
     array_token_positions = std::vector<std::vector<std::vector<uint16_t>>>(array_size);
 
     // for each token in the query, find the positions that it appears in the array
-    for (const art_leaf *token_leaf : query_suggestion) {
-        uint32_t doc_index = leaf_to_indices.at(token_leaf)[result_index];
+    for(size_t token_index = 0; token_index < query_suggestion.size(); token_index++) {
+        const art_leaf *token_leaf = query_suggestion[token_index];
+        uint32_t doc_index = doc_indices[token_index];
         if(doc_index == token_leaf->values->ids.getLength()) {
             continue;
         }
 
-        populate_array_token_positions(array_token_positions, token_leaf, doc_index);
+        populate_array_token_positions(array_token_positions, token_positions[token_index]);
     }
 }
 
 void Index::populate_array_token_positions(std::vector<std::vector<std::vector<uint16_t>>> & array_token_positions,
-                                           const art_leaf *token_leaf, uint32_t doc_index) {
-    uint32_t start_offset = token_leaf->values->offset_index.at(doc_index);
-    uint32_t end_offset = (doc_index == token_leaf->values->ids.getLength() - 1) ?
-                          token_leaf->values->offsets.getLength() :
-                          token_leaf->values->offset_index.at(doc_index+1);
-
+                                           const std::vector<uint32_t> & doc_positions) {
     std::vector<uint16_t> positions;
     uint16_t prev_pos = -1;
+    size_t offset = 0;
 
-    while(start_offset < end_offset) {
-        auto pos = (uint16_t) token_leaf->values->offsets.at(start_offset);
-        start_offset++;
+    while(offset < doc_positions.size()) {
+        auto pos = (uint16_t) doc_positions[offset];
+        offset++;
 
         if(pos == prev_pos) {  // indicates end of array index
             if(!positions.empty()) {
-                size_t array_index = (uint16_t) token_leaf->values->offsets.at(start_offset);
+                size_t array_index = (uint16_t) doc_positions[offset];
                 array_token_positions[array_index].push_back(positions);
                 positions.clear();
             }
 
-            start_offset++;  // skip current value which is array index
+            offset++;  // skip current value which is array index
             prev_pos = -1;
             continue;
         }
@@ -1672,170 +1881,99 @@ inline std::vector<art_leaf *> Index::next_suggestion(const std::vector<token_ca
     return query_suggestion;
 }
 
-void Index::remove_and_shift_offset_index(sorted_array &offset_index, const uint32_t *indices_sorted,
-                                               const uint32_t indices_length) {
-    uint32_t *curr_array = offset_index.uncompress();
-    uint32_t *new_array = new uint32_t[offset_index.getLength()];
-
-    new_array[0] = 0;
-    uint32_t new_index = 0;
-    uint32_t curr_index = 0;
-    uint32_t indices_counter = 0;
-    uint32_t shift_value = 0;
-
-    while(curr_index < offset_index.getLength()) {
-        if(indices_counter < indices_length && curr_index >= indices_sorted[indices_counter]) {
-            // skip copying
-            if(curr_index == indices_sorted[indices_counter]) {
-                curr_index++;
-                const uint32_t diff = curr_index == offset_index.getLength() ?
-                                0 : (offset_index.at(curr_index) - offset_index.at(curr_index-1));
-
-                shift_value += diff;
-            }
-            indices_counter++;
-        } else {
-            new_array[new_index++] = curr_array[curr_index++] - shift_value;
-        }
-    }
+Option<uint32_t> Index::remove(const uint32_t seq_id) {
+    // the postings and facets of the document stay in place until compaction
+    deleted_ids.add(&seq_id, 1);
 
-    offset_index.load(new_array, new_index);
+    // remove sort index if any
+    for(auto & field_doc_value_map: sort_index) {
+        field_doc_value_map.second->erase(seq_id);
+    }
 
-    delete[] curr_array;
-    delete[] new_array;
+    return Option<uint32_t>(seq_id);
 }
 
-Option<uint32_t> Index::remove(const uint32_t seq_id, nlohmann::json & document) {
-    for(auto & name_field: search_schema) {
-        if(name_field.second.optional && document.count(name_field.first) == 0) {
-            continue;
-        }
-
-        // Go through all the field names and find the keys+values so that they can be removed from in-memory index
-        std::vector<std::string> tokens;
-        if(name_field.second.type == field_types::STRING) {
-            StringUtils::split(document[name_field.first], tokens, " ");
-        } else if(name_field.second.type == field_types::STRING_ARRAY) {
-            std::vector<std::string> values = document[name_field.first].get<std::vector<std::string>>();
-            for(const std::string & value: values) {
-                StringUtils::split(value, tokens, " ");
-            }
-        } else if(name_field.second.type == field_types::INT32) {
-            const int KEY_LEN = 8;
-            unsigned char key[KEY_LEN];
-            int32_t value = document[name_field.first].get<int32_t>();
-            encode_int32(value, key);
-            tokens.push_back(std::string((char*)key, KEY_LEN));
-        } else if(name_field.second.type == field_types::INT32_ARRAY) {
-            std::vector<int32_t> values = document[name_field.first].get<std::vector<int32_t>>();
-            for(const int32_t value: values) {
-                const int KEY_LEN = 8;
-                unsigned char key[KEY_LEN];
-                encode_int32(value, key);
-                tokens.push_back(std::string((char*)key, KEY_LEN));
-            }
-        } else if(name_field.second.type == field_types::INT64) {
-            const int KEY_LEN = 8;
-            unsigned char key[KEY_LEN];
-            int64_t value = document[name_field.first].get<int64_t>();
-            encode_int64(value, key);
-            tokens.push_back(std::string((char*)key, KEY_LEN));
-        } else if(name_field.second.type == field_types::INT64_ARRAY) {
-            std::vector<int64_t> values = document[name_field.first].get<std::vector<int64_t>>();
-            for(const int64_t value: values) {
-                const int KEY_LEN = 8;
-                unsigned char key[KEY_LEN];
-                encode_int64(value, key);
-                tokens.push_back(std::string((char*)key, KEY_LEN));
-            }
-        } else if(name_field.second.type == field_types::FLOAT) {
-            const int KEY_LEN = 8;
-            unsigned char key[KEY_LEN];
-            int64_t value = document[name_field.first].get<int64_t>();
-            encode_float(value, key);
-            tokens.push_back(std::string((char*)key, KEY_LEN));
-        } else if(name_field.second.type == field_types::FLOAT_ARRAY) {
-            std::vector<float> values = document[name_field.first].get<std::vector<float>>();
-            for(const float value: values) {
-                const int KEY_LEN = 8;
-                unsigned char key[KEY_LEN];
-                encode_float(value, key);
-                tokens.push_back(std::string((char*)key, KEY_LEN));
-            }
-        } else if(name_field.second.type == field_types::BOOL) {
-            const int KEY_LEN = 1;
-            unsigned char key[KEY_LEN];
-            bool value = document[name_field.first].get<bool>();
-            key[0] = value ? '1' : '0';
-            tokens.push_back(std::string((char*)key, KEY_LEN));
-        } else if(name_field.second.type == field_types::BOOL_ARRAY) {
-            std::vector<bool> values = document[name_field.first].get<std::vector<bool>>();
-            for(const bool value: values) {
-                const int KEY_LEN = 1;
-                unsigned char key[KEY_LEN];
-                key[0] = value ? '1' : '0';
-                tokens.push_back(std::string((char*)key, KEY_LEN));
+struct compact_leaves_t {
+    const uint32_t* sorted_ids;
+    size_t ids_length;
+    ids_bitmap ids;
+    std::vector<std::string> emptied_keys;
+};
+
+static int compact_leaf(void *data, const unsigned char *key, uint32_t key_len, void *value) {
+    compact_leaves_t* compaction = (compact_leaves_t *) data;
+    art_values* values = (art_values *) value;
+    posting_list & leaf_ids = values->ids;
+
+    // the removed ids within the leaf: scans the shorter of the leaf and the removed ids
+    std::vector<uint32_t> found_ids;
+
+    if(leaf_ids.getLength() < compaction->ids_length) {
+        for(posting_list::iterator_t it = leaf_ids.new_iterator(); it.valid(); it.next()) {
+            if(compaction->ids.contains(it.id())) {
+                found_ids.push_back(it.id());
             }
         }
+    } else {
+        found_ids.assign(compaction->sorted_ids, compaction->sorted_ids + compaction->ids_length);
+        found_ids.resize(leaf_ids.intersect(&found_ids[0], found_ids.size()));
+    }
+
+    if(found_ids.empty()) {
+        return 0;
+    }
 
-        for(auto & token: tokens) {
-            const unsigned char *key;
-            int key_len;
+    std::vector<uint32_t> doc_indices(found_ids.size());
+    leaf_ids.indexOf(&found_ids[0], found_ids.size(), &doc_indices[0]);
 
-            if(name_field.second.type == field_types::STRING_ARRAY || name_field.second.type == field_types::STRING) {
-                string_utils.unicode_normalize(token);
-                key = (const unsigned char *) token.c_str();
-                key_len = (int) (token.length() + 1);
-            } else {
-                key = (const unsigned char *) token.c_str();
-                key_len = (int) (token.length());
-            }
+    values->positions.remove(&doc_indices[0], doc_indices.size());
+    leaf_ids.remove_values(&found_ids[0], found_ids.size());
 
-            art_leaf* leaf = (art_leaf *) art_search(search_index.at(name_field.first), key, key_len);
-            if(leaf != NULL) {
-                uint32_t seq_id_values[1] = {seq_id};
-                uint32_t doc_index = leaf->values->ids.indexOf(seq_id);
+    if(leaf_ids.getLength() == 0) {
+        compaction->emptied_keys.emplace_back((const char *) key, key_len);
+    }
 
-                if(doc_index == leaf->values->ids.getLength()) {
-                    // not found - happens when 2 tokens repeat in a field, e.g "is it or is is not?"
-                    continue;
-                }
+    return 0;
+}
 
-                uint32_t start_offset = leaf->values->offset_index.at(doc_index);
-                uint32_t end_offset = (doc_index == leaf->values->ids.getLength() - 1) ?
-                                      leaf->values->offsets.getLength() :
-                                      leaf->values->offset_index.at(doc_index+1);
+void Index::compact_tree(art_tree *t, const uint32_t* sorted_ids, const size_t ids_length) {
+    compact_leaves_t compaction;
+    compaction.sorted_ids = sorted_ids;
+    compaction.ids_length = ids_length;
+    compaction.ids.add(sorted_ids, ids_length);
 
-                uint32_t doc_indices[1] = {doc_index};
-                remove_and_shift_offset_index(leaf->values->offset_index, doc_indices, 1);
+    art_iter(t, compact_leaf, &compaction);
 
-                leaf->values->offsets.remove_index(start_offset, end_offset);
-                leaf->values->ids.remove_values(seq_id_values, 1);
+    // leaves are deleted only once the iteration is over
+    for(const std::string & key: compaction.emptied_keys) {
+        art_values* values = (art_values*) art_delete(t, (const unsigned char *) key.c_str(), (int) key.size());
+        delete values;
+    }
 
-                /*len = leaf->values->offset_index.getLength();
-                for(auto i=0; i<len; i++) {
-                    LOG(INFO) << "i: " << i << ", val: " << leaf->values->offset_index.at(i);
-                }
-                LOG(INFO) << "----";*/
+    // the leaves that lost documents may no longer be among the best of their prefixes
+    art_topk_refresh(t);
+}
 
-                if(leaf->values->ids.getLength() == 0) {
-                    art_values* values = (art_values*) art_delete(search_index.at(name_field.first), key, key_len);
-                    delete values;
-                    values = nullptr;
-                }
-            }
-        }
+size_t Index::compact(const size_t max_ids) {
+    if(deleted_ids.size() == 0) {
+        return 0;
     }
 
-    // remove facets if any
-    facet_index_v2.erase(seq_id);
+    uint32_t* ids = nullptr;
+    const size_t num_ids = std::min(deleted_ids.to_array(&ids), max_ids);
 
-    // remove sort index if any
-    for(auto & field_doc_value_map: sort_index) {
-        field_doc_value_map.second->erase(seq_id);
+    for(auto & name_tree: search_index) {
+        compact_tree(name_tree.second, ids, num_ids);
     }
 
-    return Option<uint32_t>(seq_id);
+    for(size_t i = 0; i < num_ids; i++) {
+        facet_index_v2.erase(ids[i]);
+    }
+
+    deleted_ids.remove(ids, num_ids);
+    delete [] ids;
+
+    return num_ids;
 }
 
 art_leaf* Index::get_token_leaf(const std::string & field_name, const unsigned char* token, uint32_t token_len) {
@@ -1843,6 +1981,44 @@ art_leaf* Index::get_token_leaf(const std::string & field_name, const unsigned c
     return (art_leaf*) art_search(t, token, (int) token_len);
 }
 
+void Index::add_memory_usage(std::map<std::string, field_memory_t> & field_memory) const {
+    for(const auto & name_field: search_schema) {
+        const field & a_field = name_field.second;
+        field_memory_t & memory = field_memory[a_field.name];
+
+        art_memory_usage(search_index.at(a_field.name), &memory.tree);
+
+        if(a_field.faceted_name() != a_field.name) {
+            art_memory_usage(search_index.at(a_field.faceted_name()), &memory.tree);
+        }
+    }
+
+    // the facet values of a document are held in the order of the facet schema
+    std::vector<field_memory_t*> facet_memory;
+    for(const auto & name_field: facet_schema) {
+        facet_memory.push_back(&field_memory[name_field.first]);
+    }
+
+    for(const auto & seq_id_facets: facet_index_v2) {
+        const std::vector<std::vector<uint64_t>> & facet_values = seq_id_facets.second;
+        for(size_t i = 0; i < facet_values.size() && i < facet_memory.size(); i++) {
+            facet_memory[i]->facet_bytes += sizeof(std::vector<uint64_t>) +
+                                            facet_values[i].capacity() * sizeof(uint64_t);
+        }
+    }
+
+    for(const auto & name_values: sort_index) {
+        field_memory[name_values.first].sort_bytes +=
+                name_values.second->size() * sizeof(std::pair<uint32_t, int64_t>);
+    }
+}
+
+void Index::add_arena_usage(art_memory & memory) const {
+    for(const auto & name_tree: search_index) {
+        art_arena_usage(name_tree.second, &memory);
+    }
+}
+
 const spp::sparse_hash_map<std::string, art_tree *> &Index::_get_search_index() const {
     return search_index;
 }
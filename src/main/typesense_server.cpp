@@ -5,50 +5,54 @@
 void master_server_routes() {
     // collection management
     server->post("/collections", post_create_collection);
-    server->get("/collections", get_collections);
+    server->get("/collections", get_collections, false, true);
     server->del("/collections/:collection", del_drop_collection);
-    server->get("/collections/:collection", get_collection_summary);
+    // walks the trees of the collection for its memory usage, so runs on a worker under the read lock
+    server->get("/collections/:collection", get_collection_summary, false, true);
 
     // document management - `/documents/:id` end-points must be placed last in the list
-    server->post("/collections/:collection/documents", post_add_document);
-    server->get("/collections/:collection/documents/search", get_search);
+    // writes to the documents and overrides of a collection hold off only the searches on that collection
+    server->post("/collections/:collection/documents", post_add_document, false, false, true);
+    server->get("/collections/:collection/documents/search", get_search, false, true);
+    server->post("/multi_search", post_multi_search, false, true);
 
-    server->post("/collections/:collection/documents/import", post_import_documents);
-    server->get("/collections/:collection/documents/export", get_export_documents, true);
+    server->post("/collections/:collection/documents/import", post_import_documents, false, false, true);
+    server->get("/collections/:collection/documents/export", get_export_documents, true, true);
 
-    server->get("/collections/:collection/documents/:id", get_fetch_document);
-    server->del("/collections/:collection/documents/:id", del_remove_document);
+    server->get("/collections/:collection/documents/:id", get_fetch_document, false, true);
+    server->del("/collections/:collection/documents/:id", del_remove_document, false, true);
 
-    server->get("/collections/:collection/overrides", get_overrides);
-    server->get("/collections/:collection/overrides/:id", get_override);
-    server->put("/collections/:collection/overrides/:id", put_override);
-    server->del("/collections/:collection/overrides/:id", del_override);
+    server->get("/collections/:collection/overrides", get_overrides, false, true);
+    server->get("/collections/:collection/overrides/:id", get_override, false, true);
+    server->put("/collections/:collection/overrides/:id", put_override, false, true);
+    server->del("/collections/:collection/overrides/:id", del_override, false, true);
 
-    server->get("/aliases", get_aliases);
-    server->get("/aliases/:alias", get_alias);
+    server->get("/aliases", get_aliases, false, true);
+    server->get("/aliases/:alias", get_alias, false, true);
     server->put("/aliases/:alias", put_upsert_alias);
     server->del("/aliases/:alias", del_alias);
 
-    server->get("/keys", get_keys);
-    server->get("/keys/:id", get_key);
+    server->get("/keys", get_keys, false, true);
+    server->get("/keys/:id", get_key, false, true);
     server->post("/keys", post_create_key);
     server->del("/keys/:id", del_key);
 
     // meta
-    server->get("/metrics.json", get_metrics_json);
+    server->get("/metrics.json", get_metrics_json, false, true);
     server->get("/debug", get_debug);
     server->get("/health", get_health);
 }
 
 void replica_server_routes() {
     // collection management
-    server->get("/collections", get_collections);
-    server->get("/collections/:collection", get_collection_summary);
+    server->get("/collections", get_collections, false, true);
+    server->get("/collections/:collection", get_collection_summary, false, true);
 
     // document management - `/documents/:id` end-points must be placed last in the list
-    server->get("/collections/:collection/documents/search", get_search);
-    server->get("/collections/:collection/documents/export", get_export_documents, true);
-    server->get("/collections/:collection/documents/:id", get_fetch_document);
+    server->get("/collections/:collection/documents/search", get_search, false, true);
+    server->post("/multi_search", post_multi_search, false, true);
+    server->get("/collections/:collection/documents/export", get_export_documents, true, true);
+    server->get("/collections/:collection/documents/:id", get_fetch_document, false, true);
 
     // meta
     server->get("/debug", get_debug);
@@ -0,0 +1,168 @@
+#include "positions_list.h"
+#include <algorithm>
+
+static inline uint64_t zigzag_delta(uint32_t value, uint32_t prev) {
+    const int64_t delta = int64_t(value) - int64_t(prev);
+    return (delta < 0) ? (uint64_t(-delta) * 2 - 1) : (uint64_t(delta) * 2);
+}
+
+static inline uint32_t varint_size(uint64_t value) {
+    uint32_t size = 1;
+    while(value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+bool positions_list::reserve(uint32_t size) {
+    if(size <= data_capacity) {
+        return true;
+    }
+
+    const uint32_t new_capacity = std::max(size, (uint32_t) (data_capacity * FOR_GROWTH_FACTOR));
+    uint8_t* new_data = (uint8_t *) realloc(data, new_capacity);
+    if(new_data == nullptr) {
+        return false;
+    }
+
+    data = new_data;
+    data_capacity = new_capacity;
+    return true;
+}
+
+static uint32_t encoded_size(const uint32_t* positions, uint32_t positions_length) {
+    uint32_t size = 0;
+    for(uint32_t i = 0; i < positions_length; i++) {
+        size += varint_size(zigzag_delta(positions[i], (i == 0) ? 0 : positions[i-1]));
+    }
+    return size;
+}
+
+void positions_list::encode(const uint32_t* positions, uint32_t positions_length) {
+    for(uint32_t i = 0; i < positions_length; i++) {
+        uint64_t zigzag = zigzag_delta(positions[i], (i == 0) ? 0 : positions[i-1]);
+
+        while(zigzag >= 0x80) {
+            data[data_length++] = uint8_t(zigzag | 0x80);
+            zigzag >>= 7;
+        }
+
+        data[data_length++] = uint8_t(zigzag);
+    }
+}
+
+bool positions_list::append(const uint32_t* positions, uint32_t positions_length) {
+    // sized exactly, since most leaves hold the positions of only a few documents
+    if(!reserve(data_length + encoded_size(positions, positions_length)) || !doc_starts.append(data_length)) {
+        return false;
+    }
+
+    encode(positions, positions_length);
+    return true;
+}
+
+bool positions_list::append(const uint32_t* positions, const uint32_t* positions_lengths, uint32_t num_docs) {
+    uint32_t size_required = data_length;
+    const uint32_t* doc_positions = positions;
+
+    for(uint32_t i = 0; i < num_docs; i++) {
+        size_required += encoded_size(doc_positions, positions_lengths[i]);
+        doc_positions += positions_lengths[i];
+    }
+
+    if(!reserve(size_required)) {
+        return false;
+    }
+
+    // the starts of a new list are compressed once, rather than appended one by one
+    const bool load_starts = (doc_starts.getLength() == 0);
+    std::vector<uint32_t> starts;
+
+    doc_positions = positions;
+
+    for(uint32_t i = 0; i < num_docs; i++) {
+        if(load_starts) {
+            starts.push_back(data_length);
+        } else if(!doc_starts.append(data_length)) {
+            return false;
+        }
+
+        encode(doc_positions, positions_lengths[i]);
+        doc_positions += positions_lengths[i];
+    }
+
+    if(load_starts && num_docs != 0) {
+        doc_starts.load(&starts[0], num_docs);
+    }
+
+    return true;
+}
+
+void positions_list::get(uint32_t doc_index, std::vector<uint32_t> & positions) {
+    positions.clear();
+
+    uint32_t offset = doc_starts.at(doc_index);
+    const uint32_t end = doc_end(doc_index);
+    uint32_t prev = 0;
+
+    while(offset < end) {
+        uint64_t zigzag = 0;
+        uint32_t shift = 0;
+
+        while(data[offset] & 0x80) {
+            zigzag |= uint64_t(data[offset++] & 0x7F) << shift;
+            shift += 7;
+        }
+
+        zigzag |= uint64_t(data[offset++]) << shift;
+
+        const int64_t delta = (zigzag & 1) ? -int64_t((zigzag + 1) / 2) : int64_t(zigzag / 2);
+        prev = uint32_t(int64_t(prev) + delta);
+        positions.push_back(prev);
+    }
+}
+
+void positions_list::remove(uint32_t doc_index) {
+    remove(&doc_index, 1);
+}
+
+void positions_list::remove(const uint32_t* sorted_doc_indices, uint32_t num_indices) {
+    const uint32_t num_docs = doc_starts.getLength();
+    uint32_t* starts = doc_starts.uncompress();
+
+    uint32_t new_num_docs = 0;
+    uint32_t new_data_length = 0;
+    uint32_t indices_index = 0;
+
+    // the bytes of the documents that are kept slide down over those of the removed ones in a single pass
+    for(uint32_t i = 0; i < num_docs; i++) {
+        const uint32_t start = starts[i];
+        const uint32_t end = (i + 1 == num_docs) ? data_length : starts[i + 1];
+
+        if(indices_index < num_indices && sorted_doc_indices[indices_index] == i) {
+            indices_index++;
+            continue;
+        }
+
+        if(new_data_length != start) {
+            memmove(data + new_data_length, data + start, end - start);
+        }
+
+        starts[new_num_docs++] = new_data_length;
+        new_data_length += end - start;
+    }
+
+    data_length = new_data_length;
+    doc_starts.load(starts, new_num_docs);
+    delete [] starts;
+
+    // give back memory once the stream has shrunk well below what is allocated
+    if(data_length < data_capacity / 2) {
+        uint8_t* new_data = (uint8_t *) realloc(data, std::max<uint32_t>(data_length, 1));
+        if(new_data != nullptr) {
+            data = new_data;
+            data_capacity = std::max<uint32_t>(data_length, 1);
+        }
+    }
+}
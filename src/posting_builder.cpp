@@ -0,0 +1,36 @@
+#include "posting_builder.h"
+#include <algorithm>
+
+void posting_builder::add(art_tree *t, const unsigned char *key, int key_len, const art_document *document) {
+    token_run_t & run = tree_runs[t][std::string((const char *) key, key_len)];
+
+    // a value repeating in an array field is indexed once
+    if(!run.ids.empty() && run.ids.back() == document->id) {
+        return ;
+    }
+
+    run.max_score = std::max(run.max_score, document->score);
+    run.ids.push_back(document->id);
+    run.offsets.insert(run.offsets.end(), document->offsets, document->offsets + document->offsets_len);
+    run.offsets_lens.push_back(document->offsets_len);
+}
+
+void posting_builder::build() {
+    for(auto & tree_run: tree_runs) {
+        for(auto & key_run: tree_run.second) {
+            const std::string & key = key_run.first;
+            const token_run_t & run = key_run.second;
+
+            art_document_run document_run;
+            document_run.max_score = run.max_score;
+            document_run.num_documents = (uint32_t) run.ids.size();
+            document_run.ids = &run.ids[0];
+            document_run.offsets = run.offsets.empty() ? nullptr : &run.offsets[0];
+            document_run.offsets_lens = &run.offsets_lens[0];
+
+            art_insert_many(tree_run.first, (const unsigned char *) key.c_str(), (int) key.size(), &document_run);
+        }
+    }
+
+    tree_runs.clear();
+}
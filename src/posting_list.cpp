@@ -0,0 +1,520 @@
+#include "posting_list.h"
+#include <algorithm>
+#include "array_utils.h"
+
+const uint32_t posting_list::BLOCK_SIZE;
+const uint32_t posting_list::DENSE_MIN_LENGTH;
+const uint32_t posting_list::DENSE_MAX_GAP;
+const size_t posting_list::dense_ids_t::RANK_SPAN_WORDS;
+
+void posting_list::dense_ids_t::add(uint32_t id) {
+    // ids are added in ascending order, so every span up to the id's own starts after all the ids so far
+    const size_t word_index = id >> 6;
+    const size_t span = word_index / RANK_SPAN_WORDS;
+    while(ranks.size() <= span) {
+        ranks.push_back(length);
+    }
+
+    if(word_index >= words.size()) {
+        words.resize(word_index + 1, 0);
+    }
+
+    const uint64_t bit = uint64_t(1) << (id & 63);
+    length += ((words[word_index] & bit) == 0);
+    words[word_index] |= bit;
+}
+
+bool posting_list::dense_ids_t::contains(uint32_t id) const {
+    const size_t word_index = id >> 6;
+    return word_index < words.size() && (words[word_index] & (uint64_t(1) << (id & 63))) != 0;
+}
+
+size_t posting_list::dense_ids_t::intersect(uint32_t* ids, size_t ids_length) const {
+    size_t num_found = 0;
+
+    for(size_t i = 0; i < ids_length; i++) {
+        if(contains(ids[i])) {
+            ids[num_found++] = ids[i];
+        }
+    }
+
+    return num_found;
+}
+
+uint32_t posting_list::dense_ids_t::rank(uint32_t id) const {
+    const size_t word_index = id >> 6;
+    const size_t span = word_index / RANK_SPAN_WORDS;
+
+    uint32_t num_before = ranks[span];
+
+    for(size_t i = span * RANK_SPAN_WORDS; i < word_index; i++) {
+        num_before += __builtin_popcountll(words[i]);
+    }
+
+    return num_before + __builtin_popcountll(words[word_index] & ((uint64_t(1) << (id & 63)) - 1));
+}
+
+uint32_t posting_list::dense_ids_t::select(uint32_t index) const {
+    // the last span that starts at or before the index'th id
+    const size_t span = (std::upper_bound(ranks.begin(), ranks.end(), index) - ranks.begin()) - 1;
+    uint32_t num_before = ranks[span];
+
+    for(size_t i = span * RANK_SPAN_WORDS; i < words.size(); i++) {
+        const uint32_t word_count = __builtin_popcountll(words[i]);
+
+        if(num_before + word_count > index) {
+            uint64_t word = words[i];
+            for(uint32_t skip = index - num_before; skip > 0; skip--) {
+                word &= (word - 1);
+            }
+
+            return uint32_t((i << 6) + __builtin_ctzll(word));
+        }
+
+        num_before += word_count;
+    }
+
+    return 0; // NOTREACHED for an index below the length
+}
+
+posting_list::iterator_t::iterator_t(posting_list* list): list(list), block_index(0), block_length(0), offset(0),
+                                                          block_base_index(0) {
+    load_block();
+}
+
+void posting_list::iterator_t::load_block() {
+    offset = 0;
+    block_length = 0;
+
+    if(list->dense == nullptr) {
+        if(block_index < list->blocks.size()) {
+            list->blocks[block_index].uncompress(block_ids);
+            block_length = BLOCK_SIZE;
+        } else if(block_index == list->blocks.size()) {
+            block_length = list->tail_length();
+            std::copy(list->tail, list->tail + block_length, block_ids);
+        }
+
+        block_base_index = block_index * BLOCK_SIZE;
+        return ;
+    }
+
+    // a block of a dense list spans `BLOCK_SIZE` ids of the bitmap: empty ones are passed over
+    const std::vector<uint64_t> & words = list->dense->words;
+    const size_t words_per_block = BLOCK_SIZE / 64;
+
+    while(block_length == 0 && block_index < list->num_blocks()) {
+        const size_t end_word = std::min(words.size(), (block_index + 1) * words_per_block);
+
+        for(size_t i = block_index * words_per_block; i < end_word; i++) {
+            uint64_t word = words[i];
+            while(word != 0) {
+                block_ids[block_length++] = uint32_t((i << 6) + __builtin_ctzll(word));
+                word &= (word - 1);
+            }
+        }
+
+        if(block_length == 0) {
+            block_index++;
+        }
+    }
+
+    if(block_length != 0) {
+        block_base_index = list->dense->rank(block_ids[0]);
+    }
+}
+
+void posting_list::iterator_t::next() {
+    offset++;
+
+    if(offset == block_length && block_index < list->num_blocks()) {
+        block_index++;
+        load_block();
+    }
+}
+
+void posting_list::iterator_t::advance_to(uint32_t id) {
+    if(!valid() || block_ids[offset] >= id) {
+        return ;
+    }
+
+    if(block_ids[block_length - 1] < id) {
+        block_index = list->find_block(id, block_index + 1);
+        load_block();
+
+        if(!valid()) {
+            return ;
+        }
+    }
+
+    offset = std::lower_bound(block_ids + offset, block_ids + block_length, id) - block_ids;
+}
+
+size_t posting_list::num_blocks() const {
+    if(dense != nullptr) {
+        return (dense->words.size() * 64 + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    }
+
+    return blocks.size() + (tail_length() != 0);
+}
+
+uint32_t posting_list::block_max(size_t block_index) {
+    return (block_index < blocks.size()) ? blocks[block_index].getMax() : tail[tail_length() - 1];
+}
+
+uint32_t posting_list::block_offset_of(size_t block_index, uint32_t value) {
+    if(block_index < blocks.size()) {
+        return blocks[block_index].indexOf(value);
+    }
+
+    const uint32_t num_tail_ids = tail_length();
+    const uint32_t offset = std::lower_bound(tail, tail + num_tail_ids, value) - tail;
+    return (offset < num_tail_ids && tail[offset] == value) ? offset : num_tail_ids;
+}
+
+size_t posting_list::find_block(uint32_t value, size_t from_block) {
+    if(dense != nullptr) {
+        return std::max<size_t>(from_block, value / BLOCK_SIZE);
+    }
+
+    // the first block whose max id is not smaller than the value
+    size_t low = from_block, high = num_blocks();
+
+    while(low < high) {
+        size_t mid = low + (high - low) / 2;
+
+        if(block_max(mid) < value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+void posting_list::clear() {
+    delete dense;
+    dense = nullptr;
+
+    free(tail);
+    tail = nullptr;
+    tail_capacity = 0;
+
+    blocks.clear();
+    blocks.shrink_to_fit();
+    length = 0;
+}
+
+void posting_list::load(const uint32_t *sorted_array, const uint32_t array_length) {
+    clear();
+
+    if(array_length != 0 && is_dense(array_length, sorted_array[array_length - 1])) {
+        load_dense(sorted_array, array_length);
+    } else {
+        load_blocks(sorted_array, array_length);
+    }
+}
+
+void posting_list::load_dense(const uint32_t *sorted_array, const uint32_t array_length) {
+    dense = new dense_ids_t();
+
+    for(uint32_t i = 0; i < array_length; i++) {
+        dense->add(sorted_array[i]);
+    }
+
+    length = array_length;
+}
+
+void posting_list::load_blocks(const uint32_t *sorted_array, const uint32_t array_length) {
+    const uint32_t num_full_blocks = array_length / BLOCK_SIZE;
+    blocks.reserve(num_full_blocks);
+
+    for(uint32_t i = 0; i < num_full_blocks; i++) {
+        blocks.emplace_back();
+        blocks.back().load(sorted_array + i * BLOCK_SIZE, BLOCK_SIZE);
+    }
+
+    length = num_full_blocks * BLOCK_SIZE;
+
+    for(uint32_t i = length; i < array_length; i++) {
+        append(sorted_array[i]);
+    }
+}
+
+uint32_t posting_list::at(uint32_t index) {
+    if(dense != nullptr) {
+        return dense->select(index);
+    }
+
+    if(index / BLOCK_SIZE < blocks.size()) {
+        return blocks[index / BLOCK_SIZE].at(index % BLOCK_SIZE);
+    }
+
+    return tail[index - blocks.size() * BLOCK_SIZE];
+}
+
+bool posting_list::contains(uint32_t value) {
+    if(dense != nullptr) {
+        return dense->contains(value);
+    }
+
+    // ids are appended in ascending order, so this is quick for a new id
+    if(length == 0 || value > block_max(num_blocks() - 1)) {
+        return false;
+    }
+
+    size_t block_index = find_block(value, 0);
+    return block_offset_of(block_index, value) != num_block_ids(block_index);
+}
+
+uint32_t posting_list::indexOf(uint32_t value) {
+    if(dense != nullptr) {
+        return dense->contains(value) ? dense->rank(value) : length;
+    }
+
+    size_t block_index = find_block(value, 0);
+    if(block_index == num_blocks()) {
+        return length;
+    }
+
+    uint32_t block_offset = block_offset_of(block_index, value);
+
+    if(block_offset == num_block_ids(block_index)) {
+        return length;
+    }
+
+    return block_index * BLOCK_SIZE + block_offset;
+}
+
+void posting_list::indexOf(const uint32_t *values, const size_t values_len, uint32_t *indices) {
+    if(dense != nullptr) {
+        for(size_t i = 0; i < values_len; i++) {
+            indices[i] = indexOf(values[i]);
+        }
+
+        return ;
+    }
+
+    // values are sorted, so the block to look in only moves forward
+    size_t block_index = 0;
+
+    for(size_t i = 0; i < values_len; i++) {
+        block_index = find_block(values[i], block_index);
+
+        if(block_index == num_blocks()) {
+            std::fill(indices + i, indices + values_len, length);
+            return ;
+        }
+
+        uint32_t block_offset = block_offset_of(block_index, values[i]);
+
+        indices[i] = (block_offset == num_block_ids(block_index)) ? length :
+                     (block_index * BLOCK_SIZE + block_offset);
+    }
+}
+
+bool posting_list::append(uint32_t value) {
+    if(dense != nullptr) {
+        dense->add(value);
+        length++;
+
+        // ids have thinned out enough for the blocks to be smaller again
+        if(value / (2 * DENSE_MAX_GAP) >= length) {
+            uint32_t* ids = uncompress();
+            load(ids, length);
+            delete [] ids;
+        }
+
+        return true;
+    }
+
+    const uint32_t num_tail_ids = tail_length();
+
+    if(num_tail_ids == tail_capacity) {
+        // grows by doubling up to a block
+        const uint32_t new_capacity = std::min(BLOCK_SIZE, std::max<uint32_t>(2, tail_capacity * 2));
+        uint32_t* new_tail = (uint32_t *) realloc(tail, new_capacity * sizeof(uint32_t));
+        if(new_tail == nullptr) {
+            return false;
+        }
+
+        tail = new_tail;
+        tail_capacity = new_capacity;
+    }
+
+    tail[num_tail_ids] = value;
+    length++;
+
+    if(num_tail_ids + 1 < BLOCK_SIZE) {
+        return true;
+    }
+
+    // the tail is full: seal it into a compressed block
+    blocks.emplace_back();
+    blocks.back().load(tail, BLOCK_SIZE);
+
+    free(tail);
+    tail = nullptr;
+    tail_capacity = 0;
+
+    if(is_dense(length, value)) {
+        uint32_t* ids = uncompress();
+        load(ids, length);
+        delete [] ids;
+    }
+
+    return true;
+}
+
+bool posting_list::append(const uint32_t* values, uint32_t values_length) {
+    if(length == 0) {
+        load(values, values_length);
+        return true;
+    }
+
+    uint32_t i = 0;
+
+    // a bitmap takes ids one by one, while blocks have to continue from a partially filled tail
+    while(i < values_length && (dense != nullptr || tail_length() != 0)) {
+        if(!append(values[i++])) {
+            return false;
+        }
+    }
+
+    while(values_length - i >= BLOCK_SIZE) {
+        blocks.emplace_back();
+        blocks.back().load(values + i, BLOCK_SIZE);
+        length += BLOCK_SIZE;
+        i += BLOCK_SIZE;
+    }
+
+    for(; i < values_length; i++) {
+        if(!append(values[i])) {
+            return false;
+        }
+    }
+
+    if(dense == nullptr && values_length != 0 && is_dense(length, values[values_length - 1])) {
+        uint32_t* ids = uncompress();
+        load(ids, length);
+        delete [] ids;
+    }
+
+    return true;
+}
+
+void posting_list::remove_values(uint32_t *sorted_values, uint32_t values_length) {
+    uint32_t *curr_array = uncompress();
+
+    uint32_t *new_array = new uint32_t[length];
+    uint32_t new_index = 0;
+    uint32_t curr_index = 0;
+    uint32_t sorted_values_index = 0;
+
+    while(curr_index < length) {
+        if(sorted_values_index < values_length && curr_array[curr_index] >= sorted_values[sorted_values_index]) {
+            // skip copying
+            if(curr_array[curr_index] == sorted_values[sorted_values_index]) {
+                curr_index++;
+            }
+            sorted_values_index++;
+        } else {
+            new_array[new_index++] = curr_array[curr_index++];
+        }
+    }
+
+    load(new_array, new_index);
+    delete[] curr_array;
+    delete[] new_array;
+}
+
+uint32_t* posting_list::uncompress() {
+    if(dense != nullptr) {
+        uint32_t *out = new uint32_t[length];
+        uint32_t out_index = 0;
+
+        for(size_t i = 0; i < dense->words.size(); i++) {
+            uint64_t word = dense->words[i];
+            while(word != 0) {
+                out[out_index++] = uint32_t((i << 6) + __builtin_ctzll(word));
+                word &= (word - 1);
+            }
+        }
+
+        return out;
+    }
+
+    uint32_t *out = new uint32_t[length];
+
+    for(size_t i = 0; i < blocks.size(); i++) {
+        blocks[i].uncompress(out + i * BLOCK_SIZE);
+    }
+
+    std::copy(tail, tail + tail_length(), out + blocks.size() * BLOCK_SIZE);
+
+    return out;
+}
+
+size_t posting_list::intersect(uint32_t* ids, size_t ids_length) {
+    if(ids_length == 0 || length == 0) {
+        return 0;
+    }
+
+    if(dense != nullptr) {
+        return dense->intersect(ids, ids_length);
+    }
+
+    // with fewer ids than blocks, most blocks are never decoded
+    if(ids_length * BLOCK_SIZE <= length) {
+        iterator_t it = new_iterator();
+        size_t num_found = 0;
+
+        for(size_t i = 0; i < ids_length && it.valid(); i++) {
+            it.advance_to(ids[i]);
+
+            if(it.valid() && it.id() == ids[i]) {
+                ids[num_found++] = ids[i];
+            }
+        }
+
+        return num_found;
+    }
+
+    uint32_t* list_ids = uncompress();
+    size_t num_found = ArrayUtils::and_inplace(ids, ids_length, list_ids, length);
+    delete [] list_ids;
+
+    return num_found;
+}
+
+void posting_list::add_to(ids_bitmap & bitmap) {
+    if(dense != nullptr) {
+        bitmap.add_words(&dense->words[0], dense->words.size());
+        return ;
+    }
+
+    uint32_t block_ids[BLOCK_SIZE];
+
+    for(sorted_array & block: blocks) {
+        block.uncompress(block_ids);
+        bitmap.add(block_ids, block.getLength());
+    }
+
+    bitmap.add(tail, tail_length());
+}
+
+uint32_t posting_list::getSizeInBytes() {
+    if(dense != nullptr) {
+        return sizeof(dense_ids_t) + dense->words.capacity() * sizeof(uint64_t) +
+               dense->ranks.capacity() * sizeof(uint32_t);
+    }
+
+    uint32_t size_bytes = blocks.capacity() * sizeof(sorted_array) + tail_capacity * sizeof(uint32_t);
+
+    for(sorted_array & block: blocks) {
+        size_bytes += block.getSizeInBytes();
+    }
+
+    return size_bytes;
+}
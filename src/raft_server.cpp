@@ -96,7 +96,7 @@ void ReplicationState::write(http_req* request, http_res* response) {
             // Handle no leader scenario
             LOG(ERROR) << "Rejecting write: could not find a leader.";
             response->set_500("Could not find a leader.");
-            auto replication_arg = new AsyncIndexArg{request, response, nullptr};
+            auto replication_arg = new AsyncIndexArg{request, response};
             replication_arg->req->route_hash = static_cast<uint64_t>(ROUTE_CODES::ALREADY_HANDLED);
             return message_dispatcher->send_message(REPLICATION_MSG, replication_arg);
         }
@@ -131,7 +131,7 @@ void ReplicationState::write(http_req* request, http_res* response) {
                 response->set_500(err);
             }
 
-            auto replication_arg = new AsyncIndexArg{request, response, nullptr};
+            auto replication_arg = new AsyncIndexArg{request, response};
             replication_arg->req->route_hash = static_cast<uint64_t>(ROUTE_CODES::ALREADY_HANDLED);
             message_dispatcher->send_message(REPLICATION_MSG, replication_arg);
         });
@@ -200,14 +200,11 @@ void ReplicationState::on_apply(braft::Iterator& iter) {
         }
 
         // Now that the log has been parsed, perform the actual operation
-        // Call http server thread for write and response back to client (if `response` is NOT null)
-        // We use a future to block current thread until the async flow finishes
-
-        std::promise<bool> promise;
-        std::future<bool> future = promise.get_future();
-        auto replication_arg = new AsyncIndexArg{request, response, &promise};
-        message_dispatcher->send_message(REPLICATION_MSG, replication_arg);
-        future.get();
+        // Writes are applied right here, one after another in log order, so that the http thread is never held
+        // up by a write waiting on its locks: only the response to the client (if any) is posted back to it
+
+        auto replication_arg = new AsyncIndexArg{request, response};
+        write_applier(replication_arg);
     }
 }
 
@@ -346,9 +343,9 @@ void ReplicationState::refresh_nodes(const std::string & nodes) {
 }
 
 ReplicationState::ReplicationState(Store *store, ThreadPool* thread_pool, http_message_dispatcher *message_dispatcher,
-                                   bool create_init_db_snapshot):
+                                   bool (*write_applier)(void*), bool create_init_db_snapshot):
         node(nullptr), leader_term(-1), store(store), thread_pool(thread_pool),
-        message_dispatcher(message_dispatcher), init_readiness_count(0),
+        message_dispatcher(message_dispatcher), write_applier(write_applier), init_readiness_count(0),
         create_init_db_snapshot(create_init_db_snapshot) {
 
 }
@@ -0,0 +1,76 @@
+#include "search_cache.h"
+
+void SearchCache::erase(std::list<entry_t>::iterator entry_it) {
+    num_bytes -= entry_it->num_bytes;
+    key_to_entry.erase(entry_it->key);
+    entries.erase(entry_it);
+}
+
+void SearchCache::set_max_bytes(size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->max_bytes = max_bytes;
+
+    while(num_bytes > max_bytes && !entries.empty()) {
+        erase(std::prev(entries.end()));
+    }
+}
+
+bool SearchCache::get(const std::string & key, uint64_t write_generation, nlohmann::json & result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto key_entry_it = key_to_entry.find(key);
+
+    if(key_entry_it == key_to_entry.end()) {
+        misses++;
+        return false;
+    }
+
+    auto entry_it = key_entry_it->second;
+
+    if(entry_it->write_generation != write_generation) {
+        // collection has changed since the result was cached
+        erase(entry_it);
+        misses++;
+        return false;
+    }
+
+    entries.splice(entries.begin(), entries, entry_it);
+    result = entry_it->result;
+    hits++;
+    return true;
+}
+
+void SearchCache::put(const std::string & key, uint64_t write_generation, const nlohmann::json & result) {
+    // approximate footprint of the entry: the serialized result is a good proxy for the size of the json tree
+    const size_t entry_bytes = key.size() + result.dump().size();
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if(entry_bytes > max_bytes) {
+        return ;
+    }
+
+    auto key_entry_it = key_to_entry.find(key);
+    if(key_entry_it != key_to_entry.end()) {
+        erase(key_entry_it->second);
+    }
+
+    while(num_bytes + entry_bytes > max_bytes && !entries.empty()) {
+        erase(std::prev(entries.end()));
+    }
+
+    entries.push_front(entry_t{key, write_generation, result, entry_bytes});
+    key_to_entry[key] = entries.begin();
+    num_bytes += entry_bytes;
+}
+
+void SearchCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    key_to_entry.clear();
+    num_bytes = 0;
+}
+
+size_t SearchCache::get_num_bytes() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return num_bytes;
+}
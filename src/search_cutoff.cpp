@@ -0,0 +1,5 @@
+#include "search_cutoff.h"
+
+thread_local uint64_t search_cutoff::stop_us = 0;
+thread_local bool search_cutoff::cutoff = false;
+thread_local uint32_t search_cutoff::num_polls = 0;
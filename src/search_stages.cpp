@@ -0,0 +1,93 @@
+#include <algorithm>
+#include "search_stages.h"
+
+const char* const SEARCH_STAGE_NAMES[NUM_SEARCH_STAGES] = {
+    "tokenize", "fuzzy", "intersect", "filter", "score", "facet", "merge", "hydrate", "highlight"
+};
+
+thread_local search_stage_times_t search_stage_timer::times;
+
+nlohmann::json search_stage_times_t::to_json() const {
+    nlohmann::json stages = nlohmann::json::object();
+
+    for(size_t i = 0; i < NUM_SEARCH_STAGES; i++) {
+        stages[SEARCH_STAGE_NAMES[i]] = stage_us[i];
+    }
+
+    return stages;
+}
+
+search_stage_histograms::search_stage_histograms() {
+    for(size_t stage = 0; stage < NUM_SEARCH_STAGES; stage++) {
+        for(size_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+            buckets[stage][bucket] = 0;
+        }
+
+        counts[stage] = 0;
+        sums_us[stage] = 0;
+    }
+}
+
+void search_stage_histograms::record(const search_stage_times_t & times) {
+    for(size_t stage = 0; stage < NUM_SEARCH_STAGES; stage++) {
+        if(!times.ran[stage]) {
+            continue;
+        }
+
+        const uint64_t us = times.stage_us[stage];
+
+        // bucket `i` holds values below 2^i microseconds
+        size_t bucket = (us == 0) ? 0 : (64 - __builtin_clzll(us));
+        bucket = std::min(bucket, NUM_BUCKETS - 1);
+
+        buckets[stage][bucket]++;
+        counts[stage]++;
+        sums_us[stage] += us;
+    }
+}
+
+uint64_t search_stage_histograms::get_percentile(size_t stage, double percentile) const {
+    const uint64_t count = counts[stage];
+    if(count == 0) {
+        return 0;
+    }
+
+    const uint64_t rank = (uint64_t) (percentile * count);
+    uint64_t seen = 0;
+
+    for(size_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+        seen += buckets[stage][bucket];
+        if(seen > rank) {
+            // upper bound of the bucket
+            return (uint64_t(1) << bucket) - 1;
+        }
+    }
+
+    return (uint64_t(1) << (NUM_BUCKETS - 1)) - 1;
+}
+
+nlohmann::json search_stage_histograms::to_json() const {
+    nlohmann::json histograms = nlohmann::json::object();
+
+    for(size_t stage = 0; stage < NUM_SEARCH_STAGES; stage++) {
+        nlohmann::json histogram = nlohmann::json::object();
+        histogram["count"] = counts[stage].load();
+        histogram["sum_us"] = sums_us[stage].load();
+        histogram["p50_us"] = get_percentile(stage, 0.50);
+        histogram["p99_us"] = get_percentile(stage, 0.99);
+
+        // non-empty buckets as [upper bound in microseconds, count] pairs
+        histogram["buckets"] = nlohmann::json::array();
+
+        for(size_t bucket = 0; bucket < NUM_BUCKETS; bucket++) {
+            const uint64_t bucket_count = buckets[stage][bucket];
+            if(bucket_count != 0) {
+                histogram["buckets"].push_back({(uint64_t(1) << bucket) - 1, bucket_count});
+            }
+        }
+
+        histograms[SEARCH_STAGE_NAMES[stage]] = histogram;
+    }
+
+    return histograms;
+}
@@ -119,6 +119,13 @@ void init_cmdline_options(cmdline::parser & options, int argc, char **argv) {
 
     options.add<std::string>("config", '\0', "Path to the configuration file.", false, "");
 
+    options.add<uint32_t>("num-search-threads", '\0', "Number of threads used for serving search requests, "
+                                                       "and for searching the indices of collections. "
+                                                       "Defaults to the number of CPU cores.", false, 0);
+
+    options.add<uint32_t>("search-cache-size-mb", '\0', "Memory (in MB) used for caching search results. "
+                                                         "Defaults to 0, which disables the cache.", false, 0);
+
     // DEPRECATED
     options.add<std::string>("listen-address", 'h', "[DEPRECATED: use `api-address`] Address to which Typesense API service binds.", false, "0.0.0.0");
     options.add<uint32_t>("listen-port", 'p', "[DEPRECATED: use `api-port`] Port on which Typesense API service listens.", false, 8108);
@@ -173,6 +180,14 @@ bool on_send_response(void *data) {
     return true;
 }
 
+bool on_stream_response(void *data) {
+    stream_request_response* stream_req_res = static_cast<stream_request_response*>(data);
+    stream_response(stream_req_res->handler, *stream_req_res->req, *stream_req_res->res, stream_req_res->data);
+    delete stream_req_res;
+
+    return true;
+}
+
 Option<std::string> fetch_nodes_config(const std::string& path_to_nodes) {
     std::string nodes_config;
 
@@ -274,6 +289,59 @@ int start_raft_server(ReplicationState& replication_state, const std::string& st
     return 0;
 }
 
+void compact_collections(const ReplicationState & replication_state) {
+    // an index is compacted once enough documents have been removed from it, or a large enough share of them,
+    // or after a while regardless
+    const size_t COMPACTION_BATCH_SIZE = 10000;
+    const size_t COMPACTION_MIN_DELETED = 1000;
+    const size_t COMPACTION_MAX_WAIT_SECONDS = 60;
+    const size_t COMPACTION_MIN_DELETED_PERCENT = 5;
+
+    CollectionManager & collectionManager = CollectionManager::get_instance();
+    size_t compaction_counter = 0;
+
+    while(!quit_raft_service.load()) {
+        sleep(1);
+
+        // collections are still being loaded from disk
+        if(!replication_state.is_ready()) {
+            continue;
+        }
+
+        const size_t min_deleted = (++compaction_counter % COMPACTION_MAX_WAIT_SECONDS == 0) ?
+                                   1 : COMPACTION_MIN_DELETED;
+
+        std::vector<std::string> collection_names;
+
+        {
+            read_lock_guard lock(server->get_worker_lock());
+
+            for(Collection* collection: collectionManager.get_collections()) {
+                collection_names.push_back(collection->get_name());
+            }
+        }
+
+        for(const std::string & collection_name: collection_names) {
+            // The worker lock keeps the collection from being dropped, and is held for one collection at a time.
+            // It prefers writers, so a server-wide write queued behind it holds off every search until released.
+            read_lock_guard lock(server->get_worker_lock());
+
+            Collection* collection = collectionManager.get_collection(collection_name);
+            if(collection == nullptr) {
+                continue;
+            }
+
+            // the collection holds off its own searches while compacted
+            const size_t num_compacted = collection->compact(COMPACTION_BATCH_SIZE, min_deleted,
+                                                             COMPACTION_MIN_DELETED_PERCENT);
+            if(num_compacted != 0) {
+                LOG(INFO) << "Compacted " << num_compacted << " removed documents of collection "
+                          << collection_name;
+            }
+        }
+    }
+}
+
 int run_server(const Config & config, const std::string & version, void (*master_server_routes)()) {
 
     LOG(INFO) << "Starting Typesense " << version << std::flush;
@@ -324,7 +392,8 @@ int run_server(const Config & config, const std::string & version, void (*master
     Store store(db_dir);
     CollectionManager & collectionManager = CollectionManager::get_instance();
     collectionManager.init(&store, config.get_indices_per_collection(),
-                           config.get_api_key());
+                           config.get_api_key(), config.get_num_search_threads());
+    collectionManager.get_search_cache().set_max_bytes(config.get_search_cache_size_mb() * 1024 * 1024);
 
     curl_global_init(CURL_GLOBAL_SSL);
     HttpClient & httpClient = HttpClient::get_instance();
@@ -342,12 +411,19 @@ int run_server(const Config & config, const std::string & version, void (*master
     server->set_auth_handler(handle_authentication);
 
     server->on(SEND_RESPONSE_MSG, on_send_response);
+    server->on(STREAM_RESPONSE_MSG, on_stream_response);
     server->on(ReplicationState::REPLICATION_MSG, async_write_request);
 
     // first we start the peering service
 
     ThreadPool thread_pool(4);
-    ReplicationState replication_state(&store, &thread_pool, server->get_message_dispatcher(), create_init_db_snapshot);
+
+    // searches are run off the event loop so that a slow query does not hold up other requests
+    ThreadPool* search_thread_pool = new ThreadPool(config.get_num_search_threads());
+    server->set_search_thread_pool(search_thread_pool);
+
+    ReplicationState replication_state(&store, &thread_pool, server->get_message_dispatcher(), apply_write_request,
+                                       create_init_db_snapshot);
 
     std::thread raft_thread([&replication_state, &config, &state_dir]() {
         std::string path_to_nodes = config.get_nodes();
@@ -355,6 +431,9 @@ int run_server(const Config & config, const std::string & version, void (*master
                           config.get_peering_address(), config.get_peering_port(), config.get_api_port());
     });
 
+    // removed documents are purged from the in-memory indices in the background
+    std::thread compaction_thread(compact_collections, std::cref(replication_state));
+
     LOG(INFO) << "Starting API service...";
 
     master_server_routes();
@@ -365,6 +444,10 @@ int run_server(const Config & config, const std::string & version, void (*master
     LOG(INFO) << "Typesense API service has quit. Stopping peering service...";
     quit_raft_service = true;
     raft_thread.join();
+    compaction_thread.join();
+
+    // pending searches post their responses through the server, so drain them before it goes away
+    delete search_thread_pool;
 
     curl_global_cleanup();
 
@@ -1,5 +1,9 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <set>
 #include "array_utils.h"
+#include "ids_bitmap.h"
 
 TEST(SortedArrayTest, AndScalar) {
     const size_t size1 = 9;
@@ -33,6 +37,44 @@ TEST(SortedArrayTest, AndScalar) {
     delete [] arr2;
 }
 
+TEST(SortedArrayTest, AndInplaceForVaryingLengths) {
+    std::mt19937 gen(137723);
+
+    // equal lengths take the merge (SIMD when available) and skewed lengths the galloping intersection
+    const std::vector<std::pair<size_t, size_t>> lengths = {
+        {1, 1}, {3, 5}, {7, 9}, {17, 23}, {100, 100}, {1000, 1200}, {5, 1000}, {1000, 5}, {40, 10000}, {10000, 3}
+    };
+
+    for(const auto & length_pair: lengths) {
+        for(const uint32_t max_id: {50u, 20000u}) {
+            std::uniform_int_distribution<uint32_t> dist(0, max_id);
+            std::set<uint32_t> set_a, set_b;
+
+            while(set_a.size() < std::min<size_t>(length_pair.first, max_id)) {
+                set_a.insert(dist(gen));
+            }
+
+            while(set_b.size() < std::min<size_t>(length_pair.second, max_id)) {
+                set_b.insert(dist(gen));
+            }
+
+            std::vector<uint32_t> arr_a(set_a.begin(), set_a.end());
+            std::vector<uint32_t> arr_b(set_b.begin(), set_b.end());
+
+            std::vector<uint32_t> expected;
+            std::set_intersection(arr_a.begin(), arr_a.end(), arr_b.begin(), arr_b.end(), std::back_inserter(expected));
+
+            uint32_t* results = nullptr;
+            size_t results_size = ArrayUtils::and_scalar(&arr_a[0], arr_a.size(), &arr_b[0], arr_b.size(), &results);
+            ASSERT_EQ(expected, std::vector<uint32_t>(results, results + results_size));
+            delete [] results;
+
+            results_size = ArrayUtils::and_inplace(&arr_a[0], arr_a.size(), &arr_b[0], arr_b.size());
+            ASSERT_EQ(expected, std::vector<uint32_t>(arr_a.begin(), arr_a.begin() + results_size));
+        }
+    }
+}
+
 TEST(SortedArrayTest, OrScalarMergeShouldRemoveDuplicates) {
     const size_t size1 = 9;
     uint32_t *arr1 = new uint32_t[size1];
@@ -115,6 +157,41 @@ TEST(SortedArrayTest, OrScalarWithEitherArrayAsNull) {
     results = nullptr;
 }
 
+TEST(SortedArrayTest, OrManyForSparseAndDenseArrays) {
+    std::mt19937 gen(42);
+
+    for(const uint32_t max_id: {100u, 1000000u}) {
+        for(const size_t num_arrays: {0, 1, 2, 3, 50}) {
+            std::uniform_int_distribution<uint32_t> dist(0, max_id);
+            std::vector<std::vector<uint32_t>> arrays(num_arrays);
+            std::vector<std::pair<uint32_t*, size_t>> array_pairs;
+            std::set<uint32_t> expected;
+
+            for(auto & array: arrays) {
+                std::set<uint32_t> ids;
+                while(ids.size() < 20) {
+                    ids.insert(dist(gen));
+                }
+
+                array.assign(ids.begin(), ids.end());
+                array_pairs.emplace_back(&array[0], array.size());
+                expected.insert(ids.begin(), ids.end());
+            }
+
+            // empty arrays are skipped
+            array_pairs.emplace_back(nullptr, 0);
+
+            uint32_t* results = nullptr;
+            size_t results_size = ArrayUtils::or_many(array_pairs, &results);
+
+            ASSERT_EQ(std::vector<uint32_t>(expected.begin(), expected.end()),
+                      std::vector<uint32_t>(results, results + results_size));
+
+            delete [] results;
+        }
+    }
+}
+
 TEST(SortedArrayTest, FilterArray) {
     const size_t size1 = 9;
     uint32_t *arr1 = new uint32_t[size1];
@@ -157,4 +234,120 @@ TEST(SortedArrayTest, FilterArray) {
     delete[] arr2;
     delete[] arr1;
     delete[] results;
-}
\ No newline at end of file
+}
+
+TEST(SortedArrayTest, IdsBitmapUnion) {
+    ids_bitmap bitmap;
+
+    uint32_t* results = nullptr;
+    ASSERT_EQ(0, bitmap.to_array(&results));
+    ASSERT_EQ(nullptr, results);
+
+    std::vector<uint32_t> ids1 = {1, 3, 63, 64, 200};
+    std::vector<uint32_t> ids2 = {0, 3, 64, 1000};
+
+    bitmap.add(&ids1[0], ids1.size());
+    bitmap.add(&ids2[0], ids2.size());
+    ASSERT_EQ(7, bitmap.size());
+
+    ids_bitmap other;
+    std::vector<uint32_t> ids3 = {2, 3, 5000};
+    other.add(&ids3[0], ids3.size());
+    bitmap.add(other);
+    ASSERT_EQ(9, bitmap.size());
+
+    size_t results_size = bitmap.to_array(&results);
+    std::vector<uint32_t> expected = {0, 1, 2, 3, 63, 64, 200, 1000, 5000};
+    ASSERT_EQ(expected.size(), results_size);
+
+    for(size_t i = 0; i < results_size; i++) {
+        ASSERT_EQ(expected[i], results[i]);
+    }
+
+    delete[] results;
+}
+
+TEST(SortedArrayTest, IdsBitmapSwitchesBetweenArrayAndBitmap) {
+    std::mt19937 rng(42);
+
+    // few ids far apart stay an array, while many ids in a narrow range far from 0 become a bitmap of that range
+    for(size_t round = 0; round < 20; round++) {
+        ids_bitmap bitmap, other;
+        std::set<uint32_t> expected, expected_other;
+
+        const uint32_t base = (round % 2 == 0) ? 0 : 50000000;
+        const uint32_t span = (round % 4 < 2) ? 100000000 : 20000;
+        const size_t num_ids = (round % 3 == 0) ? 100 : 9000;
+
+        for(size_t batch = 0; batch < 4; batch++) {
+            std::vector<uint32_t> ids;
+            for(size_t i = 0; i < num_ids / 4; i++) {
+                ids.push_back(base + rng() % span);
+            }
+
+            std::sort(ids.begin(), ids.end());
+            ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+            bitmap.add(&ids[0], ids.size());
+            expected.insert(ids.begin(), ids.end());
+
+            std::vector<uint32_t> other_ids;
+            for(size_t i = 0; i < num_ids / (batch + 1); i++) {
+                other_ids.push_back(base + rng() % span);
+            }
+
+            std::sort(other_ids.begin(), other_ids.end());
+            other_ids.erase(std::unique(other_ids.begin(), other_ids.end()), other_ids.end());
+            other.add(&other_ids[0], other_ids.size());
+            expected_other.insert(other_ids.begin(), other_ids.end());
+        }
+
+        ASSERT_EQ(expected.size(), bitmap.size());
+
+        // drop a few ids, unsorted
+        std::vector<uint32_t> removed(expected.begin(), expected.end());
+        std::shuffle(removed.begin(), removed.end(), rng);
+        removed.resize(removed.size() / 10);
+        bitmap.remove(&removed[0], removed.size());
+        for(uint32_t id: removed) {
+            expected.erase(id);
+        }
+
+        ASSERT_EQ(expected.size(), bitmap.size());
+
+        ids_bitmap subtracted = bitmap;
+        subtracted.subtract(other);
+
+        ids_bitmap intersected = bitmap;
+        intersected.intersect(other);
+
+        ids_bitmap united = bitmap;
+        united.add(other);
+
+        std::set<uint32_t> expected_subtracted, expected_intersected, expected_united;
+        std::set_difference(expected.begin(), expected.end(), expected_other.begin(), expected_other.end(),
+                            std::inserter(expected_subtracted, expected_subtracted.end()));
+        std::set_intersection(expected.begin(), expected.end(), expected_other.begin(), expected_other.end(),
+                              std::inserter(expected_intersected, expected_intersected.end()));
+        std::set_union(expected.begin(), expected.end(), expected_other.begin(), expected_other.end(),
+                       std::inserter(expected_united, expected_united.end()));
+
+        const std::vector<std::pair<const ids_bitmap*, const std::set<uint32_t>*>> checks = {
+            {&bitmap, &expected}, {&subtracted, &expected_subtracted},
+            {&intersected, &expected_intersected}, {&united, &expected_united}
+        };
+
+        for(const auto & check: checks) {
+            uint32_t* results = nullptr;
+            size_t results_size = check.first->to_array(&results);
+            ASSERT_EQ(check.second->size(), results_size);
+            ASSERT_TRUE(std::equal(check.second->begin(), check.second->end(), results));
+            delete [] results;
+
+            for(uint32_t id: *check.second) {
+                ASSERT_TRUE(check.first->contains(id));
+            }
+
+            ASSERT_FALSE(check.first->contains(base + span + 1));
+        }
+    }
+}
@@ -3,6 +3,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <cmath>
+#include <map>
+#include <algorithm>
 #include <gtest/gtest.h>
 #include <art.h>
 
@@ -385,6 +387,62 @@ TEST(ArtTest, test_art_long_prefix) {
     ASSERT_TRUE(res == 0);
 }
 
+TEST(ArtTest, test_art_prefix_longer_than_node) {
+    art_tree t;
+    int res = art_tree_init(&t);
+    ASSERT_TRUE(res == 0);
+
+    // prefixes past `MAX_PREFIX_LEN` bytes are held out of the node, and past 255 bytes too
+    for(const std::string & stem: {std::string("https://www.example.com/products/widgets/"), std::string(300, 'u')}) {
+        const std::vector<std::string> keys = {stem + "a", stem + "b1", stem + "b2"};
+
+        for(size_t i = 0; i < keys.size(); i++) {
+            art_document doc = get_document(i);
+            ASSERT_TRUE(NULL == art_insert(&t, (unsigned char*)keys[i].c_str(), keys[i].size()+1, &doc, 1));
+            delete [] doc.offsets;
+        }
+
+        for(size_t i = 0; i < keys.size(); i++) {
+            art_leaf* l = (art_leaf *) art_search(&t, (unsigned char*)keys[i].c_str(), keys[i].size()+1);
+            ASSERT_TRUE(l != NULL);
+            ASSERT_EQ(i, l->values->ids.at(0));
+        }
+
+        // a typo beyond the first `MAX_PREFIX_LEN` bytes of the prefix
+        std::string typo = keys[0];
+        typo[20] = 'X';
+        ASSERT_TRUE(NULL == art_search(&t, (unsigned char*)typo.c_str(), typo.size()+1));
+
+        std::vector<art_leaf*> leaves;
+        art_fuzzy_search(&t, (const unsigned char *) typo.c_str(), typo.size() + 1, 0, 0, 10, FREQUENCY, false, leaves);
+        ASSERT_EQ(0, leaves.size());
+
+        art_fuzzy_search(&t, (const unsigned char *) typo.c_str(), typo.size() + 1, 0, 1, 10, FREQUENCY, false, leaves);
+        ASSERT_EQ(1, leaves.size());
+        ASSERT_STREQ(keys[0].c_str(), (const char *) leaves[0]->key);
+
+        prefix_data p = { 0, 0, nullptr };
+        ASSERT_TRUE(!art_iter_prefix(&t, (unsigned char*)typo.c_str(), 30, test_prefix_cb, &p));
+        ASSERT_EQ(0, p.count);
+
+        const char *expected[] = {keys[1].c_str(), keys[2].c_str()};
+        p = { 0, 2, expected };
+
+        // the node left with a single child merges its prefix into the child
+        delete (art_values *) art_delete(&t, (unsigned char*)keys[0].c_str(), keys[0].size()+1);
+        ASSERT_EQ(stem.size() + 1, t.root->partial_len);
+        ASSERT_TRUE(!art_iter_prefix(&t, (unsigned char*)stem.c_str(), stem.size(), test_prefix_cb, &p));
+        ASSERT_EQ(2, p.count);
+        ASSERT_TRUE(NULL != art_search(&t, (unsigned char*)keys[2].c_str(), keys[2].size()+1));
+
+        delete (art_values *) art_delete(&t, (unsigned char*)keys[1].c_str(), keys[1].size()+1);
+        delete (art_values *) art_delete(&t, (unsigned char*)keys[2].c_str(), keys[2].size()+1);
+    }
+
+    res = art_tree_destroy(&t);
+    ASSERT_TRUE(res == 0);
+}
+
 TEST(ArtTest, test_art_insert_search_uuid) {
     art_tree t;
     int res = art_tree_init(&t);
@@ -574,6 +632,65 @@ TEST(ArtTest, test_art_insert_multiple_ids_for_same_token) {
     ASSERT_TRUE(res == 0);
 }
 
+TEST(ArtTest, test_art_insert_many) {
+    art_tree t;
+    int res = art_tree_init(&t);
+    ASSERT_TRUE(res == 0);
+
+    const char* key1 = "implement";
+    art_document doc = get_document((uint32_t) 1);
+    ASSERT_TRUE(NULL == art_insert(&t, (unsigned char*)key1, strlen(key1)+1, &doc, 1));
+    delete [] doc.offsets;
+
+    // the first document is already in the leaf and is skipped
+    std::vector<uint32_t> ids;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> offsets_lens;
+
+    for(uint32_t id = 1; id <= 300; id++) {
+        ids.push_back(id);
+        offsets.push_back(id);
+        offsets.push_back(id + 5);
+        offsets_lens.push_back(2);
+    }
+
+    art_document_run run;
+    run.max_score = 300;
+    run.num_documents = (uint32_t) ids.size();
+    run.ids = &ids[0];
+    run.offsets = &offsets[0];
+    run.offsets_lens = &offsets_lens[0];
+
+    art_values* value = (art_values*) art_insert_many(&t, (unsigned char*)key1, strlen(key1)+1, &run);
+    ASSERT_TRUE(value != NULL);
+
+    // a new key
+    const char* key2 = "implementation";
+    ASSERT_TRUE(NULL == art_insert_many(&t, (unsigned char*)key2, strlen(key2)+1, &run));
+
+    ASSERT_EQ(2, art_size(&t));
+    ASSERT_EQ(300, value->ids.getLength());
+
+    std::vector<uint32_t> positions;
+    for(uint32_t i = 0; i < 300; i++) {
+        ASSERT_EQ(i + 1, value->ids.at(i));
+        value->positions.get(i, positions);
+        ASSERT_EQ((i == 0) ? 1 : 2, positions.size());
+    }
+
+    value->positions.get(299, positions);
+    ASSERT_EQ(300, positions[0]);
+    ASSERT_EQ(305, positions[1]);
+
+    art_leaf* leaf = (art_leaf*) art_search(&t, (unsigned char*)key2, strlen(key2)+1);
+    ASSERT_EQ(300, leaf->values->ids.getLength());
+    ASSERT_EQ(300, leaf->max_score);
+    ASSERT_EQ(300, t.root->max_token_count);
+
+    res = art_tree_destroy(&t);
+    ASSERT_TRUE(res == 0);
+}
+
 TEST(ArtTest, test_art_fuzzy_search_single_leaf) {
     art_tree t;
     int res = art_tree_init(&t);
@@ -1362,4 +1479,172 @@ TEST(ArtTest, test_encode_float_positive_negative) {
     ASSERT_TRUE(res == 0);
     ASSERT_EQ(5, results.size());
     results.clear();
-}
\ No newline at end of file
+}
+TEST(ArtTest, test_art_arena_recycles_nodes_and_leaves) {
+    art_tree t;
+    int res = art_tree_init(&t);
+    ASSERT_TRUE(res == 0);
+
+    const size_t num_keys = 5000;
+    uint64_t arena_bytes = 0;
+
+    for(size_t round = 0; round < 2; round++) {
+        for(size_t i = 0; i < num_keys; i++) {
+            std::string key = "key" + std::to_string(i * 7919);
+            art_document document = get_document(i);
+            ASSERT_TRUE(NULL == art_insert(&t, (unsigned char*)key.c_str(), key.size()+1, &document, 1));
+            delete [] document.offsets;
+        }
+
+        art_memory memory = {};
+        art_memory_usage(&t, &memory);
+        ASSERT_EQ(num_keys, memory.num_leaves);
+        ASSERT_GT(memory.arena_bytes, memory.node_bytes);
+        ASSERT_LT(memory.arena_free_bytes, memory.arena_bytes);
+
+        for(size_t i = 0; i < num_keys; i++) {
+            std::string key = "key" + std::to_string(i * 7919);
+            art_values* values = (art_values*) art_delete(&t, (unsigned char*)key.c_str(), key.size()+1);
+            ASSERT_TRUE(values != NULL);
+            delete values;
+        }
+
+        memory = {};
+        art_memory_usage(&t, &memory);
+        ASSERT_EQ(0, memory.num_leaves);
+        ASSERT_EQ(memory.arena_bytes, memory.arena_free_bytes);
+
+        // every node and leaf of the first round went back on a free list, so the second one takes no new slab
+        if(round == 1) {
+            ASSERT_EQ(arena_bytes, memory.arena_bytes);
+        }
+
+        arena_bytes = memory.arena_bytes;
+    }
+
+    res = art_tree_destroy(&t);
+    ASSERT_TRUE(res == 0);
+}
+
+TEST(ArtTest, test_art_fuzzy_search_long_term) {
+    art_tree t;
+    int res = art_tree_init(&t);
+    ASSERT_TRUE(res == 0);
+
+    // terms longer than 63 bytes are matched with rows of ints instead of the bit-parallel automaton
+    const std::string short_key = "transposition";
+    const std::string long_key = std::string(70, 'a') + "transposition";
+    const std::vector<std::string> keys = {short_key, long_key};
+
+    for(size_t i = 0; i < keys.size(); i++) {
+        art_document doc = get_document(i);
+        ASSERT_TRUE(NULL == art_insert(&t, (unsigned char*)keys[i].c_str(), keys[i].size()+1, &doc, 1));
+        delete [] doc.offsets;
+    }
+
+    for(const std::string & key: keys) {
+        std::string typo = key;
+        std::swap(typo[typo.size()-4], typo[typo.size()-3]);
+
+        std::vector<art_leaf*> leaves;
+        art_fuzzy_search(&t, (const unsigned char *) typo.c_str(), typo.size() + 1, 0, 0, 10, FREQUENCY, false, leaves);
+        ASSERT_EQ(0, leaves.size());
+
+        // a transposition counts as a single edit
+        art_fuzzy_search(&t, (const unsigned char *) typo.c_str(), typo.size() + 1, 1, 1, 10, FREQUENCY, false, leaves);
+        ASSERT_EQ(1, leaves.size());
+        ASSERT_STREQ(key.c_str(), (const char *) leaves[0]->key);
+    }
+
+    res = art_tree_destroy(&t);
+    ASSERT_TRUE(res == 0);
+}
+
+TEST(ArtTest, test_art_topk_caches_of_prefixes) {
+    art_tree t;
+    int res = art_tree_init(&t);
+    ASSERT_TRUE(res == 0);
+
+    // enough keys for the caches to be read, with varied scores and frequencies
+    std::map<std::string, std::vector<uint32_t>> key_ids;
+    std::map<std::string, int32_t> key_scores;
+
+    for(uint32_t i = 0; i < 3000; i++) {
+        const std::string key = "k" + std::to_string((i * 7919) % 10000);
+        const uint32_t num_docs = (i % 7) + 1;
+
+        for(uint32_t j = 0; j < num_docs; j++) {
+            art_document doc = get_document(i * 10 + j);
+            doc.score = (i * 31) % 1000;
+            art_insert(&t, (const unsigned char *) key.c_str(), key.size() + 1, &doc, j + 1);
+            delete [] doc.offsets;
+            key_ids[key].push_back(doc.id);
+        }
+
+        key_scores[key] = (i * 31) % 1000;
+    }
+
+    auto expected_values = [&](const std::string & prefix, token_ordering token_order) {
+        std::vector<int64_t> values;
+        for(const auto & kv: key_ids) {
+            if(kv.first.compare(0, prefix.size(), prefix) == 0) {
+                values.push_back(token_order == FREQUENCY ? kv.second.size() : key_scores[kv.first]);
+            }
+        }
+        std::sort(values.begin(), values.end(), std::greater<int64_t>());
+        values.resize(std::min<size_t>(values.size(), 10));
+        return values;
+    };
+
+    auto found_values = [&](const std::string & prefix, token_ordering token_order) {
+        std::vector<art_leaf*> leaves;
+        art_fuzzy_search(&t, (const unsigned char *) prefix.c_str(), prefix.size(), 0, 0, 10, token_order, true, leaves);
+        std::vector<int64_t> values;
+        for(art_leaf* leaf: leaves) {
+            values.push_back(token_order == FREQUENCY ? leaf->values->ids.getLength() : leaf->max_score);
+        }
+        return values;
+    };
+
+    const std::vector<std::string> prefixes = {"k", "k1", "k12", "k123", "k9"};
+
+    auto check_prefixes = [&]() {
+        for(const std::string & prefix: prefixes) {
+            ASSERT_EQ(expected_values(prefix, FREQUENCY), found_values(prefix, FREQUENCY));
+            ASSERT_EQ(expected_values(prefix, MAX_SCORE), found_values(prefix, MAX_SCORE));
+        }
+    };
+
+    check_prefixes();
+    ASSERT_TRUE(t.root->topk != nullptr);
+    ASSERT_EQ(10, t.root->topk->num_leaves);
+
+    // deleting the best leaves ranks the ones below them
+    for(size_t i = 0; i < 5; i++) {
+        std::vector<art_leaf*> leaves;
+        art_fuzzy_search(&t, (const unsigned char *) "k", 1, 0, 0, 1, MAX_SCORE, true, leaves);
+        const std::string key((const char *) leaves[0]->key, leaves[0]->key_len - 1);
+
+        art_values* values = (art_values*) art_delete(&t, (const unsigned char *) key.c_str(), key.size() + 1);
+        delete values;
+        key_ids.erase(key);
+        key_scores.erase(key);
+    }
+
+    check_prefixes();
+
+    // documents removed from the most frequent leaves in place
+    for(auto & kv: key_ids) {
+        if(kv.second.size() == 7) {
+            art_leaf* leaf = (art_leaf *) art_search(&t, (const unsigned char *) kv.first.c_str(), kv.first.size() + 1);
+            leaf->values->ids.remove_values(&kv.second[1], kv.second.size() - 1);
+            kv.second.resize(1);
+        }
+    }
+
+    art_topk_refresh(&t);
+    check_prefixes();
+
+    res = art_tree_destroy(&t);
+    ASSERT_TRUE(res == 0);
+}
@@ -82,9 +82,9 @@ TEST_F(CollectionManagerTest, CollectionCreation) {
     // we already call `collection1->get_next_seq_id` above, which is side-effecting
     ASSERT_EQ(1, StringUtils::deserialize_uint32_t(next_seq_id));
     ASSERT_EQ("{\"created_at\":12345,\"default_sorting_field\":\"points\","
-              "\"fields\":[{\"facet\":false,\"name\":\"title\",\"optional\":false,\"type\":\"string\"},"
-              "{\"facet\":false,\"name\":\"starring\",\"optional\":false,\"type\":\"string\"},"
-              "{\"facet\":true,\"name\":\"cast\",\"optional\":true,\"type\":\"string[]\"},"
+              "\"fields\":[{\"facet\":false,\"name\":\"title\",\"optional\":false,\"positions\":true,\"type\":\"string\"},"
+              "{\"facet\":false,\"name\":\"starring\",\"optional\":false,\"positions\":true,\"type\":\"string\"},"
+              "{\"facet\":true,\"name\":\"cast\",\"optional\":true,\"positions\":true,\"type\":\"string[]\"},"
               "{\"facet\":false,\"name\":\"points\",\"optional\":false,\"type\":\"int32\"}],\"id\":0,\"name\":\"collection1\"}",
               collection_meta_json);
     ASSERT_EQ("1", next_collection_id);
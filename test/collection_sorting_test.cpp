@@ -254,4 +254,47 @@ TEST_F(CollectionSortingTest, ThreeSortFieldsLimit) {
     ASSERT_STREQ("Only upto 3 sort_by fields can be specified.", res_op.error().c_str());
 
     collectionManager.drop_collection("coll1");
-}
\ No newline at end of file
+}
+TEST_F(CollectionSortingTest, SmallPageMatchesTopOfLargerPage) {
+    Collection *coll1;
+
+    std::vector<field> fields = {field("title", field_types::STRING, false),
+                                 field("points", field_types::INT32, false)};
+
+    coll1 = collectionManager.get_collection("coll1");
+    if(coll1 == nullptr) {
+        coll1 = collectionManager.create_collection("coll1", fields, "points").get();
+    }
+
+    // vary the distance between the query tokens so that documents differ on text match as well as points
+    for(size_t i = 0; i < 200; i++) {
+        nlohmann::json doc;
+        doc["id"] = std::to_string(i);
+        doc["title"] = (i % 3 == 0) ? "the quick brown fox" : ((i % 3 == 1) ? "the fox" : "fox jumped over the dog");
+        doc["points"] = (int32_t) ((i * 37) % 101);
+        ASSERT_TRUE(coll1->add(doc.dump()).ok());
+    }
+
+    std::vector<std::vector<sort_by>> sort_fields_list = {
+        { sort_by(sort_field_const::text_match, "DESC"), sort_by("points", "DESC") },
+        { sort_by("points", "DESC"), sort_by(sort_field_const::text_match, "DESC") },
+        { sort_by("points", "ASC") },
+    };
+
+    for(auto & sort_fields: sort_fields_list) {
+        nlohmann::json all_results = coll1->search("the fox", {"title"}, "", {}, sort_fields, 0, 200, 1,
+                                                   FREQUENCY, false).get();
+        nlohmann::json top_results = coll1->search("the fox", {"title"}, "", {}, sort_fields, 0, 5, 1,
+                                                   FREQUENCY, false).get();
+
+        ASSERT_EQ(200, all_results["found"].get<size_t>());
+        ASSERT_EQ(200, top_results["found"].get<size_t>());
+        ASSERT_EQ(5, top_results["hits"].size());
+
+        for(size_t i = 0; i < top_results["hits"].size(); i++) {
+            ASSERT_EQ(all_results["hits"][i]["document"]["id"], top_results["hits"][i]["document"]["id"]);
+        }
+    }
+
+    collectionManager.drop_collection("coll1");
+}
@@ -1946,8 +1946,13 @@ TEST_F(CollectionTest, DeletionOfDocumentArrayFields) {
 
     ASSERT_EQ(0, res["found"].get<int32_t>());
 
-    // also assert against the actual index
+    // the removed document stays in the leaves until compaction purges it
     Index *index = coll1->_get_indexes()[0];  // seq id will always be zero for first document
+    ASSERT_EQ(1, index->num_deleted());
+    ASSERT_EQ(1, coll1->compact(100, 1));
+    ASSERT_EQ(0, index->num_deleted());
+
+    // also assert against the actual index
     auto search_index = index->_get_search_index();
 
     auto strarray_tree = search_index["strarray"];
@@ -2334,3 +2339,554 @@ TEST_F(CollectionTest, ReturnsResultsBasedOnPerPageParam) {
     ASSERT_EQ(5, results["hits"].size());
     ASSERT_EQ(25, results["found"].get<int>());
 }
+
+TEST_F(CollectionTest, SearchResultsAreCachedUntilAWrite) {
+    SearchCache & search_cache = collectionManager.get_search_cache();
+    search_cache.set_max_bytes(1024 * 1024);
+
+    std::vector<std::string> facets;
+    const uint64_t hits_before = search_cache.get_hits();
+    const uint64_t misses_before = search_cache.get_misses();
+
+    nlohmann::json results = collection->search("the", query_fields, "", facets, sort_fields, 0, 10).get();
+    const size_t num_found = results["found"].get<size_t>();
+
+    ASSERT_EQ(hits_before, search_cache.get_hits());
+    ASSERT_EQ(misses_before + 1, search_cache.get_misses());
+
+    spp::sparse_hash_set<std::string> empty;
+    search_stage_times_t stage_times;
+    results = collection->search("the", query_fields, "", facets, sort_fields, 0, 10, 1,
+                                 FREQUENCY, false, Index::DROP_TOKENS_THRESHOLD, empty, empty, 10, "", 30, "",
+                                 Index::TYPO_TOKENS_THRESHOLD, {}, {}, 0, nullptr, &stage_times).get();
+    ASSERT_EQ(num_found, results["found"].get<size_t>());
+    ASSERT_EQ(hits_before + 1, search_cache.get_hits());
+    ASSERT_TRUE(stage_times.from_cache);
+
+    // different page is a different entry
+    collection->search("the", query_fields, "", facets, sort_fields, 0, 10, 2).get();
+    ASSERT_EQ(misses_before + 2, search_cache.get_misses());
+
+    // a write must invalidate the cached result
+    collection->add("{\"id\": \"cache0\", \"points\": 10, \"title\": \"the cached\"}");
+
+    results = collection->search("the", query_fields, "", facets, sort_fields, 0, 10).get();
+    ASSERT_EQ(num_found + 1, results["found"].get<size_t>());
+    ASSERT_EQ(hits_before + 1, search_cache.get_hits());
+    ASSERT_EQ(misses_before + 3, search_cache.get_misses());
+
+    collection->remove("cache0");
+
+    results = collection->search("the", query_fields, "", facets, sort_fields, 0, 10).get();
+    ASSERT_EQ(num_found, results["found"].get<size_t>());
+    ASSERT_EQ(misses_before + 4, search_cache.get_misses());
+
+    search_cache.set_max_bytes(0);
+    search_cache.clear();
+}
+
+TEST_F(CollectionTest, SearchCutoffIsFlaggedInResults) {
+    std::vector<std::string> facets;
+
+    // no time budget by default
+    nlohmann::json results = collection->search("the", query_fields, "", facets, sort_fields, 0, 10).get();
+    ASSERT_FALSE(results["search_cutoff"].get<bool>());
+    ASSERT_EQ(7, results["found"].get<size_t>());
+
+    results = collection->search("the", query_fields, "", facets, sort_fields, 0, 10, 1, FREQUENCY,
+                                 false, 10, spp::sparse_hash_set<std::string>(),
+                                 spp::sparse_hash_set<std::string>(), 10, "", 30, "", 10, {}, {}, 60000).get();
+    ASSERT_FALSE(results["search_cutoff"].get<bool>());
+    ASSERT_EQ(7, results["found"].get<size_t>());
+
+    // a deadline that has already passed
+    search_cutoff::arm(1);
+    ASSERT_TRUE(search_cutoff::exceeded());
+    ASSERT_TRUE(search_cutoff::is_cutoff());
+
+    search_cutoff::arm(0);
+    ASSERT_FALSE(search_cutoff::exceeded());
+    ASSERT_FALSE(search_cutoff::exceeded_sampled());
+}
+
+TEST_F(CollectionTest, SearchesCanShareFilterResults) {
+    std::vector<std::string> facets;
+    spp::sparse_hash_set<std::string> empty;
+
+    nlohmann::json expected = collection->search("the", query_fields, "points:>12", facets, sort_fields, 0, 10).get();
+    ASSERT_FALSE(expected["hits"].empty());
+
+    filter_result_cache_t filter_cache;
+
+    for(size_t i = 0; i < 2; i++) {
+        nlohmann::json results = collection->search("the", query_fields, "points:>12", facets, sort_fields, 0, 10, 1,
+                                                    FREQUENCY, false, 10, empty, empty, 10, "", 30, "", 10, {}, {},
+                                                    0, &filter_cache).get();
+
+        ASSERT_EQ(expected["found"].get<size_t>(), results["found"].get<size_t>());
+        ASSERT_EQ(expected["hits"].size(), results["hits"].size());
+
+        for(size_t j = 0; j < results["hits"].size(); j++) {
+            ASSERT_EQ(expected["hits"][j]["document"]["id"], results["hits"][j]["document"]["id"]);
+        }
+    }
+
+    // a different query with the same filter
+    nlohmann::json results = collection->search("*", query_fields, "points:>12", facets, sort_fields, 0, 10, 1,
+                                                FREQUENCY, false, 10, empty, empty, 10, "", 30, "", 10, {}, {},
+                                                0, &filter_cache).get();
+
+    nlohmann::json uncached = collection->search("*", query_fields, "points:>12", facets, sort_fields, 0, 10).get();
+    ASSERT_EQ(uncached["found"].get<size_t>(), results["found"].get<size_t>());
+
+    // a document written between two searches of the batch must not be missed by the later one
+    collection->add("{\"id\": \"filtered0\", \"points\": 100, \"title\": \"the filtered\"}");
+
+    results = collection->search("*", query_fields, "points:>12", facets, sort_fields, 0, 10, 1,
+                                 FREQUENCY, false, 10, empty, empty, 10, "", 30, "", 10, {}, {},
+                                 0, &filter_cache).get();
+    ASSERT_EQ(uncached["found"].get<size_t>() + 1, results["found"].get<size_t>());
+
+    collection->remove("filtered0");
+}
+
+TEST_F(CollectionTest, SearchStageTimesAreRecorded) {
+    std::vector<std::string> facets;
+    spp::sparse_hash_set<std::string> empty;
+
+    const nlohmann::json & before = search_stage_histograms::get_instance().to_json();
+
+    search_stage_times_t stage_times;
+    nlohmann::json results = collection->search("the", query_fields, "", facets, sort_fields, 0, 10, 1,
+                                                FREQUENCY, false, 10, empty, empty, 10, "", 30, "", 10, {}, {},
+                                                0, nullptr, &stage_times).get();
+    ASSERT_EQ(7, results["found"].get<size_t>());
+
+    const nlohmann::json & stages = stage_times.to_json();
+    ASSERT_EQ(NUM_SEARCH_STAGES, stages.size());
+    ASSERT_EQ(1, stages.count("tokenize"));
+    ASSERT_EQ(1, stages.count("highlight"));
+
+    // a search without filters or facets does not run those stages
+    ASSERT_TRUE(stage_times.ran[FUZZY]);
+    ASSERT_TRUE(stage_times.ran[HIGHLIGHT]);
+    ASSERT_FALSE(stage_times.ran[FILTER]);
+    ASSERT_FALSE(stage_times.ran[FACET]);
+
+    const nlohmann::json & after = search_stage_histograms::get_instance().to_json();
+
+    for(size_t i = 0; i < NUM_SEARCH_STAGES; i++) {
+        const std::string stage = SEARCH_STAGE_NAMES[i];
+        const uint64_t num_runs = stage_times.ran[i] ? 1 : 0;
+        ASSERT_EQ(before[stage]["count"].get<uint64_t>() + num_runs, after[stage]["count"].get<uint64_t>());
+        ASSERT_LE(after[stage]["p50_us"].get<uint64_t>(), after[stage]["p99_us"].get<uint64_t>());
+    }
+
+    results = collection->search("the", query_fields, "points:>12", facets, sort_fields, 0, 10, 1,
+                                 FREQUENCY, false, 10, empty, empty, 10, "", 30, "", 10, {}, {},
+                                 0, nullptr, &stage_times).get();
+    ASSERT_TRUE(stage_times.ran[FILTER]);
+
+    const nlohmann::json & after_filter = search_stage_histograms::get_instance().to_json();
+    ASSERT_EQ(after["filter"]["count"].get<uint64_t>() + 1, after_filter["filter"]["count"].get<uint64_t>());
+}
+
+TEST_F(CollectionTest, FiltersOnDenseFields) {
+    Collection *coll_dense;
+
+    std::vector<field> fields = {
+        field("title", field_types::STRING, false),
+        field("category", field_types::STRING, false),
+        field("in_stock", field_types::BOOL, false),
+        field("points", field_types::INT32, false),
+    };
+
+    coll_dense = collectionManager.get_collection("coll_dense");
+    if(coll_dense == nullptr) {
+        coll_dense = collectionManager.create_collection("coll_dense", fields, "points").get();
+    }
+
+    const std::vector<std::string> categories = {"shoes", "shirts", "hats"};
+
+    for(size_t i = 0; i < 6000; i++) {
+        nlohmann::json doc;
+        doc["title"] = "item " + std::to_string(i);
+        doc["category"] = categories[i % 3];
+        doc["in_stock"] = (i % 2 == 0);
+        doc["points"] = (int32_t) (i % 10);
+        ASSERT_TRUE(coll_dense->add(doc.dump()).ok());
+    }
+
+    std::vector<std::string> facets;
+    std::vector<sort_by> sort_fields = { sort_by("points", "DESC") };
+    query_fields = {"title"};
+
+    // both leaves are dense: ids are ANDed as bitmaps
+    nlohmann::json results = coll_dense->search("item", query_fields, "in_stock:true && category:shoes", facets,
+                                                sort_fields, 0, 10).get();
+    ASSERT_EQ(1000, results["found"].get<size_t>());
+
+    // a dense leaf with a sparse one
+    results = coll_dense->search("item", query_fields, "in_stock:false && points:7", facets,
+                                 sort_fields, 0, 10).get();
+    ASSERT_EQ(600, results["found"].get<size_t>());
+
+    results = coll_dense->search("item", query_fields, "category:[shoes, hats] && in_stock:true && points:>7",
+                                 facets, sort_fields, 0, 10).get();
+    ASSERT_EQ(400, results["found"].get<size_t>());
+
+    collectionManager.drop_collection("coll_dense");
+}
+
+TEST_F(CollectionTest, FieldsIndexedWithoutPositions) {
+    Collection *coll_positions;
+
+    std::vector<field> fields = {
+        field("title", field_types::STRING, false),
+        field("description", field_types::STRING, false, false, false),
+        field("tags", field_types::STRING_ARRAY, false, false, false),
+        field("points", field_types::INT32, false),
+    };
+
+    coll_positions = collectionManager.get_collection("coll_positions");
+    if(coll_positions == nullptr) {
+        coll_positions = collectionManager.create_collection("coll_positions", fields, "points").get();
+    }
+
+    nlohmann::json coll_summary = coll_positions->get_summary_json();
+    ASSERT_TRUE(coll_summary["fields"][0]["positions"].get<bool>());
+    ASSERT_FALSE(coll_summary["fields"][1]["positions"].get<bool>());
+
+    std::vector<std::vector<std::string>> records = {
+        {"the quick brown fox", "a fox that is quick and brown", "quick", "fox"},
+        {"lazy dog", "brown dog that is lazy", "lazy", "brown dog"},
+        {"quick fox", "only quick", "fast", "animal"},
+    };
+
+    for(size_t i = 0; i < records.size(); i++) {
+        nlohmann::json doc;
+        doc["id"] = std::to_string(i);
+        doc["title"] = records[i][0];
+        doc["description"] = records[i][1];
+        doc["tags"] = {records[i][2], records[i][3]};
+        doc["points"] = (int32_t) i;
+        ASSERT_TRUE(coll_positions->add(doc.dump()).ok());
+    }
+
+    std::vector<std::string> facets;
+    std::vector<sort_by> sort_fields = { sort_by("points", "DESC") };
+
+    // tokens are still matched, in any order, but there is nothing to highlight
+    query_fields = {"description"};
+    nlohmann::json results = coll_positions->search("brown quick", query_fields, "", facets, sort_fields, 0, 10, 1,
+                                                    FREQUENCY, false, 0).get();
+    ASSERT_EQ(1, results["found"].get<size_t>());
+    ASSERT_STREQ("0", results["hits"][0]["document"]["id"].get<std::string>().c_str());
+    ASSERT_EQ(0, results["hits"][0]["highlights"].size());
+
+    query_fields = {"tags"};
+    results = coll_positions->search("brown dog", query_fields, "", facets, sort_fields, 0, 10, 1,
+                                     FREQUENCY, false, 0).get();
+    ASSERT_EQ(1, results["found"].get<size_t>());
+    ASSERT_STREQ("1", results["hits"][0]["document"]["id"].get<std::string>().c_str());
+
+    // positions are kept for the other fields
+    query_fields = {"title"};
+    results = coll_positions->search("quick fox", query_fields, "", facets, sort_fields, 0, 10).get();
+    ASSERT_EQ(2, results["found"].get<size_t>());
+    ASSERT_EQ(1, results["hits"][0]["highlights"].size());
+
+    // removal drops the document from a leaf that holds no positions for it
+    ASSERT_TRUE(coll_positions->remove("0").ok());
+    query_fields = {"description"};
+    results = coll_positions->search("quick", query_fields, "", facets, sort_fields, 0, 10).get();
+    ASSERT_EQ(1, results["found"].get<size_t>());
+    ASSERT_STREQ("2", results["hits"][0]["document"]["id"].get<std::string>().c_str());
+
+    collectionManager.drop_collection("coll_positions");
+}
+
+TEST_F(CollectionTest, RemovedDocumentsAreFilteredUntilCompacted) {
+    Collection *coll_removals;
+
+    std::vector<field> fields = {
+        field("title", field_types::STRING, false),
+        field("category", field_types::STRING, true),
+        field("points", field_types::INT32, false),
+    };
+
+    coll_removals = collectionManager.get_collection("coll_removals");
+    if(coll_removals == nullptr) {
+        coll_removals = collectionManager.create_collection("coll_removals", fields, "points").get();
+    }
+
+    for(size_t i = 0; i < 300; i++) {
+        nlohmann::json doc;
+        doc["id"] = std::to_string(i);
+        doc["title"] = "item " + std::to_string(i);
+        doc["category"] = (i % 2 == 0) ? "even" : "odd";
+        doc["points"] = (int32_t) i;
+        ASSERT_TRUE(coll_removals->add(doc.dump()).ok());
+    }
+
+    // every third document
+    for(size_t i = 0; i < 300; i += 3) {
+        ASSERT_TRUE(coll_removals->remove(std::to_string(i)).ok());
+    }
+
+    std::vector<std::string> facets = {"category"};
+    std::vector<sort_by> sort_fields = { sort_by("points", "DESC") };
+    query_fields = {"title"};
+
+    auto num_deleted = [&]() {
+        size_t num_deleted = 0;
+        for(Index* index: coll_removals->_get_indexes()) {
+            num_deleted += index->num_deleted();
+        }
+        return num_deleted;
+    };
+
+    ASSERT_EQ(100, num_deleted());
+
+    auto assert_results = [&]() {
+        nlohmann::json results = coll_removals->search("item", query_fields, "", facets, sort_fields, 0, 10).get();
+        ASSERT_EQ(200, results["found"].get<size_t>());
+        ASSERT_STREQ("299", results["hits"][0]["document"]["id"].get<std::string>().c_str());
+        ASSERT_STREQ("298", results["hits"][1]["document"]["id"].get<std::string>().c_str());
+        ASSERT_STREQ("296", results["hits"][2]["document"]["id"].get<std::string>().c_str());
+        ASSERT_EQ(100, results["facet_counts"][0]["counts"][0]["count"].get<size_t>());
+
+        results = coll_removals->search("item", query_fields, "category:even", facets, sort_fields, 0, 10).get();
+        ASSERT_EQ(100, results["found"].get<size_t>());
+
+        results = coll_removals->search("*", query_fields, "points:<30", facets, sort_fields, 0, 10).get();
+        ASSERT_EQ(20, results["found"].get<size_t>());
+
+        // a token that only a removed document had
+        results = coll_removals->search("3", query_fields, "", facets, sort_fields, 0, 10).get();
+        ASSERT_EQ(0, results["found"].get<size_t>());
+    };
+
+    assert_results();
+
+    // purged in batches of up to 10 per index
+    ASSERT_EQ(0, coll_removals->compact(10, 101));
+    ASSERT_EQ(10 * coll_removals->get_num_indices(), coll_removals->compact(10, 1));
+    ASSERT_EQ(100 - 10 * coll_removals->get_num_indices(), num_deleted());
+    assert_results();
+
+    while(coll_removals->compact(10, 1) != 0);
+    ASSERT_EQ(0, num_deleted());
+    assert_results();
+
+    size_t num_item_ids = 0;
+    for(Index* index: coll_removals->_get_indexes()) {
+        art_leaf* leaf = index->get_token_leaf("title", (const unsigned char *) "item", 5);
+        num_item_ids += leaf->values->ids.getLength();
+        ASSERT_EQ(nullptr, index->get_token_leaf("title", (const unsigned char *) "3", 2));
+    }
+
+    ASSERT_EQ(200, num_item_ids);
+
+    collectionManager.drop_collection("coll_removals");
+}
+
+TEST_F(CollectionTest, RankingAfterRemovesMatchesFreshIndex) {
+    std::vector<field> fields = {
+        field("title", field_types::STRING, false),
+        field("points", field_types::INT32, false),
+    };
+
+    Collection* coll_removed = collectionManager.create_collection("coll_ranking_removed", fields, "points").get();
+    Collection* coll_fresh = collectionManager.create_collection("coll_ranking_fresh", fields, "points").get();
+
+    // every block holds one document per index, so that the frequencies of the tokens are the same in each index
+    const size_t block_size = coll_removed->get_num_indices();
+    const size_t num_apple_blocks = 10, num_applet_blocks = 6, num_removed_blocks = 8;
+    int32_t points = 0;
+
+    auto add_block = [&](Collection* coll, const std::string & title, size_t block) {
+        for(size_t i = 0; i < block_size; i++) {
+            nlohmann::json doc;
+            doc["id"] = title + "-" + std::to_string(block) + "-" + std::to_string(i);
+            doc["title"] = title;
+            doc["points"] = points++;
+            ASSERT_TRUE(coll->add(doc.dump()).ok());
+        }
+    };
+
+    for(size_t block = 0; block < num_apple_blocks; block++) {
+        add_block(coll_removed, "apple", block);
+        if(block >= num_removed_blocks) {
+            add_block(coll_fresh, "apple", block);
+        }
+    }
+
+    for(size_t block = 0; block < num_applet_blocks; block++) {
+        add_block(coll_removed, "applet", block);
+        add_block(coll_fresh, "applet", block);
+    }
+
+    for(size_t block = 0; block < num_removed_blocks; block++) {
+        for(size_t i = 0; i < block_size; i++) {
+            ASSERT_TRUE(coll_removed->remove("apple-" + std::to_string(block) + "-" + std::to_string(i)).ok());
+        }
+    }
+
+    // the most frequent completion of the prefix is searched first, and is enough on its own
+    std::vector<std::string> facets;
+    std::vector<sort_by> sort_fields = { sort_by("points", "DESC") };
+    query_fields = {"title"};
+
+    auto search_ids = [&](Collection* coll) {
+        nlohmann::json results = coll->search("app", query_fields, "", facets, sort_fields, 0, 50, 1,
+                                              FREQUENCY, true, 0, spp::sparse_hash_set<std::string>(),
+                                              spp::sparse_hash_set<std::string>(), 10, "", 30, "", 1).get();
+        std::vector<std::string> ids;
+        for(auto & hit: results["hits"]) {
+            ids.push_back(hit["document"]["id"].get<std::string>());
+        }
+        return ids;
+    };
+
+    const std::vector<std::string> & fresh_ids = search_ids(coll_fresh);
+    ASSERT_EQ(num_applet_blocks * block_size, fresh_ids.size());
+    ASSERT_EQ(0, fresh_ids[0].find("applet-"));
+
+    // the removed documents still make "apple" look like the more frequent token
+    ASSERT_EQ((num_apple_blocks - num_removed_blocks) * block_size, search_ids(coll_removed).size());
+
+    // half of the documents of each index are removed: compacted on the share alone
+    ASSERT_EQ(0, coll_removed->compact(1000, 1000, 60));
+    ASSERT_EQ(num_removed_blocks * block_size, coll_removed->compact(1000, 1000, 50));
+
+    ASSERT_EQ(fresh_ids, search_ids(coll_removed));
+
+    collectionManager.drop_collection("coll_ranking_removed");
+    collectionManager.drop_collection("coll_ranking_fresh");
+}
+
+TEST_F(CollectionTest, MemoryIsAccountedByField) {
+    Collection *coll_memory;
+
+    std::vector<field> fields = {
+        field("title", field_types::STRING, false),
+        field("tags", field_types::STRING_ARRAY, true, false, false),
+        field("points", field_types::INT32, true),
+    };
+
+    coll_memory = collectionManager.get_collection("coll_memory");
+    if(coll_memory == nullptr) {
+        coll_memory = collectionManager.create_collection("coll_memory", fields, "points").get();
+    }
+
+    for(size_t i = 0; i < 200; i++) {
+        nlohmann::json doc;
+        doc["title"] = "item number " + std::to_string(i);
+        doc["tags"] = {"tag" + std::to_string(i % 7), "common"};
+        doc["points"] = (int32_t) i;
+        ASSERT_TRUE(coll_memory->add(doc.dump()).ok());
+    }
+
+    nlohmann::json memory = coll_memory->get_memory_json();
+    nlohmann::json & title = memory["fields"]["title"];
+    nlohmann::json & tags = memory["fields"]["tags"];
+    nlohmann::json & points = memory["fields"]["points"];
+
+    // "item", "number" and 200 numbers in each of the 4 indices at most
+    ASSERT_EQ(2 * 4 + 200, title["leaves"].get<size_t>());
+    ASSERT_GT(title["node4"].get<size_t>() + title["node16"].get<size_t>() + title["node48"].get<size_t>(), 0);
+    ASSERT_GT(title["posting_bytes"].get<size_t>(), 0);
+    ASSERT_GT(title["position_bytes"].get<size_t>(), 0);
+    ASSERT_GT(title["arena_bytes"].get<size_t>(), title["arena_free_bytes"].get<size_t>());
+    ASSERT_EQ(0, title["facet_bytes"].get<size_t>());
+    ASSERT_EQ(0, title["sort_bytes"].get<size_t>());
+
+    // indexed without positions: only the starts of the empty streams are held
+    ASSERT_LT(tags["position_bytes"].get<size_t>(), title["position_bytes"].get<size_t>());
+    ASSERT_GT(tags["facet_bytes"].get<size_t>(), 0);
+
+    // the tree of the numbers as strings for faceting is counted along with the numeric one
+    ASSERT_EQ(200 * 2, points["leaves"].get<size_t>());
+    ASSERT_GT(points["facet_bytes"].get<size_t>(), 0);
+    ASSERT_EQ(200 * sizeof(std::pair<uint32_t, int64_t>), points["sort_bytes"].get<size_t>());
+
+    size_t total_bytes = 0;
+    for(auto & field_memory: memory["fields"]) {
+        total_bytes += field_memory["total_bytes"].get<size_t>();
+    }
+
+    ASSERT_EQ(total_bytes, memory["total_bytes"].get<size_t>());
+
+    // the arena counters reported in the metrics match the ones found by walking the trees
+    size_t arena_bytes = 0, arena_free_bytes = 0;
+    for(auto & field_memory: memory["fields"]) {
+        arena_bytes += field_memory["arena_bytes"].get<size_t>();
+        arena_free_bytes += field_memory["arena_free_bytes"].get<size_t>();
+    }
+
+    nlohmann::json arena_memory = coll_memory->get_arena_memory_json();
+    ASSERT_GT(arena_memory["arena_bytes"].get<size_t>(), 0);
+    ASSERT_EQ(arena_bytes, arena_memory["arena_bytes"].get<size_t>());
+    ASSERT_EQ(arena_free_bytes, arena_memory["arena_free_bytes"].get<size_t>());
+
+    collectionManager.drop_collection("coll_memory");
+}
+
+TEST_F(CollectionTest, SearchesRunBetweenImportBatches) {
+    Collection *coll_import;
+
+    std::vector<field> fields = {
+        field("title", field_types::STRING, false),
+        field("points", field_types::INT32, false),
+    };
+
+    coll_import = collectionManager.get_collection("coll_import");
+    if(coll_import == nullptr) {
+        coll_import = collectionManager.create_collection("coll_import", fields, "points").get();
+    }
+
+    const size_t num_docs = 3500;
+    std::string import_records;
+
+    for(size_t i = 0; i < num_docs; i++) {
+        nlohmann::json doc;
+        doc["title"] = "item " + std::to_string(i);
+        doc["points"] = (int32_t) i;
+        import_records += doc.dump() + "\n";
+    }
+
+    std::atomic<bool> importing(true);
+    std::vector<size_t> found_counts;
+
+    std::thread searcher([&]() {
+        while(importing) {
+            Option<nlohmann::json> res_op = coll_import->search("item", {"title"}, "", {}, sort_fields, 0, 10, 1,
+                                                                FREQUENCY, false);
+            if(res_op.ok()) {
+                found_counts.push_back(res_op.get()["found"].get<size_t>());
+            }
+        }
+    });
+
+    Option<nlohmann::json> import_res = coll_import->add_many(import_records);
+    importing = false;
+    searcher.join();
+
+    ASSERT_TRUE(import_res.ok());
+    ASSERT_EQ(num_docs, import_res.get()["num_imported"].get<size_t>());
+
+    // a search sees either none or all of the documents of a batch
+    for(size_t i = 0; i < found_counts.size(); i++) {
+        ASSERT_TRUE(found_counts[i] % 1000 == 0 || found_counts[i] == num_docs);
+        if(i != 0) {
+            ASSERT_LE(found_counts[i-1], found_counts[i]);
+        }
+    }
+
+    nlohmann::json results = coll_import->search("item", {"title"}, "", {}, sort_fields, 0, 10, 1,
+                                                 FREQUENCY, false).get();
+    ASSERT_EQ(num_docs, results["found"].get<size_t>());
+
+    collectionManager.drop_collection("coll_import");
+}
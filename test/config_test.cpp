@@ -23,6 +23,8 @@ TEST(ConfigTest, LoadCmdLineArguments) {
         "--data-dir=/tmp/data",
         "--api-key=abcd",
         "--listen-port=8080",
+        "--num-search-threads=8",
+        "--search-cache-size-mb=64",
     };
 
     std::vector<char*> argv = get_argv(args);
@@ -36,6 +38,8 @@ TEST(ConfigTest, LoadCmdLineArguments) {
     ASSERT_EQ("abcd", config.get_api_key());
     ASSERT_EQ(8080, config.get_api_port());
     ASSERT_EQ("/tmp/data", config.get_data_dir());
+    ASSERT_EQ(8, config.get_num_search_threads());
+    ASSERT_EQ(64, config.get_search_cache_size_mb());
 }
 
 TEST(ConfigTest, LoadEnvVars) {
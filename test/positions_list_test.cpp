@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include "positions_list.h"
+#include <vector>
+
+TEST(PositionsListTest, AppendGetAndRemove) {
+    positions_list positions;
+
+    std::vector<std::vector<uint32_t>> doc_positions = {
+        {0, 5, 9},
+        {},                         // indexed without positions
+        {3, 3, 0, 1, 7, 7, 2},      // array field: each element ends with a repeat and the element's index
+        {70000, 70001, 1000000},    // deltas spanning several varint bytes
+        {42}
+    };
+
+    for(const auto & doc: doc_positions) {
+        ASSERT_TRUE(positions.append(doc.data(), doc.size()));
+    }
+
+    ASSERT_EQ(doc_positions.size(), positions.getLength());
+
+    std::vector<uint32_t> decoded;
+    for(size_t i = 0; i < doc_positions.size(); i++) {
+        positions.get(i, decoded);
+        ASSERT_EQ(doc_positions[i], decoded);
+    }
+
+    positions.remove(2);
+    doc_positions.erase(doc_positions.begin() + 2);
+
+    positions.remove(0);
+    doc_positions.erase(doc_positions.begin());
+
+    ASSERT_EQ(doc_positions.size(), positions.getLength());
+
+    for(size_t i = 0; i < doc_positions.size(); i++) {
+        positions.get(i, decoded);
+        ASSERT_EQ(doc_positions[i], decoded);
+    }
+
+    // appending after a removal continues at the end of the stream
+    std::vector<uint32_t> last = {1, 2};
+    positions.append(last.data(), last.size());
+    positions.get(doc_positions.size(), decoded);
+    ASSERT_EQ(last, decoded);
+}
+
+TEST(PositionsListTest, SmallDeltasTakeAByte) {
+    positions_list positions;
+    std::vector<uint32_t> doc;
+
+    for(uint32_t i = 0; i < 1000; i++) {
+        doc.push_back(i * 10);
+    }
+
+    positions.append(doc.data(), doc.size());
+
+    std::vector<uint32_t> decoded;
+    positions.get(0, decoded);
+    ASSERT_EQ(doc, decoded);
+
+    // a delta of 10 zigzags to 20, which fits in a single byte
+    ASSERT_LT(positions.getSizeInBytes(), 1000 * 2);
+}
+
+TEST(PositionsListTest, AppendManyDocuments) {
+    positions_list positions;
+
+    std::vector<uint32_t> first = {4, 8};
+    positions.append(first.data(), first.size());
+
+    std::vector<uint32_t> doc_positions = {1, 2, 3, 7, 7, 0, 100000};
+    std::vector<uint32_t> doc_lengths = {3, 0, 4};
+    ASSERT_TRUE(positions.append(doc_positions.data(), doc_lengths.data(), doc_lengths.size()));
+
+    // and into an empty list
+    positions_list other_positions;
+    ASSERT_TRUE(other_positions.append(doc_positions.data(), doc_lengths.data(), doc_lengths.size()));
+
+    std::vector<std::vector<uint32_t>> expected = {{1, 2, 3}, {}, {7, 7, 0, 100000}};
+    std::vector<uint32_t> decoded;
+
+    ASSERT_EQ(4, positions.getLength());
+    positions.get(0, decoded);
+    ASSERT_EQ(first, decoded);
+
+    ASSERT_EQ(3, other_positions.getLength());
+
+    for(size_t i = 0; i < expected.size(); i++) {
+        positions.get(i + 1, decoded);
+        ASSERT_EQ(expected[i], decoded);
+
+        other_positions.get(i, decoded);
+        ASSERT_EQ(expected[i], decoded);
+    }
+}
@@ -0,0 +1,242 @@
+#include <gtest/gtest.h>
+#include "posting_list.h"
+#include <vector>
+
+TEST(PostingListTest, AppendAndLookup) {
+    posting_list ids;
+    const uint32_t SIZE = 1000;
+
+    EXPECT_EQ(ids.getLength(), 0);
+    EXPECT_EQ(ids.indexOf(100), 0);  // when not found must be equal to length (0 in this case)
+    EXPECT_FALSE(ids.new_iterator().valid());
+
+    for(uint32_t i = 0; i < SIZE; i++) {
+        ids.append(i * 3);
+    }
+
+    EXPECT_EQ(ids.getLength(), SIZE);
+
+    for(uint32_t i = 0; i < SIZE; i++) {
+        EXPECT_EQ(ids.at(i), i * 3);
+        EXPECT_EQ(ids.indexOf(i * 3), i);
+        EXPECT_TRUE(ids.contains(i * 3));
+        EXPECT_FALSE(ids.contains(i * 3 + 1));
+        EXPECT_EQ(ids.indexOf(i * 3 + 1), SIZE);
+    }
+
+    EXPECT_EQ(ids.indexOf(SIZE * 3), SIZE);
+
+    std::vector<uint32_t> search_ids = {0, 1, 3, 383, 384, 385, 2997, 2998, 5000};
+    std::vector<uint32_t> indices(search_ids.size());
+    ids.indexOf(&search_ids[0], search_ids.size(), &indices[0]);
+
+    std::vector<uint32_t> expected_indices = {0, SIZE, 1, SIZE, 128, SIZE, 999, SIZE, SIZE};
+    ASSERT_EQ(expected_indices, indices);
+
+    uint32_t* all_ids = ids.uncompress();
+    for(uint32_t i = 0; i < SIZE; i++) {
+        ASSERT_EQ(i * 3, all_ids[i]);
+    }
+    delete [] all_ids;
+
+    // removal re-packs the blocks
+    std::vector<uint32_t> removed = {0, 6, 1000};
+    ids.remove_values(&removed[0], removed.size());
+
+    ASSERT_EQ(SIZE - 2, ids.getLength());
+    ASSERT_EQ(3, ids.at(0));
+    ASSERT_EQ(9, ids.at(1));
+    ASSERT_EQ(130 * 3, ids.at(128));
+    ASSERT_EQ(SIZE - 2, ids.indexOf(6));
+}
+
+TEST(PostingListTest, TailIsSealedIntoBlocks) {
+    posting_list ids;
+
+    for(uint32_t i = 0; i < posting_list::BLOCK_SIZE * 2 + 1; i++) {
+        ids.append(i * 10);
+
+        // the id just appended is visible, whether it is in the tail or in a freshly sealed block
+        ASSERT_TRUE(ids.contains(i * 10));
+        ASSERT_EQ(i, ids.indexOf(i * 10));
+        ASSERT_EQ(i * 10, ids.at(i));
+    }
+
+    std::vector<uint32_t> search_ids = {1270, 1280, 1285, 2560};
+    std::vector<uint32_t> indices(search_ids.size());
+    ids.indexOf(&search_ids[0], search_ids.size(), &indices[0]);
+
+    std::vector<uint32_t> expected_indices = {127, 128, 257, 256};
+    ASSERT_EQ(expected_indices, indices);
+
+    posting_list::iterator_t it = ids.new_iterator();
+    it.advance_to(2555);
+    ASSERT_EQ(2560, it.id());
+    ASSERT_EQ(256, it.index());
+}
+
+TEST(PostingListTest, IteratorSkipsToIds) {
+    posting_list ids;
+    std::vector<uint32_t> values;
+
+    for(uint32_t i = 0; i < 1000; i++) {
+        values.push_back(i * 2);
+    }
+
+    ids.load(&values[0], values.size());
+
+    posting_list::iterator_t it = ids.new_iterator();
+    for(uint32_t value: values) {
+        ASSERT_TRUE(it.valid());
+        ASSERT_EQ(value, it.id());
+        it.next();
+    }
+
+    ASSERT_FALSE(it.valid());
+
+    it = ids.new_iterator();
+    it.advance_to(3);
+    ASSERT_EQ(4, it.id());
+
+    // into a later block
+    it.advance_to(1001);
+    ASSERT_EQ(1002, it.id());
+    ASSERT_EQ(501, it.index());
+
+    // moving backwards stays put
+    it.advance_to(10);
+    ASSERT_EQ(1002, it.id());
+
+    it.advance_to(1998);
+    ASSERT_EQ(1998, it.id());
+
+    it.advance_to(1999);
+    ASSERT_FALSE(it.valid());
+}
+
+TEST(PostingListTest, IntersectSparseAndDenseIds) {
+    posting_list ids;
+    std::vector<uint32_t> values;
+
+    for(uint32_t i = 0; i < 10000; i++) {
+        values.push_back(i * 2);
+    }
+
+    ids.load(&values[0], values.size());
+
+    // fewer ids than blocks: blocks are skipped through the iterator
+    std::vector<uint32_t> sparse = {1, 2, 5000, 5001, 19998, 30000};
+    size_t num_found = ids.intersect(&sparse[0], sparse.size());
+    ASSERT_EQ(3, num_found);
+    ASSERT_EQ(2, sparse[0]);
+    ASSERT_EQ(5000, sparse[1]);
+    ASSERT_EQ(19998, sparse[2]);
+
+    std::vector<uint32_t> dense;
+    for(uint32_t i = 0; i < 5000; i++) {
+        dense.push_back(i);
+    }
+
+    num_found = ids.intersect(&dense[0], dense.size());
+    ASSERT_EQ(2500, num_found);
+
+    for(size_t i = 0; i < num_found; i++) {
+        ASSERT_EQ(i * 2, dense[i]);
+    }
+}
+
+TEST(PostingListTest, DenseListsAreHeldAsBitmaps) {
+    posting_list ids;
+    std::vector<uint32_t> values;
+
+    // every other id up to 6000
+    for(uint32_t i = 0; i < 3000; i++) {
+        values.push_back(i * 2);
+    }
+
+    for(uint32_t value: values) {
+        ids.append(value);
+    }
+
+    ASSERT_TRUE(ids.is_dense());
+    ASSERT_EQ(values.size(), ids.getLength());
+
+    for(size_t i = 0; i < values.size(); i++) {
+        ASSERT_EQ(values[i], ids.at(i));
+        ASSERT_EQ(i, ids.indexOf(values[i]));
+        ASSERT_TRUE(ids.contains(values[i]));
+        ASSERT_FALSE(ids.contains(values[i] + 1));
+        ASSERT_EQ(values.size(), ids.indexOf(values[i] + 1));
+    }
+
+    posting_list::iterator_t it = ids.new_iterator();
+    for(uint32_t value: values) {
+        ASSERT_EQ(value, it.id());
+        it.next();
+    }
+    ASSERT_FALSE(it.valid());
+
+    it = ids.new_iterator();
+    it.advance_to(4001);
+    ASSERT_EQ(4002, it.id());
+    ASSERT_EQ(2001, it.index());
+
+    std::vector<uint32_t> search_ids = {1, 2, 3001, 5998, 7000};
+    ASSERT_EQ(2, ids.intersect(&search_ids[0], search_ids.size()));
+    ASSERT_EQ(2, search_ids[0]);
+    ASSERT_EQ(5998, search_ids[1]);
+
+    ids_bitmap bitmap;
+    std::vector<uint32_t> other_ids = {1, 2};
+    bitmap.add(&other_ids[0], other_ids.size());
+    ids.add_to(bitmap);
+    ASSERT_EQ(values.size() + 1, bitmap.size());
+
+    // ids far apart turn the list back into blocks
+    for(uint32_t i = 1; i <= 3000; i++) {
+        ids.append(6000 + i * 100);
+    }
+
+    ASSERT_FALSE(ids.is_dense());
+    ASSERT_EQ(6000, ids.getLength());
+    ASSERT_EQ(5998, ids.at(2999));
+    ASSERT_EQ(6100, ids.at(3000));
+    ASSERT_EQ(3000, ids.indexOf(6100));
+}
+
+TEST(PostingListTest, AppendRunsOfIds) {
+    posting_list ids;
+    std::vector<uint32_t> expected;
+    std::vector<uint32_t> run;
+
+    // a first run loads the list, later ones top up the tail and compress the rest as whole blocks
+    for(uint32_t start: {0, 1000, 5000}) {
+        run.clear();
+        for(uint32_t i = 0; i < 300; i++) {
+            run.push_back(start + i * 3);
+        }
+
+        ASSERT_TRUE(ids.append(&run[0], run.size()));
+        expected.insert(expected.end(), run.begin(), run.end());
+    }
+
+    ASSERT_FALSE(ids.is_dense());
+    ASSERT_EQ(expected.size(), ids.getLength());
+
+    for(size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(expected[i], ids.at(i));
+        ASSERT_EQ(i, ids.indexOf(expected[i]));
+    }
+
+    // a run that makes the list dense
+    run.clear();
+    for(uint32_t i = 0; i < 4000; i++) {
+        run.push_back(6000 + i);
+        expected.push_back(6000 + i);
+    }
+
+    ASSERT_TRUE(ids.append(&run[0], run.size()));
+    ASSERT_TRUE(ids.is_dense());
+    ASSERT_EQ(expected.size(), ids.getLength());
+    ASSERT_EQ(expected.back(), ids.at(expected.size() - 1));
+}